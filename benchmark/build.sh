@@ -0,0 +1,36 @@
+#!/bin/bash
+# 编译压测工具和所有参与对比的服务器到 bin/ (统一 -O2，对比才公平)
+cd "$(dirname "$0")"
+mkdir -p bin
+
+g++ -std=c++17 -O2 -pthread echo_bench.cpp -o bin/echo_bench
+
+g++ -std=c++17 -O2 -pthread ../socket_tcp_server/tcp_server.cpp -o bin/tcp_server
+g++ -std=c++17 -O2 -pthread ../socket_tcp_server_multi_process/tcp_server_multiprocess.cpp -o bin/tcp_server_multiprocess
+g++ -std=c++17 -O2 -pthread ../socket_tcp_server_multi_thread/tcp_server_multithread.cpp -o bin/tcp_server_multithread
+g++ -std=c++17 -O2 -pthread ../thread_pool/tcp_server_thread_pool.cpp -o bin/tcp_server_thread_pool
+g++ -std=c++17 -O2 -pthread ../io-multiplexing/epoll_tcp_lt.cc -o bin/epoll_tcp_lt
+g++ -std=c++17 -O2 -pthread ../io-multiplexing/epoll_tcp_et.cc -o bin/epoll_tcp_et
+g++ -std=c++17 -O2 -pthread ../io-multiplexing/epoll_multi_reactor.cc -o bin/epoll_multi_reactor
+
+# mini-rpc：先用 protoc 生成 user.pb.cc (需要 cc_generic_services)
+protoc --cpp_out=bin -I../protobuf/protocol ../protobuf/protocol/user.proto
+g++ -std=c++17 -O2 -o bin/rpc_test \
+    ../mini-rpc/src/main.cpp \
+    ../mini-rpc/src/rpc_provider.cpp \
+    ../mini-rpc/src/rpc_codec.cpp \
+    ../mini-rpc/src/rpc_event_loop.cpp \
+    ../mini-rpc/src/rpc_event_loop_uring.cpp \
+    ../mini-rpc/src/rpc_method_table.cpp \
+    ../mini-rpc/src/rpc_arena_pool.cpp \
+    ../thread_pool_demo/ThreadPool.cc \
+    bin/user.pb.cc \
+    -I../mini-rpc/include -Ibin \
+    -pthread -lprotobuf
+g++ -std=c++17 -O2 -o bin/rpc_bench \
+    ../mini-rpc/src/rpc_bench.cpp \
+    ../mini-rpc/src/rpc_channel.cpp \
+    ../mini-rpc/src/rpc_codec.cpp \
+    bin/user.pb.cc \
+    -I../mini-rpc/include -Ibin \
+    -pthread -lprotobuf
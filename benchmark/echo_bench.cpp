@@ -0,0 +1,392 @@
+/**
+ * 回显服务器压测工具：N 条连接，每条连接发一条 size 字节的消息，收齐回显后再发下一条 (闭环)
+ *
+ *   ./echo_bench [-h host] [-p port] [-c 连接数] [-T 线程数] [-s 消息字节数]
+ *                [-t 压测秒数] [-w 预热秒数] [-C 建连超时毫秒] [-q]
+ *
+ * 每个线程一个 epoll (LT)，负责 1/T 的连接，socket 全部非阻塞：消息比 socket 缓冲区大时边发边收，
+ * 不会和服务端互相等对方读而卡死。一次请求的延迟 = 发出第一个字节到收齐 size 字节回显，收到的内容逐字节校验。
+ *
+ * 不是每个服务器都能服务所有连接：
+ *  - connected：-C 毫秒内连上的连接 (backlog 很小的服务器，多出来的连接会卡在握手上)
+ *  - active：压测期间至少收到过一次回显的连接 (单线程阻塞服务器一次只服务一个客户端，其余连接一直等)
+ * -q：给 run_echo_bench.sh 用，预热结束开始统计时输出一行 "# measuring"，
+ *     结束后输出一行 CSV：connected,active,requests,errors,throughput,p50,p90,p99,p999,max (延迟单位微秒)
+ */
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../common/latency_histogram.h"
+
+// build bash: g++ -std=c++11 -O2 -pthread echo_bench.cpp -o echo_bench
+
+const int MAX_EVENTS = 1024;
+const int RECV_BUFFER_SIZE = 64 * 1024;
+const int LOOP_TICK_MS = 10;    // epoll_wait 最长等待，保证按时结束压测
+
+struct EchoBenchOptions
+{
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int connections = 1;
+    int threads = 1;
+    int size = 16;
+    int duration_sec = 10;
+    int warmup_sec = 1;             // 预热期间的结果不计入统计，连接也在这段时间里建立
+    int connect_timeout_ms = 1000;
+    bool csv = false;
+};
+
+static int64_t bench_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+struct BenchConnection
+{
+    int fd = -1;
+    bool connected = false;
+    bool want_write = false;    // 已经注册了 EPOLLOUT
+    size_t sent = 0;            // 当前消息已发出 / 已收到的字节
+    size_t received = 0;
+    int64_t start_ns = 0;
+    uint64_t responses = 0;
+};
+
+/**
+ * 一个压测线程：自己的 epoll、连接和直方图，和其它线程不共享任何可写状态
+ */
+class EchoBenchWorker
+{
+public:
+    EchoBenchWorker(const EchoBenchOptions &opts, const std::string &message, int connections)
+        : opts_(opts), message_(message), connections_(connections), buffer_(RECV_BUFFER_SIZE) {}
+
+    void Run(int64_t measure_from_ns, int64_t stop_ns) {
+        measure_from_ns_ = measure_from_ns;
+        stop_ns_ = stop_ns;
+
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd_ == -1) {
+            perror("epoll_create1 error");
+            exit(1);
+        }
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(opts_.host.c_str());
+        addr.sin_port = htons(opts_.port);
+
+        for (BenchConnection &conn : connections_) {
+            Connect(&conn, addr);
+        }
+
+        int64_t connect_deadline = bench_now_ns() + (int64_t)opts_.connect_timeout_ms * 1000000;
+        bool connect_checked = false;
+        struct epoll_event events[MAX_EVENTS];
+
+        while (true) {
+            int64_t now = bench_now_ns();
+            if (now >= stop_ns_) break;
+
+            // 建连超时：还没连上的放弃掉，不参与压测
+            if (!connect_checked && now >= connect_deadline) {
+                for (BenchConnection &conn : connections_) {
+                    if (conn.fd != -1 && !conn.connected) {
+                        CloseConnection(&conn);
+                    }
+                }
+                connect_checked = true;
+            }
+
+            int timeout = (int)((stop_ns_ - now) / 1000000) + 1;
+            int nfds = epoll_wait(epfd_, events, MAX_EVENTS, timeout < LOOP_TICK_MS ? timeout : LOOP_TICK_MS);
+            if (nfds == -1) {
+                if (errno == EINTR) continue;
+                perror("epoll_wait error");
+                exit(1);
+            }
+
+            for (int i = 0; i < nfds; i++) {
+                BenchConnection *conn = static_cast<BenchConnection*>(events[i].data.ptr);
+                if (conn->fd == -1) continue;
+
+                if (!conn->connected) {
+                    HandleConnected(conn);
+                    continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                    HandleRead(conn);
+                }
+                if (conn->fd != -1 && (events[i].events & EPOLLOUT)) {
+                    HandleWrite(conn);
+                }
+            }
+        }
+
+        for (BenchConnection &conn : connections_) {
+            if (conn.responses > 0) active_++;
+            if (conn.fd != -1) close(conn.fd);
+        }
+        close(epfd_);
+    }
+
+    const LatencyHistogram &histogram() const { return histogram_; }
+    int connected() const { return connected_; }
+    int active() const { return active_; }
+    uint64_t errors() const { return errors_; }
+
+private:
+    void Connect(BenchConnection *conn, const struct sockaddr_in &addr) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd == -1) {
+            errors_++;
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        if (connect(fd, (const struct sockaddr*)&addr, sizeof(addr)) == -1 && errno != EINPROGRESS) {
+            errors_++;
+            close(fd);
+            return;
+        }
+
+        // 非阻塞 connect：可写即握手完成 (或失败)
+        conn->fd = fd;
+        conn->want_write = true;
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.ptr = conn;
+        epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    void HandleConnected(BenchConnection *conn) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err != 0) {
+            errors_++;
+            CloseConnection(conn);
+            return;
+        }
+        conn->connected = true;
+        connected_++;
+        StartRequest(conn, bench_now_ns());
+    }
+
+    void StartRequest(BenchConnection *conn, int64_t now) {
+        conn->sent = 0;
+        conn->received = 0;
+        conn->start_ns = now;
+        HandleWrite(conn);
+    }
+
+    void HandleWrite(BenchConnection *conn) {
+        while (conn->sent < message_.size()) {
+            ssize_t n = send(conn->fd, message_.data() + conn->sent, message_.size() - conn->sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                conn->sent += n;
+            }
+            else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            else if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            else {
+                Fail(conn);
+                return;
+            }
+        }
+        UpdateEvents(conn, conn->sent < message_.size());
+    }
+
+    void HandleRead(BenchConnection *conn) {
+        while (true) {
+            ssize_t n = recv(conn->fd, buffer_.data(), buffer_.size(), 0);
+            if (n > 0) {
+                // 回显不能比已发出的多，内容也必须一致
+                if (conn->received + n > conn->sent
+                    || memcmp(buffer_.data(), message_.data() + conn->received, n) != 0) {
+                    Fail(conn);
+                    return;
+                }
+                conn->received += n;
+                if ((size_t)n < buffer_.size()) break;
+            }
+            else if (n == 0) {
+                Fail(conn);
+                return;
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            else if (errno != EINTR) {
+                Fail(conn);
+                return;
+            }
+        }
+
+        if (conn->received < message_.size()) return;
+
+        int64_t now = bench_now_ns();
+        if (now >= measure_from_ns_ && now < stop_ns_) {
+            histogram_.record(now - conn->start_ns);
+        }
+        conn->responses++;
+        if (now < stop_ns_) {
+            StartRequest(conn, now);
+        }
+    }
+
+    void UpdateEvents(BenchConnection *conn, bool want_write) {
+        if (conn->want_write == want_write) return;
+        struct epoll_event ev;
+        ev.events = EPOLLIN | (want_write ? (uint32_t)EPOLLOUT : 0u);
+        ev.data.ptr = conn;
+        epoll_ctl(epfd_, EPOLL_CTL_MOD, conn->fd, &ev);
+        conn->want_write = want_write;
+    }
+
+    // 服务端断开 / 出错 / 回显内容不对：这条连接不再参与压测
+    void Fail(BenchConnection *conn) {
+        errors_++;
+        CloseConnection(conn);
+    }
+
+    void CloseConnection(BenchConnection *conn) {
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, conn->fd, nullptr);
+        close(conn->fd);
+        conn->fd = -1;
+    }
+
+    const EchoBenchOptions &opts_;
+    const std::string &message_;
+    std::vector<BenchConnection> connections_;
+    std::vector<char> buffer_;
+    int epfd_ = -1;
+    int64_t measure_from_ns_ = 0;
+    int64_t stop_ns_ = 0;
+
+    LatencyHistogram histogram_;
+    int connected_ = 0;
+    int active_ = 0;
+    uint64_t errors_ = 0;
+};
+
+static EchoBenchOptions parse_echo_bench_options(int argc, char *argv[]) {
+    EchoBenchOptions opts;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) {
+            opts.csv = true;
+            continue;
+        }
+        if (i + 1 >= argc) break;
+        if (strcmp(argv[i], "-h") == 0) opts.host = argv[++i];
+        else if (strcmp(argv[i], "-p") == 0) opts.port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0) opts.connections = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-T") == 0) opts.threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0) opts.size = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0) opts.duration_sec = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0) opts.warmup_sec = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-C") == 0) opts.connect_timeout_ms = atoi(argv[++i]);
+    }
+    if (opts.connections < 1) opts.connections = 1;
+    if (opts.threads < 1) opts.threads = 1;
+    if (opts.threads > opts.connections) opts.threads = opts.connections;
+    if (opts.size < 1) opts.size = 1;
+    if (opts.duration_sec < 1) opts.duration_sec = 1;
+    if (opts.warmup_sec < 0) opts.warmup_sec = 0;
+    return opts;
+}
+
+// 上万条连接会超过默认的 1024 个文件描述符
+static void raise_fd_limit() {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    EchoBenchOptions opts = parse_echo_bench_options(argc, argv);
+    raise_fd_limit();
+
+    // 可打印字符循环填充，服务端如果把内容改了 (截断、清零) 能校验出来
+    std::string message(opts.size, 0);
+    for (int i = 0; i < opts.size; i++) {
+        message[i] = 'a' + i % 26;
+    }
+
+    std::vector<std::unique_ptr<EchoBenchWorker>> workers;
+    for (int i = 0; i < opts.threads; i++) {
+        int n = opts.connections / opts.threads + (i < opts.connections % opts.threads ? 1 : 0);
+        workers.emplace_back(new EchoBenchWorker(opts, message, n));
+    }
+
+    int64_t start = bench_now_ns();
+    int64_t measure_from = start + (int64_t)opts.warmup_sec * 1000000000;
+    int64_t stop = measure_from + (int64_t)opts.duration_sec * 1000000000;
+
+    std::vector<std::thread> threads;
+    for (auto &worker : workers) {
+        EchoBenchWorker *w = worker.get();
+        threads.emplace_back([w, measure_from, stop]() { w->Run(measure_from, stop); });
+    }
+    if (opts.csv) {
+        // 压测脚本看到这一行才开始统计服务端 CPU
+        std::this_thread::sleep_for(std::chrono::nanoseconds(measure_from - bench_now_ns()));
+        printf("# measuring\n");
+        fflush(stdout);
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    LatencyHistogram total;
+    int connected = 0, active = 0;
+    uint64_t errors = 0;
+    for (auto &worker : workers) {
+        total.merge(worker->histogram());
+        connected += worker->connected();
+        active += worker->active();
+        errors += worker->errors();
+    }
+    double throughput = (double)total.count() / opts.duration_sec;
+
+    if (opts.csv) {
+        printf("%d,%d,%llu,%llu,%.0f,%.1f,%.1f,%.1f,%.1f,%.1f\n", connected, active,
+               (unsigned long long)total.count(), (unsigned long long)errors, throughput,
+               total.percentile(50) / 1000.0, total.percentile(90) / 1000.0, total.percentile(99) / 1000.0,
+               total.percentile(99.9) / 1000.0, total.max() / 1000.0);
+        return 0;
+    }
+
+    printf("target %s:%d, %d connections (%d connected, %d active), %d threads, message %d B\n",
+           opts.host.c_str(), opts.port, opts.connections, connected, active, opts.threads, opts.size);
+    printf("requests %llu, errors %llu, duration %d s, throughput %.0f req/s, %.1f MB/s\n",
+           (unsigned long long)total.count(), (unsigned long long)errors, opts.duration_sec,
+           throughput, throughput * opts.size / 1e6);
+    printf("latency (us): p50 %.1f  p90 %.1f  p99 %.1f  p999 %.1f  max %.1f\n",
+           total.percentile(50) / 1000.0, total.percentile(90) / 1000.0, total.percentile(99) / 1000.0,
+           total.percentile(99.9) / 1000.0, total.max() / 1000.0);
+    return 0;
+}
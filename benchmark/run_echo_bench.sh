@@ -0,0 +1,220 @@
+#!/bin/bash
+# 回显服务器模型对比：逐个启动服务器，扫描 连接数 x 消息大小，每组结果写一行 CSV
+#
+#   ./run_echo_bench.sh [-o 输出文件] [-t 每组秒数] [-w 预热秒数] [-T 压测线程数]
+#                       [-S "服务器列表"] [-C "连接数列表"] [-M "消息大小列表"]
+#
+# 每一组：启动服务器 (单独的进程组) → 等端口可连 → 跑 echo_bench (rpc 用 rpc_bench) → 停服务器
+#   cpu_pct：压测窗口内服务器整棵进程树的 utime+stime (含已回收的子进程)，100 表示占满一个核
+#   rss_kb ：压测期间每 0.2 秒对进程树的 PSS 求和取峰值 (fork 出来的子进程共享的页只按份额计)
+#   rpc / rpc_uring 不是回显：请求体是 Login 的 name 字段，响应很小；connected / active 两列留空
+# 连接数 x 消息大小超过 MAX_INFLIGHT_BYTES 的组合跳过；每连接一进程的模型最多 FORK_MAX_CONNS 个连接
+# 先运行 ./build.sh
+
+cd "$(dirname "$0")"
+
+OUTPUT=results.csv
+DURATION=5
+WARMUP=1
+THREADS=$(nproc)
+SERVERS="blocking fork thread pool pool_event epoll_lt epoll_lt_uring epoll_et epoll_et_splice multi_reactor rpc rpc_uring"
+CONNS="1 10 100 1000 10000"
+SIZES="16 1024 65536 1048576"
+MAX_INFLIGHT_BYTES=$((512 * 1024 * 1024))
+FORK_MAX_CONNS=1000
+
+while getopts "o:t:w:T:S:C:M:" opt; do
+    case $opt in
+        o) OUTPUT=$OPTARG ;;
+        t) DURATION=$OPTARG ;;
+        w) WARMUP=$OPTARG ;;
+        T) THREADS=$OPTARG ;;
+        S) SERVERS=$OPTARG ;;
+        C) CONNS=$OPTARG ;;
+        M) SIZES=$OPTARG ;;
+        *) exit 1 ;;
+    esac
+done
+
+if [ ! -x bin/echo_bench ]; then
+    echo "bin/echo_bench not found, run ./build.sh first" >&2
+    exit 1
+fi
+
+# 上万条连接：服务器和压测工具都继承这个上限
+ulimit -n "$(ulimit -Hn)"
+
+# 服务器名 → 启动命令；-d 1 让支持排空的服务器收到 SIGTERM 后 1 秒内退出
+server_cmd() {
+    case $1 in
+        blocking)      echo "bin/tcp_server -d 1" ;;
+        fork)          echo "bin/tcp_server_multiprocess -d 1" ;;
+        thread)        echo "bin/tcp_server_multithread -d 1" ;;
+        pool)          echo "bin/tcp_server_thread_pool -d 1" ;;
+        pool_event)    echo "bin/tcp_server_thread_pool -n -d 1" ;;
+        epoll_lt)      echo "bin/epoll_tcp_lt -d 1" ;;
+        epoll_lt_uring) echo "bin/epoll_tcp_lt -U -d 1" ;;
+        epoll_et)      echo "bin/epoll_tcp_et" ;;
+        epoll_et_splice) echo "bin/epoll_tcp_et -z" ;;
+        multi_reactor) echo "bin/epoll_multi_reactor" ;;
+        rpc)           echo "bin/rpc_test -i $THREADS -d 1" ;;
+        rpc_uring)     echo "bin/rpc_test -i $THREADS -U -d 1" ;;
+        *)             return 1 ;;
+    esac
+}
+
+is_rpc() {
+    case $1 in rpc|rpc_*) return 0 ;; *) return 1 ;; esac
+}
+
+server_port() {
+    if is_rpc "$1"; then echo 8888; else echo 8080; fi
+}
+
+port_open() {
+    (exec 3<>"/dev/tcp/127.0.0.1/$1") 2>/dev/null
+}
+
+# root 及其所有子孙进程
+tree_pids() {
+    ps -e -o pid=,ppid= | awk -v root="$1" '
+        { parent[$1] = $2 }
+        END {
+            for (p in parent) {
+                q = p
+                while (q != root && (q in parent) && q > 1) q = parent[q]
+                if (q == root) print p
+            }
+        }'
+}
+
+# 进程树已用的 CPU 时间 (时钟滴答)：存活进程的 utime+stime，加上 root 已回收子进程的 cutime+cstime
+tree_cpu_ticks() {
+    local pids
+    pids=$(tree_pids "$1")
+    {
+        for p in $pids; do cat "/proc/$p/stat" 2>/dev/null; done
+    } | awk -v root="$1" '{ s += $14 + $15; if ($1 == root) s += $16 + $17 } END { print s + 0 }'
+}
+
+tree_pss_kb() {
+    local pids
+    pids=$(tree_pids "$1")
+    {
+        for p in $pids; do cat "/proc/$p/smaps_rollup" 2>/dev/null; done
+    } | awk '/^Pss:/ { s += $2 } END { print s + 0 }'
+}
+
+# 后台采样内存峰值，写到 $2，直到被 kill
+sample_memory() {
+    local peak=0 kb
+    while true; do
+        kb=$(tree_pss_kb "$1")
+        if [ "$kb" -gt "$peak" ]; then
+            peak=$kb
+            echo "$peak" > "$2"
+        fi
+        sleep 0.2
+    done
+}
+
+# SIGTERM 等 3 秒，没退干净就 SIGKILL 整个进程组 (包括 fork 出来的子进程)
+stop_server() {
+    kill -TERM "$1" 2>/dev/null
+    for _ in $(seq 30); do
+        kill -0 "$1" 2>/dev/null || break
+        sleep 0.1
+    done
+    kill -KILL -- "-$1" 2>/dev/null
+    wait "$1" 2>/dev/null
+}
+
+run_case() {
+    local server=$1 conns=$2 size=$3
+    local port cmd pid gen cpu0 cpu1 t0 t1 result cpu_pct rss
+    port=$(server_port "$server")
+    cmd=$(server_cmd "$server")
+
+    if port_open "$port"; then
+        echo "port $port is already in use, skip $server" >&2
+        return 1
+    fi
+
+    setsid $cmd > /dev/null 2>&1 &
+    pid=$!
+    for _ in $(seq 50); do
+        port_open "$port" && break
+        sleep 0.1
+    done
+
+    local mem_file result_file
+    mem_file=$(mktemp)
+    result_file=$(mktemp)
+    echo 0 > "$mem_file"
+    sample_memory "$pid" "$mem_file" &
+    local sampler=$!
+
+    if is_rpc "$server"; then
+        bin/rpc_bench -q -p "$port" -c "$conns" -T "$THREADS" -s "$size" -t "$DURATION" -w "$WARMUP" > "$result_file" &
+    else
+        bin/echo_bench -q -p "$port" -c "$conns" -T "$THREADS" -s "$size" -t "$DURATION" -w "$WARMUP" > "$result_file" &
+    fi
+    gen=$!
+
+    # CPU 只统计压测窗口：压测工具建完连接、预热结束时输出 "# measuring"，到它退出为止
+    while kill -0 "$gen" 2>/dev/null && ! grep -q '^# measuring' "$result_file"; do
+        sleep 0.05
+    done
+    cpu0=$(tree_cpu_ticks "$pid")
+    t0=$(date +%s.%N)
+    wait "$gen"
+    cpu1=$(tree_cpu_ticks "$pid")
+    t1=$(date +%s.%N)
+
+    kill "$sampler" 2>/dev/null
+    wait "$sampler" 2>/dev/null
+    stop_server "$pid"
+
+    result=$(grep -v '^#' "$result_file")
+    rss=$(cat "$mem_file")
+    rm -f "$mem_file" "$result_file"
+    if [ -z "$result" ]; then
+        echo "$server c=$conns s=$size: no result" >&2
+        return 1
+    fi
+    if is_rpc "$server"; then
+        result=",,$result"
+    fi
+
+    cpu_pct=$(awk -v c0="$cpu0" -v c1="$cpu1" -v t0="$t0" -v t1="$t1" -v hz="$(getconf CLK_TCK)" \
+        'BEGIN { printf "%.1f", (c1 - c0) / hz / (t1 - t0) * 100 }')
+
+    # connected,active,requests,errors,rps,p50,p90,p99,p999,max → 在 rps 后面插入 MB/s
+    echo "$server,$conns,$size,$result,$cpu_pct,$rss" | awk -F, -v OFS=, \
+        '{ mbps = sprintf("%.1f", $8 * $3 / 1e6); $8 = $8 OFS mbps; print }' >> "$OUTPUT"
+    tail -n 1 "$OUTPUT"
+}
+
+echo "server,connections,msg_size,connected,active,requests,errors,throughput_rps,throughput_mbps,p50_us,p90_us,p99_us,p999_us,max_us,cpu_pct,rss_kb" > "$OUTPUT"
+
+for server in $SERVERS; do
+    if ! server_cmd "$server" > /dev/null; then
+        echo "unknown server: $server" >&2
+        continue
+    fi
+    for conns in $CONNS; do
+        if [ "$server" = fork ] && [ "$conns" -gt "$FORK_MAX_CONNS" ]; then
+            echo "skip $server c=$conns (> FORK_MAX_CONNS)" >&2
+            continue
+        fi
+        for size in $SIZES; do
+            if [ $((conns * size)) -gt "$MAX_INFLIGHT_BYTES" ]; then
+                echo "skip $server c=$conns s=$size (> MAX_INFLIGHT_BYTES)" >&2
+                continue
+            fi
+            run_case "$server" "$conns" "$size"
+        done
+    done
+done
+
+echo "results written to $OUTPUT"
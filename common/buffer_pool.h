@@ -0,0 +1,103 @@
+#pragma once
+
+/**
+ * 按大小分级的 I/O 缓冲区池
+ *
+ * 1KB / 4KB / 16KB / 64KB 四级，每一级是一个 SlabPool (线程本地缓存 + 全局链表，整块切分，不逐个 malloc)。
+ * 线程本地缓存按字节限额 (BUFFER_POOL_LOCAL_CACHE_BYTES)：线程很多的服务器里，
+ * 第一次借缓冲区最多多拿几 KB，16KB 以上的级别每次只拿一块。
+ * 全局池子第一次用时要切一整块 slab (BUFFER_POOL_SLAB_BYTES)，每个连接 fork 一个进程的服务器不要用它。
+ * 连接只在真正有数据要收发时借一块 (PooledBuffer 析构时归还)，阻塞等待期间不占缓冲区，
+ * 空闲连接的缓冲区内存为零；借到的缓冲区不清零，只使用 recv 返回的那部分。
+ */
+#include <cstddef>
+#include <cstdlib>
+
+#include "slab_pool.h"
+
+// 各级大小，和 BufferPool::Allocate / Deallocate 里的 case 一一对应
+const size_t BUFFER_POOL_CLASSES[] = {1024, 4096, 16 * 1024, 64 * 1024};
+const int BUFFER_POOL_CLASS_COUNT = sizeof(BUFFER_POOL_CLASSES) / sizeof(BUFFER_POOL_CLASSES[0]);
+const size_t BUFFER_POOL_ALIGN = 64;        // 缓存行对齐
+const size_t BUFFER_POOL_SLAB_BYTES = 256 * 1024; // 每次向系统申请的 slab 大小
+const size_t BUFFER_POOL_LOCAL_CACHE_BYTES = 16 * 1024; // 每一级线程本地最多缓存的字节数
+
+// 一级缓冲区：每个 slab 固定 BUFFER_POOL_SLAB_BYTES，大缓冲区每个 slab 切得少；
+// 本地缓存 BUFFER_POOL_LOCAL_CACHE_BYTES / SIZE 块 (至少 1 块)，每次和全局交换其中一半
+template<size_t SIZE>
+using BufferSlab = SlabPool<SIZE, BUFFER_POOL_ALIGN, BUFFER_POOL_SLAB_BYTES / SIZE,
+                            (BUFFER_POOL_LOCAL_CACHE_BYTES / SIZE > 1 ? BUFFER_POOL_LOCAL_CACHE_BYTES / SIZE : 1),
+                            (BUFFER_POOL_LOCAL_CACHE_BYTES / SIZE / 2 > 1 ? BUFFER_POOL_LOCAL_CACHE_BYTES / SIZE / 2 : 1)>;
+
+class BufferPool
+{
+public:
+    // 能放下 size 字节的最小一级；超过最大一级返回 -1
+    static int ClassOf(size_t size) {
+        for (int i = 0; i < BUFFER_POOL_CLASS_COUNT; i++) {
+            if (size <= BUFFER_POOL_CLASSES[i]) return i;
+        }
+        return -1;
+    }
+
+    static void *Allocate(int cls) {
+        switch (cls) {
+        case 0: return BufferSlab<1024>::allocate();
+        case 1: return BufferSlab<4096>::allocate();
+        case 2: return BufferSlab<16 * 1024>::allocate();
+        case 3: return BufferSlab<64 * 1024>::allocate();
+        }
+        abort();
+    }
+
+    // 可以在任意线程归还 (进入当前线程的缓存)
+    static void Deallocate(int cls, void *p) {
+        switch (cls) {
+        case 0: BufferSlab<1024>::deallocate(p); return;
+        case 1: BufferSlab<4096>::deallocate(p); return;
+        case 2: BufferSlab<16 * 1024>::deallocate(p); return;
+        case 3: BufferSlab<64 * 1024>::deallocate(p); return;
+        }
+        abort();
+    }
+};
+
+/**
+ * 从 BufferPool 借的一块缓冲区，析构时归还
+ * 大于最大一级的请求直接 malloc (不进池子)
+ */
+class PooledBuffer
+{
+public:
+    explicit PooledBuffer(size_t size) : cls_(BufferPool::ClassOf(size)) {
+        if (cls_ >= 0) {
+            data_ = static_cast<char*>(BufferPool::Allocate(cls_));
+            capacity_ = BUFFER_POOL_CLASSES[cls_];
+        }
+        else {
+            data_ = static_cast<char*>(malloc(size));
+            if (data_ == nullptr) abort();
+            capacity_ = size;
+        }
+    }
+
+    ~PooledBuffer() {
+        if (cls_ >= 0) {
+            BufferPool::Deallocate(cls_, data_);
+        }
+        else {
+            free(data_);
+        }
+    }
+
+    PooledBuffer(const PooledBuffer &) = delete;
+    PooledBuffer &operator=(const PooledBuffer &) = delete;
+
+    char *data() { return data_; }
+    size_t capacity() const { return capacity_; }
+
+private:
+    int cls_;
+    char *data_;
+    size_t capacity_;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+/**
+ * 基于 futex 的空闲线程停车场 (Linux)
+ *
+ * 无锁队列没有 condition_variable 可用，空闲 worker 先自旋一小会儿，
+ * 还拿不到任务再 park 到 futex 上睡眠；生产者只有在确实有人睡着时才发 futex_wake 系统调用，
+ * 忙碌时的 submit 完全不进内核。
+ *
+ * 用法 (消费者):
+ *   uint32_t ticket = parker.prepare_park();
+ *   if (再检查一次队列为空 && !stop) parker.park(ticket);
+ *   parker.cancel_park();
+ * 用法 (生产者):
+ *   入队成功后 parker.unpark_one();
+ */
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+inline void futex_wait(std::atomic<uint32_t> *addr, uint32_t expected)
+{
+    // 只有 *addr 仍等于 expected 时才会睡眠，避免丢失唤醒
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t> *addr, int count)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+// 自旋等待时提示 CPU (降低功耗、让出超线程资源)
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+class WorkerParker
+{
+private:
+    std::atomic<uint32_t> epoch{0};   // futex 字，每次唤醒 +1
+    std::atomic<int> sleepers{0};     // 准备或正在睡眠的线程数
+
+public:
+    // 宣告自己准备睡眠，返回当前 epoch；之后调用方必须再检查一次队列
+    uint32_t prepare_park()
+    {
+        uint32_t ticket = epoch.load(std::memory_order_acquire);
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        // 与 unpark_one 中的 fence 配对：要么这里能看到新任务，要么生产者能看到 sleepers > 0
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return ticket;
+    }
+
+    // 睡眠直到 epoch 发生变化 (可能伪唤醒，调用方需循环检查)
+    void park(uint32_t ticket)
+    {
+        futex_wait(&epoch, ticket);
+    }
+
+    void cancel_park()
+    {
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // 入队后调用：有线程在睡才唤醒一个
+    void unpark_one()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0) {
+            epoch.fetch_add(1, std::memory_order_release);
+            futex_wake(&epoch, 1);
+        }
+    }
+
+    // 准备或正在睡眠的线程数 (近似值，用于统计)
+    int parked() const
+    {
+        return sleepers.load(std::memory_order_relaxed);
+    }
+
+    void unpark_all()
+    {
+        epoch.fetch_add(1, std::memory_order_release);
+        futex_wake(&epoch, INT_MAX);
+    }
+};
@@ -0,0 +1,380 @@
+#pragma once
+
+/**
+ * 优雅退出 (drain) 与监听 socket 交接 (所有服务器共用)
+ *
+ * 排空：收到 SIGTERM / SIGINT (或监听 socket 被新进程接手) 后
+ *   - 不再 accept 新连接
+ *   - 已有连接继续服务，直到客户端断开或者超过 drain_timeout_ms
+ *   - 然后进程正常退出；排空期间再收到一次信号则立即退出
+ * 排空通知是一个 eventfd：只写不读，一旦写入就一直可读，所有 poll / epoll 它的线程都会被唤醒；
+ * 它在 fork 之前创建，子进程共享同一个 eventfd，所以一次写入同时通知所有进程。
+ *
+ * 交接 (-u PATH)：新进程启动时先连接 PATH 上的 Unix socket，旧进程通过 SCM_RIGHTS 把监听 socket
+ *   整组发过来，然后旧进程开始排空。新旧进程持有的是同一个内核 socket，accept 队列不会丢，
+ *   部署期间不会拒绝连接。新进程拿到 fd 后在 PATH 上重新监听，等待下一次交接。
+ *
+ * 空闲超时 (-I)：阻塞模型每个连接一个线程 / 进程，wait_client 的 poll 超时就是这个连接的截止时间；
+ *   事件循环模型用 timing_wheel.h 统一管理所有连接的超时。
+ */
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+const int DEFAULT_DRAIN_TIMEOUT_MS = 30000; // 排空期间等待已有连接结束的上限
+const int DEFAULT_IDLE_TIMEOUT_MS = 60000;  // 连接多久没有收发就关闭
+const int MAX_HANDOFF_FDS = 64;             // 一次交接最多传递的监听 socket 数
+
+struct DrainState
+{
+    int event_fd = -1;                      // 排空通知，-1 表示没有调用 graceful_init
+    int timeout_ms = DEFAULT_DRAIN_TIMEOUT_MS;
+    int idle_timeout_ms = 0;                // wait_client 的空闲超时，0 表示不限
+    std::atomic<bool> seen{false};          // 本进程是否已经观察到排空
+    std::atomic<int64_t> deadline_ns{0};    // 本进程的排空截止时间，第一次用到时才确定
+};
+
+inline DrainState &drain_state()
+{
+    static DrainState state;
+    return state;
+}
+
+inline int64_t drain_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// 开始排空 (只调用 write，可以在信号处理函数里使用)
+inline void trigger_drain()
+{
+    int fd = drain_state().event_fd;
+    if (fd == -1) return;
+    uint64_t one = 1;
+    ssize_t ret = write(fd, &one, sizeof(one));
+    (void)ret;
+}
+
+inline void drain_signal_handler(int)
+{
+    static volatile sig_atomic_t count = 0;
+    if (count++ > 0) {
+        _exit(1); // 第二次信号：不再等待
+    }
+    trigger_drain();
+}
+
+/**
+ * 创建排空通知并接管 SIGTERM / SIGINT，必须在创建线程和 fork 子进程之前调用
+ * idle_timeout_ms 是阻塞模型里 wait_client 等一个连接的上限
+ */
+inline void graceful_init(int timeout_ms, int idle_timeout_ms = 0)
+{
+    DrainState &state = drain_state();
+    state.timeout_ms = timeout_ms;
+    state.idle_timeout_ms = idle_timeout_ms;
+    state.event_fd = eventfd(0, EFD_CLOEXEC);
+    if (state.event_fd == -1) {
+        perror("eventfd error");
+        return;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = drain_signal_handler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+}
+
+// 是否已经开始排空
+inline bool draining()
+{
+    DrainState &state = drain_state();
+    if (state.seen.load(std::memory_order_relaxed)) return true;
+    if (state.event_fd == -1) return false;
+
+    struct pollfd p = {state.event_fd, POLLIN, 0};
+    if (poll(&p, 1, 0) == 1) {
+        state.seen.store(true, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+// 本进程的排空截止时间，第一个调用者确定
+inline int64_t drain_deadline_ns()
+{
+    DrainState &state = drain_state();
+    int64_t deadline = state.deadline_ns.load(std::memory_order_relaxed);
+    if (deadline == 0) {
+        int64_t mine = drain_now_ns() + (int64_t)state.timeout_ms * 1000000;
+        state.deadline_ns.compare_exchange_strong(deadline, mine);
+        deadline = state.deadline_ns.load(std::memory_order_relaxed);
+    }
+    return deadline;
+}
+
+// 距离排空截止还剩多少毫秒 (已超时返回 0)
+inline int drain_remaining_ms()
+{
+    int64_t left = drain_deadline_ns() - drain_now_ns();
+    return left > 0 ? (int)(left / 1000000) + 1 : 0;
+}
+
+/**
+ * 等待排空开始，最多 timeout_ms：开始排空返回 true，超时返回 false
+ * 给需要定时醒来、排空时立即结束的辅助线程用
+ */
+inline bool wait_drain(int timeout_ms)
+{
+    DrainState &state = drain_state();
+    if (state.seen.load(std::memory_order_relaxed)) return true;
+    if (state.event_fd == -1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+        return false;
+    }
+
+    struct pollfd p = {state.event_fd, POLLIN, 0};
+    int64_t deadline = drain_now_ns() + (int64_t)timeout_ms * 1000000;
+    while (true) {
+        int64_t left = deadline - drain_now_ns();
+        int ret = poll(&p, 1, left > 0 ? (int)(left / 1000000) + 1 : 0);
+        if (ret == 1) {
+            state.seen.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        if (ret == 0) return false;
+        if (errno != EINTR) {
+            perror("poll error");
+            return false;
+        }
+    }
+}
+
+/**
+ * 代替阻塞 accept 前的等待：监听 socket 可读返回 true，开始排空返回 false
+ */
+inline bool wait_accept(int listen_fd)
+{
+    DrainState &state = drain_state();
+    struct pollfd p[2] = {{listen_fd, POLLIN, 0}, {state.event_fd, POLLIN, 0}};
+    nfds_t n = state.event_fd == -1 ? 1 : 2;
+
+    while (true) {
+        if (poll(p, n, -1) == -1) {
+            if (errno == EINTR) continue;
+            perror("poll error");
+            return true; // 交给 accept 报告错误
+        }
+        if (n == 2 && p[1].revents) {
+            state.seen.store(true, std::memory_order_relaxed);
+            return false;
+        }
+        if (p[0].revents) {
+            return true;
+        }
+    }
+}
+
+/**
+ * 代替阻塞 recv 前的等待：连接可读 (或出错 / 断开) 返回 true
+ * 空闲超过 idle_timeout_ms，或者排空开始后超过截止时间，返回 false，调用方关闭连接
+ */
+inline bool wait_client(int client_fd)
+{
+    DrainState &state = drain_state();
+    struct pollfd p[2] = {{client_fd, POLLIN, 0}, {state.event_fd, POLLIN, 0}};
+    int64_t idle_deadline = state.idle_timeout_ms > 0 ? drain_now_ns() + (int64_t)state.idle_timeout_ms * 1000000 : 0;
+
+    while (true) {
+        nfds_t n = 2;
+        int timeout = -1;
+        if (state.event_fd == -1) {
+            n = 1;
+        }
+        else if (state.seen.load(std::memory_order_relaxed)) {
+            n = 1;
+            timeout = drain_remaining_ms();
+            if (timeout == 0) return false;
+        }
+        if (idle_deadline != 0) {
+            int64_t left = idle_deadline - drain_now_ns();
+            if (left <= 0) return false;
+            int idle_ms = (int)(left / 1000000) + 1;
+            if (timeout == -1 || idle_ms < timeout) timeout = idle_ms;
+        }
+
+        int ret = poll(p, n, timeout);
+        if (ret == -1) {
+            if (errno == EINTR) continue;
+            perror("poll error");
+            return true;
+        }
+        if (ret == 0) continue; // 超时，下一轮判断两个截止时间
+        if (p[0].revents) return true;
+        if (n == 2 && p[1].revents) {
+            state.seen.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * 新进程：向 PATH 上的旧进程索取监听 socket，没有旧进程时返回空
+ */
+inline std::vector<int> receive_listen_fds(const char *path)
+{
+    std::vector<int> fds;
+
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        perror("socket error");
+        return fds;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    // 没有旧进程 (文件不存在或者没人监听)：自己创建监听 socket
+    if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        close(sock);
+        return fds;
+    }
+
+    char data;
+    struct iovec iov = {&data, 1};
+    char control[CMSG_SPACE(sizeof(int) * MAX_HANDOFF_FDS)];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n == -1 && errno == EINTR);
+
+    if (n <= 0) {
+        perror("recvmsg error");
+        close(sock);
+        return fds;
+    }
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int *received = reinterpret_cast<int*>(CMSG_DATA(cmsg));
+        fds.assign(received, received + count);
+    }
+
+    close(sock);
+    return fds;
+}
+
+// 旧进程：通过 SCM_RIGHTS 把监听 socket 整组发给新进程
+inline bool send_listen_fds(int sock, const std::vector<int> &fds)
+{
+    char data = 'F';
+    struct iovec iov = {&data, 1};
+    char control[CMSG_SPACE(sizeof(int) * MAX_HANDOFF_FDS)];
+    memset(control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+    ssize_t n;
+    do {
+        n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (n == -1 && errno == EINTR);
+
+    if (n == -1) {
+        perror("sendmsg error");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 在 PATH 上等待下一个新进程来接手监听 socket，交接成功后开始排空
+ * fd 会先 dup 一份，调用方之后可以照常关闭自己的监听 socket
+ */
+inline void serve_listen_fds_handoff(const char *path, const std::vector<int> &listen_fds)
+{
+    if (listen_fds.empty() || (int)listen_fds.size() > MAX_HANDOFF_FDS) return;
+
+    std::vector<int> fds;
+    for (int fd : listen_fds) {
+        fds.push_back(fcntl(fd, F_DUPFD_CLOEXEC, 0));
+    }
+
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        perror("socket error");
+        return;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    // 旧进程已经把 fd 交给我们了，它的 socket 文件由我们替换
+    unlink(path);
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(sock, 1) == -1) {
+        perror("handoff socket error");
+        close(sock);
+        return;
+    }
+
+    std::thread([sock, fds]() {
+        while (true) {
+            int conn = accept(sock, NULL, NULL);
+            if (conn == -1) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                perror("handoff accept error");
+                return;
+            }
+
+            bool sent = send_listen_fds(conn, fds);
+            close(conn);
+            if (sent) {
+                // socket 文件此时已经属于新进程，只关闭不 unlink
+                close(sock);
+                for (int fd : fds) close(fd);
+                fprintf(stderr, "[%d] listen sockets handed off, draining\n", (int)getpid());
+                trigger_drain();
+                return;
+            }
+        }
+    }).detach();
+}
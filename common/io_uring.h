@@ -0,0 +1,405 @@
+#pragma once
+
+/**
+ * io_uring 的最小封装 (Linux >= 5.19，不依赖 liburing：直接系统调用 + mmap 共享队列)
+ *
+ * epoll 每条消息至少要 epoll_wait + recv + send 三次系统调用；io_uring 把请求写进共享内存的提交队列 (SQ)，
+ * 一次 io_uring_enter 同时完成 "提交这一轮攒下的所有请求" 和 "等下一批完成事件"，结果从完成队列 (CQ) 直接读：
+ *  - 多次 accept (IORING_ACCEPT_MULTISHOT)：提交一次，每来一个连接产生一个完成事件
+ *  - 多次 recv (IORING_RECV_MULTISHOT) + 内核选缓冲区 (IoUringBufferRing)：提交一次，每次有数据产生一个完成事件，
+ *    内核从缓冲区环里挑一块空闲缓冲区填数据，空闲连接不占缓冲区
+ * 单线程使用：一个 IoUring 只在创建它的线程里提交和收割 (SINGLE_ISSUER / DEFER_TASKRUN 就是按这个前提优化的)
+ * user_data == 0 留给内部请求 (探测、PROVIDE_BUFFERS)，使用方不要用 0，收到时忽略
+ */
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#define __NR_io_uring_enter 426
+#define __NR_io_uring_register 427
+#endif
+
+class IoUring
+{
+public:
+    // entries：SQ 大小 (2 的幂)；CQ 取 4 倍，多次 recv 在突发时一个请求会产生很多完成事件
+    explicit IoUring(unsigned entries) {
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+        p.cq_entries = entries * 4;
+        fd_ = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (fd_ == -1 && errno == EINVAL) {
+            // 老内核 (< 6.1) 不认识 SINGLE_ISSUER / DEFER_TASKRUN
+            memset(&p, 0, sizeof(p));
+            p.flags = IORING_SETUP_CQSIZE;
+            p.cq_entries = entries * 4;
+            fd_ = (int)syscall(__NR_io_uring_setup, entries, &p);
+        }
+        if (fd_ == -1) {
+            perror("io_uring_setup error");
+            exit(1);
+        }
+        if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+            fprintf(stderr, "io_uring: kernel too old (need SINGLE_MMAP and EXT_ARG)\n");
+            exit(1);
+        }
+
+        // SQ、CQ 两个环在同一段映射里 (SINGLE_MMAP)，SQE 数组单独映射
+        size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        ring_size_ = sq_size > cq_size ? sq_size : cq_size;
+        ring_ = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        sqes_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqes_ = static_cast<struct io_uring_sqe*>(
+            mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+        if (ring_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+            perror("io_uring mmap error");
+            exit(1);
+        }
+
+        char *base = static_cast<char*>(ring_);
+        sq_head_ = reinterpret_cast<unsigned*>(base + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(base + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(base + p.sq_off.ring_mask);
+        sq_entries_ = p.sq_entries;
+        cq_head_ = reinterpret_cast<unsigned*>(base + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(base + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(base + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<struct io_uring_cqe*>(base + p.cq_off.cqes);
+
+        // SQ 的下标数组固定为恒等映射，之后只需要推进 tail
+        unsigned *array = reinterpret_cast<unsigned*>(base + p.sq_off.array);
+        for (unsigned i = 0; i < p.sq_entries; i++) {
+            array[i] = i;
+        }
+        sqe_tail_ = *sq_tail_;
+    }
+
+    ~IoUring() {
+        munmap(sqes_, sqes_size_);
+        munmap(ring_, ring_size_);
+        close(fd_);
+    }
+
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    int fd() const { return fd_; }
+
+    // 取一个空闲 SQE (已清零)；SQ 满了先把攒下的提交掉
+    struct io_uring_sqe *GetSqe() {
+        unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (sqe_tail_ - head >= sq_entries_) {
+            Submit(0, 0);
+            head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+            if (sqe_tail_ - head >= sq_entries_) return nullptr;
+        }
+        struct io_uring_sqe *sqe = &sqes_[sqe_tail_ & sq_mask_];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe_tail_++;
+        return sqe;
+    }
+
+    /**
+     * 提交所有攒下的 SQE，并等到至少 wait_nr 个完成事件 (timeout_ms < 0 表示不限时)
+     * 一轮事件处理中产生的所有请求在这里一次系统调用提交完
+     * 返回提交的个数；超时 / 被信号打断返回 0，其它错误返回 -1
+     */
+    int Submit(unsigned wait_nr, int timeout_ms = -1) {
+        unsigned to_submit = sqe_tail_ - *sq_tail_;
+        __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+
+        unsigned flags = 0;
+        struct io_uring_getevents_arg arg;
+        struct __kernel_timespec ts;
+        void *argp = nullptr;
+        size_t argsz = 0;
+        // DEFER_TASKRUN 下只有带 GETEVENTS 进内核才会处理完成的请求，所以总是带上
+        flags |= IORING_ENTER_GETEVENTS;
+        if (wait_nr > 0 && timeout_ms >= 0) {
+            memset(&arg, 0, sizeof(arg));
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+            argp = &arg;
+            argsz = sizeof(arg);
+            flags |= IORING_ENTER_EXT_ARG;
+        }
+
+        int ret = (int)syscall(__NR_io_uring_enter, fd_, to_submit, wait_nr, flags, argp, argsz);
+        if (ret == -1) {
+            if (errno == ETIME || errno == EINTR || errno == EBUSY) return 0;
+            return -1;
+        }
+        return ret;
+    }
+
+    // 依次处理所有已完成的事件，f(const io_uring_cqe&)；返回处理的个数
+    template <typename F>
+    unsigned ForEachCqe(F f) {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        unsigned n = 0;
+        while (head != tail) {
+            f(cqes_[head & cq_mask_]);
+            head++;
+            n++;
+            // 回调里可能又提交了请求并进过内核，顺带收割新到的完成事件
+            if (head == tail) {
+                __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+                tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            }
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        return n;
+    }
+
+private:
+    int fd_;
+    void *ring_;
+    size_t ring_size_;
+    struct io_uring_sqe *sqes_;
+    size_t sqes_size_;
+
+    unsigned *sq_head_;
+    unsigned *sq_tail_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned sqe_tail_;         // 本地已填好、还没发布给内核的 SQ 尾
+
+    unsigned *cq_head_;
+    unsigned *cq_tail_;
+    unsigned cq_mask_;
+    struct io_uring_cqe *cqes_;
+};
+
+/**
+ * 内核选缓冲区的缓冲区池：count 块 size 字节的缓冲区，组号 group
+ * recv 带上 IOSQE_BUFFER_SELECT 后由内核挑一块空闲缓冲区写数据，CQE 的 flags 里带着缓冲区编号，
+ * 用完调用 Recycle() 还回去，攒一批再 Publish() 一次。
+ *
+ * 首选缓冲区环 (IORING_REGISTER_PBUF_RING，Linux >= 5.19)：还缓冲区只是写共享内存，不产生请求。
+ * 有的内核注册成功却永远选不到缓冲区 (实测某些 6.18 虚拟机内核上 recv 一直 ENOBUFS)，
+ * 所以启动时用 socketpair 探测一次，不行就退回 IORING_OP_PROVIDE_BUFFERS：
+ * 还缓冲区变成提交请求 (连续编号合并成一个，成功不产生 CQE)，跟着下一次 Submit 一起进内核。
+ * 必须在创建 IoUring 的线程里构造 (探测要提交请求)。
+ */
+class IoUringBufferRing
+{
+public:
+    IoUringBufferRing(IoUring &ring, uint16_t group, unsigned count, size_t size)
+        : ring_(ring), group_(group), count_(count), size_(size), tail_(0) {
+        data_ = static_cast<char*>(malloc(count * size));
+        if (data_ == nullptr) {
+            perror("buffer ring malloc error");
+            exit(1);
+        }
+
+        ring_bytes_ = count * sizeof(struct io_uring_buf);
+        void *mem = mmap(nullptr, ring_bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            perror("buffer ring mmap error");
+            exit(1);
+        }
+        bufs_ = static_cast<struct io_uring_buf_ring*>(mem);
+
+        struct io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = reinterpret_cast<uint64_t>(bufs_);
+        reg.ring_entries = count;
+        reg.bgid = group;
+        use_ring_ = syscall(__NR_io_uring_register, ring.fd(), IORING_REGISTER_PBUF_RING, &reg, 1) == 0;
+
+        for (unsigned i = 0; i < count; i++) {
+            Recycle(i);
+        }
+        Publish();
+
+        if (use_ring_ && !ProbeRing()) {
+            syscall(__NR_io_uring_register, ring.fd(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+            use_ring_ = false;
+            for (unsigned i = 0; i < count; i++) {
+                Recycle(i);
+            }
+            Publish();
+            ring_.Submit(0);
+        }
+    }
+
+    // 不注销：和 IoUring 一起销毁 (关闭 ring fd 时内核自动释放)
+    ~IoUringBufferRing() {
+        munmap(bufs_, ring_bytes_);
+        free(data_);
+    }
+
+    IoUringBufferRing(const IoUringBufferRing &) = delete;
+    IoUringBufferRing &operator=(const IoUringBufferRing &) = delete;
+
+    uint16_t group() const { return group_; }
+    size_t buffer_size() const { return size_; }
+    bool uses_ring() const { return use_ring_; }
+    char *buffer(unsigned id) { return data_ + (size_t)id * size_; }
+
+    // CQE 里带的缓冲区编号
+    static unsigned BufferId(const struct io_uring_cqe &cqe) { return cqe.flags >> IORING_CQE_BUFFER_SHIFT; }
+
+    // 把缓冲区还回去 (Publish 之前内核还看不到)
+    void Recycle(unsigned id) {
+        if (!use_ring_) {
+            pending_.push_back(id);
+            return;
+        }
+        struct io_uring_buf *buf = &bufs_->bufs[tail_ & (count_ - 1)];
+        buf->addr = reinterpret_cast<uint64_t>(buffer(id));
+        buf->len = (uint32_t)size_;
+        buf->bid = (uint16_t)id;
+        tail_++;
+    }
+
+    // 一次发布所有 Recycle 过的缓冲区
+    void Publish() {
+        if (use_ring_) {
+            __atomic_store_n(&bufs_->tail, tail_, __ATOMIC_RELEASE);
+            return;
+        }
+
+        std::sort(pending_.begin(), pending_.end());
+        size_t i = 0;
+        while (i < pending_.size()) {
+            size_t j = i + 1;
+            while (j < pending_.size() && pending_[j] == pending_[j - 1] + 1) j++;
+            struct io_uring_sqe *sqe = ring_.GetSqe();
+            if (sqe == nullptr) break;  // SQ 满且提交不动：剩下的留到下次
+            sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+            sqe->fd = (int)(j - i);     // 缓冲区个数
+            sqe->addr = reinterpret_cast<uint64_t>(buffer(pending_[i]));
+            sqe->len = (uint32_t)size_;
+            sqe->off = pending_[i];     // 起始编号
+            sqe->buf_group = group_;
+            sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+            sqe->user_data = 0;
+            i = j;
+        }
+        pending_.erase(pending_.begin(), pending_.begin() + i);
+    }
+
+private:
+    // 往 socketpair 里写 1 字节，看 recv 能不能从环里选到缓冲区
+    bool ProbeRing() {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) return true;
+        char byte = 0;
+        bool ok = false;
+        if (write(sv[1], &byte, 1) == 1) {
+            struct io_uring_sqe *sqe = ring_.GetSqe();
+            sqe->opcode = IORING_OP_RECV;
+            sqe->fd = sv[0];
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = group_;
+            sqe->user_data = 0;
+            ring_.Submit(1, 1000);
+            ring_.ForEachCqe([&](const struct io_uring_cqe &cqe) {
+                if (cqe.res > 0) {
+                    ok = true;
+                    Recycle(BufferId(cqe));
+                    Publish();
+                }
+            });
+        }
+        close(sv[0]);
+        close(sv[1]);
+        return ok;
+    }
+
+    IoUring &ring_;
+    uint16_t group_;
+    unsigned count_;            // 2 的幂
+    size_t size_;
+    bool use_ring_;
+    uint16_t tail_;
+    size_t ring_bytes_;
+    struct io_uring_buf_ring *bufs_;
+    char *data_;
+    std::vector<unsigned> pending_;  // PROVIDE_BUFFERS 模式下等待发布的缓冲区
+};
+
+// ---- 常用请求的填写 (只设置本仓库用到的字段) ----
+
+inline void uring_prep_multishot_accept(struct io_uring_sqe *sqe, int listen_fd, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = user_data;
+}
+
+inline void uring_prep_multishot_recv(struct io_uring_sqe *sqe, int fd, uint16_t buffer_group, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = buffer_group;
+    sqe->user_data = user_data;
+}
+
+inline void uring_prep_send(struct io_uring_sqe *sqe, int fd, const void *buf, size_t len, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = (uint32_t)len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data;
+}
+
+// msg (以及它指向的 iovec) 必须保持有效直到请求完成
+inline void uring_prep_sendmsg(struct io_uring_sqe *sqe, int fd, const struct msghdr *msg, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data;
+}
+
+inline void uring_prep_read(struct io_uring_sqe *sqe, int fd, void *buf, size_t len, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = (uint32_t)len;
+    sqe->off = (uint64_t)-1;    // 按当前位置读 (eventfd / socket 没有偏移)
+    sqe->user_data = user_data;
+}
+
+inline void uring_prep_poll_add(struct io_uring_sqe *sqe, int fd, unsigned poll_mask, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = poll_mask;
+    sqe->user_data = user_data;
+}
+
+// 取消 user_data 相同的请求 (例如多次 accept)
+inline void uring_prep_cancel(struct io_uring_sqe *sqe, uint64_t target_user_data, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = target_user_data;
+    sqe->user_data = user_data;
+}
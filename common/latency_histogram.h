@@ -0,0 +1,78 @@
+#pragma once
+
+/**
+ * 延迟直方图 (压测工具共用：mini-rpc/src/rpc_bench.cpp、benchmark/echo_bench.cpp)
+ *
+ * 对数-线性分桶 (HdrHistogram 的简化版)，记录纳秒：小于 64 的值各占一格；
+ * 其余按最高位分段，每段再线性分 32 格，相对误差 < 1/64。
+ * 桶数固定 (不到 2K 个)，record 只是一次下标计算，不加锁：每个线程记自己的，最后 merge。
+ */
+#include <cstdint>
+#include <vector>
+
+const int LATENCY_SUB_BITS = 6;
+const int LATENCY_BUCKETS = (1 << LATENCY_SUB_BITS) + (64 - LATENCY_SUB_BITS) * (1 << (LATENCY_SUB_BITS - 1));
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() : counts_(LATENCY_BUCKETS, 0), total_(0), max_(0) {}
+
+    void record(int64_t value) {
+        uint64_t v = value > 0 ? value : 0;
+        counts_[index(v)]++;
+        total_++;
+        if (v > max_) max_ = v;
+    }
+
+    void merge(const LatencyHistogram &other) {
+        for (int i = 0; i < LATENCY_BUCKETS; i++) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        if (other.max_ > max_) max_ = other.max_;
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t max() const { return max_; }
+
+    // p 取 0~100
+    uint64_t percentile(double p) const {
+        if (total_ == 0) return 0;
+        uint64_t rank = (uint64_t)(p / 100.0 * total_);
+        if (rank >= total_) rank = total_ - 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < LATENCY_BUCKETS; i++) {
+            seen += counts_[i];
+            if (seen > rank) {
+                uint64_t v = value(i);
+                return v < max_ ? v : max_;
+            }
+        }
+        return max_;
+    }
+
+private:
+    static int index(uint64_t v) {
+        const uint64_t linear = 1ULL << LATENCY_SUB_BITS;
+        if (v < linear) return (int)v;
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - LATENCY_SUB_BITS + 1;
+        int sub = (int)(v >> shift) - (1 << (LATENCY_SUB_BITS - 1));
+        return (int)linear + (shift - 1) * (1 << (LATENCY_SUB_BITS - 1)) + sub;
+    }
+
+    // 格子的中点
+    static uint64_t value(int idx) {
+        const int linear = 1 << LATENCY_SUB_BITS;
+        if (idx < linear) return idx;
+        int half = 1 << (LATENCY_SUB_BITS - 1);
+        int shift = (idx - linear) / half + 1;
+        uint64_t sub = (idx - linear) % half + half;
+        return (sub << shift) + (1ULL << shift) / 2;
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t total_;
+    uint64_t max_;
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+/**
+ * 监听 socket 的公共创建逻辑 (所有服务器共用)
+ *
+ * 默认模式：一个监听 socket，只设置 SO_REUSEADDR，所有 accept 都排在同一个队列里。
+ * 分片模式 (-s N)：N 个监听 socket 通过 SO_REUSEPORT 绑定到同一个端口，
+ *   内核按四元组哈希把新连接分到不同 socket 的 accept 队列，
+ *   每个 socket 只归一个线程 / 进程所有，没有共享队列，也没有惊群。
+ * CPU 分流 (-c)：给 reuseport 组挂一段 classic BPF，按 "处理该 SYN 的 CPU" 选择 socket，
+ *   配合 bind_to_cpu() 把第 i 个分片固定在 CPU i 上，连接从软中断到用户态都在同一个核。
+ * 交接 (-u PATH)：先向 PATH 上的旧进程索取监听 socket，详见 graceful.h。
+ */
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/filter.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "graceful.h"
+
+#ifndef SO_REUSEPORT
+#define SO_REUSEPORT 15
+#endif
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+struct ListenOptions
+{
+    int shards = 0;             // <= 1 表示不分片，只创建一个监听 socket
+    bool cpu_steering = false;  // 是否按 CPU 分流 (只在分片模式下生效)
+    const char *handoff_path = nullptr;             // 监听 socket 交接用的 Unix socket 路径
+    int drain_timeout_ms = DEFAULT_DRAIN_TIMEOUT_MS; // 排空时等待已有连接结束的上限
+    int idle_timeout_ms = DEFAULT_IDLE_TIMEOUT_MS;   // 连接多久没有收发就关闭，0 表示不限
+};
+
+/**
+ * 解析公共命令行参数
+ *   -s N  使用 N 个 SO_REUSEPORT 监听 socket
+ *   -c    开启 BPF CPU 分流并绑核
+ *   -u P  通过 Unix socket P 接手 / 交出监听 socket
+ *   -d S  排空超时 S 秒
+ *   -I S  连接空闲 S 秒后关闭，0 表示不限
+ * 其余参数原样忽略，由各服务器自己处理
+ */
+inline ListenOptions parse_listen_options(int argc, char *argv[])
+{
+    ListenOptions opts;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            opts.shards = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-c") == 0) {
+            opts.cpu_steering = true;
+        }
+        else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+            opts.handoff_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            opts.drain_timeout_ms = atoi(argv[++i]) * 1000;
+        }
+        else if (strcmp(argv[i], "-I") == 0 && i + 1 < argc) {
+            opts.idle_timeout_ms = atoi(argv[++i]) * 1000;
+        }
+    }
+    return opts;
+}
+
+/**
+ * 创建单个监听 socket：socket() → setsockopt() → bind() → listen()
+ * 失败直接退出进程 (与各服务器原有的错误处理一致)
+ * 监听 socket 是非阻塞的：同一个 socket 可能被多个线程 / 进程 (包括交接后的新进程) 同时 accept，
+ * 阻塞的服务器先用 wait_accept() 等待可读，再 accept，抢不到返回 EAGAIN 继续等待即可
+ */
+inline int create_listen_socket(int port, int backlog, bool reuse_port)
+{
+    // 1. 创建socket
+    int sockfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (sockfd == -1) {
+        perror("failed create socket.");
+        exit(1);
+    }
+
+    // 2. 设置地址复用，避免端口占用；分片模式下再允许多个 socket 绑定同一端口
+    int opt = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (reuse_port && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1) {
+        perror("setsockopt SO_REUSEPORT error");
+        close(sockfd);
+        exit(1);
+    }
+
+    // 3. 绑定
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY; // 监听所有网卡请求
+    address.sin_port = htons(port);
+
+    if (bind(sockfd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+        perror("bind error");
+        close(sockfd);
+        exit(1);
+    }
+
+    // 4. listen 监听
+    if (listen(sockfd, backlog) == -1) {
+        perror("listen error");
+        close(sockfd);
+        exit(1);
+    }
+
+    return sockfd;
+}
+
+/**
+ * 给 reuseport 组挂载 CPU 分流程序：return (当前 CPU) % shard_num
+ * 程序返回的是组内 socket 的下标 (按 bind 顺序)，所以必须在同一个进程里按顺序创建完所有分片后再挂载
+ */
+inline bool attach_reuseport_cpu_bpf(int sockfd, int shard_num)
+{
+    struct sock_filter code[] = {
+        // A = 当前处理数据包的 CPU 编号
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (__u32)(SKF_AD_OFF + SKF_AD_CPU)),
+        // A = A % shard_num
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (__u32)shard_num),
+        // return A
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    struct sock_fprog prog;
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+
+    if (setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == -1) {
+        perror("setsockopt SO_ATTACH_REUSEPORT_CBPF error");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 把调用线程 (或进程) 绑定到 cpu % CPU核数 上
+ */
+inline void bind_to_cpu(int cpu)
+{
+    long cpu_num = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_num <= 0) return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % cpu_num, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) == -1) {
+        perror("sched_setaffinity error");
+    }
+}
+
+/**
+ * 按选项创建监听 socket 列表
+ *  - 不分片：返回 1 个普通监听 socket
+ *  - 分片：返回 N 个绑定在同一端口上的 SO_REUSEPORT socket，第 i 个交给第 i 个线程/进程
+ *  - 交接：有旧进程时直接沿用它的整组监听 socket (分片数和 BPF 分流都以旧进程为准)，
+ *    然后在 handoff_path 上等待下一次交接
+ */
+inline std::vector<int> create_listen_sockets(int port, int backlog, const ListenOptions &opts)
+{
+    std::vector<int> fds;
+    if (opts.handoff_path != nullptr) {
+        fds = receive_listen_fds(opts.handoff_path);
+        if (!fds.empty()) {
+            printf("took over %d listen socket(s) from %s\n", (int)fds.size(), opts.handoff_path);
+            serve_listen_fds_handoff(opts.handoff_path, fds);
+            return fds;
+        }
+        ListenOptions fresh = opts;
+        fresh.handoff_path = nullptr;
+        fds = create_listen_sockets(port, backlog, fresh);
+        serve_listen_fds_handoff(opts.handoff_path, fds);
+        return fds;
+    }
+
+    if (opts.shards <= 1) {
+        fds.push_back(create_listen_socket(port, backlog, false));
+        return fds;
+    }
+
+    for (int i = 0; i < opts.shards; i++) {
+        fds.push_back(create_listen_socket(port, backlog, true));
+    }
+
+    // 挂在任意一个 socket 上即对整个 reuseport 组生效，失败则退回内核默认的哈希分流
+    if (opts.cpu_steering) {
+        attach_reuseport_cpu_bpf(fds[0], opts.shards);
+    }
+    return fds;
+}
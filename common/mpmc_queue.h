@@ -0,0 +1,134 @@
+#pragma once
+
+/**
+ * 有界无锁 MPMC (多生产者多消费者) 环形队列
+ *
+ * 算法来自 Dmitry Vyukov 的 bounded MPMC queue：
+ *  - 每个槽位带一个序号 sequence，生产者/消费者各自用 CAS 抢占 enqueue_pos / dequeue_pos
+ *  - 抢到位置后只读写自己那个槽位，再用 sequence 发布给对方，全程没有锁
+ *  - 容量必须是 2 的幂，下标用 & mask 代替取模
+ *
+ * 队列满时 try_push 返回 false，队列空时 try_pop 返回 false，阻塞/等待策略由调用方决定。
+ */
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+template<typename T>
+class MpmcQueue
+{
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    std::unique_ptr<Cell[]> buffer;
+    size_t mask;
+
+    // 生产者、消费者的游标各占一个 cache line，避免伪共享
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueue_pos;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeue_pos;
+
+public:
+    explicit MpmcQueue(size_t capacity);
+
+    MpmcQueue(const MpmcQueue &) = delete;
+    MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+    // 成功时把 item 移入队列；失败 (队列满) 时 item 保持不变
+    bool try_push(T &item);
+    // 成功时把队头元素移出到 item
+    bool try_pop(T &item);
+
+    size_t capacity() const { return mask + 1; }
+    // 近似元素个数 (并发下只作参考)
+    size_t size_approx() const;
+};
+
+template<typename T>
+MpmcQueue<T>::MpmcQueue(size_t capacity) : enqueue_pos{0}, dequeue_pos{0}
+{
+    // 向上取整到 2 的幂
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    buffer.reset(new Cell[size]);
+    mask = size - 1;
+    for (size_t i = 0; i < size; i++) {
+        buffer[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template<typename T>
+bool MpmcQueue<T>::try_push(T &item)
+{
+    Cell *cell;
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    while (true) {
+        cell = &buffer[pos & mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            // 槽位空闲，尝试占用
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return false; // 队列满
+        }
+        else {
+            pos = enqueue_pos.load(std::memory_order_relaxed); // 被其它生产者抢先，重读
+        }
+    }
+
+    cell->data = std::move(item);
+    cell->sequence.store(pos + 1, std::memory_order_release); // 发布给消费者
+    return true;
+}
+
+template<typename T>
+bool MpmcQueue<T>::try_pop(T &item)
+{
+    Cell *cell;
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    while (true) {
+        cell = &buffer[pos & mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0) {
+            if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return false; // 队列空
+        }
+        else {
+            pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    item = std::move(cell->data);
+    cell->data = T();  // 尽早释放任务捕获的资源
+    cell->sequence.store(pos + mask + 1, std::memory_order_release); // 槽位还给生产者
+    return true;
+}
+
+template<typename T>
+size_t MpmcQueue<T>::size_approx() const
+{
+    size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+    size_t head = dequeue_pos.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+/**
+ * 线程池弹性伸缩参数与运行时统计
+ *
+ * 固定大小的线程池在突发流量下要么大量空闲，要么任务排长队。弹性模式下：
+ *  - 任务排队时间超过 grow_wait_us，或者队列深度超过 grow_depth 时，增加 worker (不超过 max_workers)
+ *  - worker 空闲超过 idle_timeout_ms 就退出 (不少于 min_workers)
+ * 排队时间以 2 的幂 (微秒) 为桶记录成直方图，可用 ThreadPool::stats() 随时读取，用真实流量来调参。
+ */
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <utility>
+
+#include "task.h"
+
+struct ElasticOptions
+{
+    int min_workers = 2;
+    int max_workers = 32;
+    int64_t grow_wait_us = 2000;    // 任务排队超过 2ms 就扩容
+    size_t grow_depth = 64;         // 或者排队任务数超过 64
+    int idle_timeout_ms = 10000;    // 空闲 10s 的 worker 退出
+};
+
+// 单调时钟，纳秒
+inline int64_t pool_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 队列里的任务：带上入队时间，出队时据此计算排队时间
+struct TimedTask
+{
+    Task task;
+    int64_t enqueue_ns = 0;
+
+    TimedTask() = default;
+    explicit TimedTask(Task &&t) : task(std::move(t)), enqueue_ns(pool_now_ns()) {}
+};
+
+/**
+ * 排队时间直方图：第 i 个桶统计 [2^(i-1), 2^i) 微秒，第 0 个桶是 < 1us
+ * 所有计数都是 relaxed 原子操作，记录时不加锁
+ */
+class WaitHistogram
+{
+public:
+    static const int BUCKETS = 24; // 最后一个桶 >= 2^22 us (约 4s)
+
+    void record(int64_t wait_ns)
+    {
+        uint64_t us = wait_ns > 0 ? (uint64_t)wait_ns / 1000 : 0;
+        int bucket = 0;
+        while (us > 0 && bucket < BUCKETS - 1) {
+            us >>= 1;
+            bucket++;
+        }
+        counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t count(int bucket) const { return counts[bucket].load(std::memory_order_relaxed); }
+
+    // 桶的上界 (微秒)
+    static uint64_t bucket_upper_us(int bucket) { return (uint64_t)1 << bucket; }
+
+    // 估算百分位 (返回所在桶的上界，单位微秒)
+    uint64_t percentile_us(double p) const
+    {
+        uint64_t total = 0;
+        for (int i = 0; i < BUCKETS; i++) total += count(i);
+        if (total == 0) return 0;
+
+        uint64_t target = (uint64_t)(total * p);
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += count(i);
+            if (seen > target) return bucket_upper_us(i);
+        }
+        return bucket_upper_us(BUCKETS - 1);
+    }
+
+private:
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+};
+
+// 某一时刻的线程池状态快照
+struct ThreadPoolStats
+{
+    int workers = 0;            // 当前存活的 worker 数
+    int idle_workers = 0;       // 正在等待任务的 worker 数
+    size_t queue_depth = 0;     // 排队中的任务数 (近似值)
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    uint64_t grow_count = 0;    // 累计扩容次数
+    uint64_t shrink_count = 0;  // 累计缩容次数
+    uint64_t wait_p50_us = 0;
+    uint64_t wait_p99_us = 0;
+    uint64_t wait_hist[WaitHistogram::BUCKETS] = {};
+
+    void print(std::ostream &os = std::cout) const
+    {
+        os << "[ThreadPool] workers=" << workers << " idle=" << idle_workers
+           << " depth=" << queue_depth << " submitted=" << submitted << " completed=" << completed
+           << " grow=" << grow_count << " shrink=" << shrink_count
+           << " wait_p50<=" << wait_p50_us << "us wait_p99<=" << wait_p99_us << "us" << std::endl;
+        os << "[ThreadPool] wait histogram:";
+        for (int i = 0; i < WaitHistogram::BUCKETS; i++) {
+            if (wait_hist[i] == 0) continue;
+            os << " <" << WaitHistogram::bucket_upper_us(i) << "us:" << wait_hist[i];
+        }
+        os << std::endl;
+    }
+};
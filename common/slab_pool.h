@@ -0,0 +1,136 @@
+#pragma once
+
+/**
+ * 定长对象的 slab 内存池
+ *
+ * 一次向系统申请一整块 (SLAB_OBJECTS 个对象，默认 256)，切成等长的槽位串成空闲链表；
+ * 每个线程再缓存一小批空闲槽位，分配 / 释放绝大多数时候只操作线程本地链表，不加锁也不 malloc。
+ * 本地缓存过多时成批还给全局链表，过少时成批从全局链表取。
+ * 本地缓存上限 LOCAL_CACHE_MAX 和批大小 BATCH 可调：对象大的 (比如 64KB 的缓冲区) 应该设小，
+ * 否则每个线程 / 进程第一次分配就要一次拿走 BATCH 个对象。
+ *
+ * 只分配原始内存，对象的构造 / 析构由调用方负责 (placement new)。
+ * slab 在进程生命周期内不归还给系统。
+ */
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+// LOCAL_CACHE_MAX：线程本地最多缓存的空闲槽位数；BATCH：与全局链表交换的批大小
+template<size_t OBJECT_SIZE, size_t OBJECT_ALIGN, size_t SLAB_OBJECTS = 256,
+         size_t LOCAL_CACHE_MAX = 64, size_t BATCH = 32>
+class SlabPool
+{
+private:
+    static_assert(BATCH >= 1 && BATCH <= LOCAL_CACHE_MAX, "BATCH must be in [1, LOCAL_CACHE_MAX]");
+
+    static const size_t OBJECTS_PER_SLAB = SLAB_OBJECTS;
+
+    struct FreeNode { FreeNode *next; };
+
+    // 槽位大小：至少能放下链表指针，并按对齐要求向上取整
+    static const size_t RAW_SIZE = OBJECT_SIZE > sizeof(FreeNode) ? OBJECT_SIZE : sizeof(FreeNode);
+    static const size_t SLOT_ALIGN = OBJECT_ALIGN > alignof(FreeNode) ? OBJECT_ALIGN : alignof(FreeNode);
+    static const size_t SLOT_SIZE = (RAW_SIZE + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN;
+
+    struct LocalCache
+    {
+        FreeNode *head = nullptr;
+        size_t count = 0;
+
+        ~LocalCache()
+        {
+            // 线程退出时把缓存还给全局链表
+            while (head) {
+                FreeNode *node = head;
+                head = head->next;
+                SlabPool::global().push_global(node);
+            }
+        }
+    };
+
+    std::mutex m_mutex;
+    FreeNode *global_head = nullptr;
+
+    static SlabPool &global()
+    {
+        // 故意不析构：线程本地缓存可能在静态对象析构之后才归还
+        static SlabPool *pool = new SlabPool();
+        return *pool;
+    }
+
+    static LocalCache &local()
+    {
+        static thread_local LocalCache cache;
+        return cache;
+    }
+
+    void push_global(FreeNode *node)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        node->next = global_head;
+        global_head = node;
+    }
+
+    // 从全局链表取一批到本地缓存，全局也空了就新切一个 slab
+    void refill(LocalCache &cache)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (global_head == nullptr) {
+            char *slab = static_cast<char*>(::operator new(SLOT_SIZE * OBJECTS_PER_SLAB + SLOT_ALIGN));
+            // 手动对齐首个槽位
+            size_t offset = (SLOT_ALIGN - reinterpret_cast<size_t>(slab) % SLOT_ALIGN) % SLOT_ALIGN;
+            slab += offset;
+            for (size_t i = 0; i < OBJECTS_PER_SLAB; i++) {
+                FreeNode *node = reinterpret_cast<FreeNode*>(slab + i * SLOT_SIZE);
+                node->next = global_head;
+                global_head = node;
+            }
+        }
+
+        for (size_t i = 0; i < BATCH && global_head; i++) {
+            FreeNode *node = global_head;
+            global_head = node->next;
+            node->next = cache.head;
+            cache.head = node;
+            cache.count++;
+        }
+    }
+
+    void flush(LocalCache &cache)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < BATCH && cache.head; i++) {
+            FreeNode *node = cache.head;
+            cache.head = node->next;
+            cache.count--;
+            node->next = global_head;
+            global_head = node;
+        }
+    }
+
+public:
+    static void *allocate()
+    {
+        LocalCache &cache = local();
+        if (cache.head == nullptr) {
+            global().refill(cache);
+        }
+        FreeNode *node = cache.head;
+        cache.head = node->next;
+        cache.count--;
+        return node;
+    }
+
+    static void deallocate(void *p)
+    {
+        LocalCache &cache = local();
+        FreeNode *node = static_cast<FreeNode*>(p);
+        node->next = cache.head;
+        cache.head = node;
+        cache.count++;
+        if (cache.count > LOCAL_CACHE_MAX) {
+            global().flush(cache);
+        }
+    }
+};
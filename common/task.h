@@ -0,0 +1,142 @@
+#pragma once
+
+/**
+ * 只能移动的任务类型 (替代 std::function<void()>)
+ *
+ * std::function 要求可拷贝，捕获稍大一点就会在堆上分配；线程池里的任务只会被执行一次，
+ * 用不到拷贝。Task 内置 INLINE_SIZE 字节的小缓冲区：
+ *  - 可调用对象放得下 (且可 nothrow 移动) 时直接原地构造，入队 / 出队 / 执行全程零 malloc
+ *    例如 "处理函数指针 + client_fd + sockaddr_in" 只有 32 字节左右
+ *  - 放不下时才退回堆分配
+ * sizeof(Task) 正好是一个 cache line。
+ */
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+class Task
+{
+public:
+    static const size_t INLINE_SIZE = 56;
+
+    Task() noexcept : ops{nullptr} {}
+    Task(std::nullptr_t) noexcept : ops{nullptr} {}
+
+    template<class F, class = typename std::enable_if<
+        !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&f) : ops{nullptr}
+    {
+        typedef typename std::decay<F>::type Fn;
+        if (fits_inline<Fn>()) {
+            new (storage) Fn(std::forward<F>(f));
+            ops = inline_ops<Fn>();
+        }
+        else {
+            *reinterpret_cast<Fn**>(storage) = new Fn(std::forward<F>(f));
+            ops = heap_ops<Fn>();
+        }
+    }
+
+    Task(Task &&other) noexcept : ops{other.ops}
+    {
+        if (ops) {
+            ops->move(storage, other.storage);
+            other.ops = nullptr;
+        }
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            ops = other.ops;
+            if (ops) {
+                ops->move(storage, other.storage);
+                other.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task &operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task() { reset(); }
+
+    explicit operator bool() const noexcept { return ops != nullptr; }
+
+    void operator()() { ops->invoke(storage); }
+
+    // 是否存放在内联缓冲区 (用于观察 / 调试是否发生了堆分配)
+    bool is_inline() const noexcept { return ops != nullptr && ops->is_inline; }
+
+private:
+    struct Ops
+    {
+        void (*invoke)(void *self);
+        void (*move)(void *dst, void *src);   // 移动到 dst 并销毁 src
+        void (*destroy)(void *self);
+        bool is_inline;
+    };
+
+    template<class Fn>
+    static constexpr bool fits_inline()
+    {
+        return sizeof(Fn) <= INLINE_SIZE
+            && alignof(Fn) <= alignof(std::max_align_t)
+            && std::is_nothrow_move_constructible<Fn>::value;
+    }
+
+    // 内联存放：storage 里就是 Fn 对象本身
+    template<class Fn>
+    static void inline_invoke(void *self) { (*static_cast<Fn*>(self))(); }
+    template<class Fn>
+    static void inline_move(void *dst, void *src)
+    {
+        Fn *from = static_cast<Fn*>(src);
+        new (dst) Fn(std::move(*from));
+        from->~Fn();
+    }
+    template<class Fn>
+    static void inline_destroy(void *self) { static_cast<Fn*>(self)->~Fn(); }
+
+    // 堆上存放：storage 里是 Fn*
+    template<class Fn>
+    static void heap_invoke(void *self) { (**static_cast<Fn**>(self))(); }
+    template<class Fn>
+    static void heap_move(void *dst, void *src) { *static_cast<Fn**>(dst) = *static_cast<Fn**>(src); }
+    template<class Fn>
+    static void heap_destroy(void *self) { delete *static_cast<Fn**>(self); }
+
+    // 每种可调用类型一张静态操作表 (常量初始化，无运行时开销)
+    template<class Fn>
+    static const Ops *inline_ops()
+    {
+        static const Ops table = { &inline_invoke<Fn>, &inline_move<Fn>, &inline_destroy<Fn>, true };
+        return &table;
+    }
+    template<class Fn>
+    static const Ops *heap_ops()
+    {
+        static const Ops table = { &heap_invoke<Fn>, &heap_move<Fn>, &heap_destroy<Fn>, false };
+        return &table;
+    }
+
+    void reset() noexcept
+    {
+        if (ops) {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+    const Ops *ops;
+};
@@ -0,0 +1,230 @@
+#pragma once
+
+/**
+ * 线程池 submit(f, args...) 返回的 future 句柄
+ *
+ * 与 std::future 的区别：
+ *  - 共享状态 (结果 / 异常 / 完成标记 / 引用计数) 从 SlabPool 分配，不走 malloc
+ *  - 完成标记本身就是 futex 字，get() 在结果未就绪时 park，不需要 mutex + condition_variable
+ *  - 执行端是只能移动的 TaskRunner，配合 Task 的内联缓冲区，整个提交过程零堆分配
+ *
+ * 任务还没执行就被丢弃 (例如线程池停止) 时，get() 抛出 std::future_error(broken_promise)。
+ */
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "futex.h"
+#include "slab_pool.h"
+
+namespace detail {
+
+// 结果存储：普通类型放在未初始化的内存里，void 不需要存储
+template<typename R>
+struct ResultHolder
+{
+    alignas(R) unsigned char storage[sizeof(R)];
+    bool has_value = false;
+
+    template<typename F>
+    void run(F &f)
+    {
+        new (storage) R(f());
+        has_value = true;
+    }
+    R take() { return std::move(*reinterpret_cast<R*>(storage)); }
+    ~ResultHolder()
+    {
+        if (has_value) reinterpret_cast<R*>(storage)->~R();
+    }
+};
+
+template<>
+struct ResultHolder<void>
+{
+    template<typename F>
+    void run(F &f) { f(); }
+    void take() {}
+};
+
+template<typename R>
+struct TaskState
+{
+    enum : uint32_t { PENDING = 0, READY = 1, WAITING = 2 };
+
+    std::atomic<int> refs{2};                // future 句柄 + 执行端各持有一个引用
+    std::atomic<uint32_t> status{PENDING};   // futex 字
+    std::exception_ptr error;
+    ResultHolder<R> result;
+
+    // 每种结果类型一个 slab 池 (成员函数体内 TaskState 已是完整类型)
+    static TaskState *create()
+    {
+        typedef SlabPool<sizeof(TaskState), alignof(TaskState)> Pool;
+        return new (Pool::allocate()) TaskState();
+    }
+
+    void release()
+    {
+        typedef SlabPool<sizeof(TaskState), alignof(TaskState)> Pool;
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->~TaskState();
+            Pool::deallocate(this);
+        }
+    }
+
+    void set_ready()
+    {
+        if (status.exchange(READY, std::memory_order_acq_rel) == WAITING) {
+            futex_wake(&status, INT_MAX);
+        }
+    }
+
+    void wait()
+    {
+        uint32_t s = status.load(std::memory_order_acquire);
+        while (s != READY) {
+            // 标记有人在等，执行端完成时才需要发 futex_wake
+            if (s == PENDING && !status.compare_exchange_weak(s, WAITING, std::memory_order_acq_rel)) {
+                continue;
+            }
+            futex_wait(&status, WAITING);
+            s = status.load(std::memory_order_acquire);
+        }
+    }
+};
+
+} // namespace detail
+
+
+template<typename R>
+class TaskFuture
+{
+private:
+    detail::TaskState<R> *state;
+
+public:
+    TaskFuture() noexcept : state{nullptr} {}
+    explicit TaskFuture(detail::TaskState<R> *s) noexcept : state{s} {}
+
+    TaskFuture(TaskFuture &&other) noexcept : state{other.state} { other.state = nullptr; }
+    TaskFuture &operator=(TaskFuture &&other) noexcept
+    {
+        if (this != &other) {
+            if (state) state->release();
+            state = other.state;
+            other.state = nullptr;
+        }
+        return *this;
+    }
+    TaskFuture(const TaskFuture &) = delete;
+    TaskFuture &operator=(const TaskFuture &) = delete;
+
+    ~TaskFuture() { if (state) state->release(); }
+
+    bool valid() const noexcept { return state != nullptr; }
+
+    bool ready() const noexcept
+    {
+        return state && state->status.load(std::memory_order_acquire) == detail::TaskState<R>::READY;
+    }
+
+    void wait() const { state->wait(); }
+
+    // 阻塞直到任务完成，返回结果或重新抛出任务中的异常；只能调用一次
+    R get()
+    {
+        state->wait();
+        detail::TaskState<R> *s = state;
+        state = nullptr;
+
+        struct Releaser
+        {
+            detail::TaskState<R> *s;
+            ~Releaser() { s->release(); }
+        } releaser{s};
+
+        if (s->error) {
+            std::rethrow_exception(s->error);
+        }
+        return s->result.take();
+    }
+};
+
+
+/**
+ * 执行端：持有绑定好参数的可调用对象和共享状态
+ * 只能移动；被执行后把结果写入共享状态，未执行就析构时写入 broken_promise
+ */
+template<typename R, typename Fn>
+class TaskRunner
+{
+private:
+    Fn fn;
+    detail::TaskState<R> *state;
+
+public:
+    TaskRunner(Fn &&f, detail::TaskState<R> *s) : fn(std::move(f)), state{s} {}
+
+    TaskRunner(TaskRunner &&other) noexcept(std::is_nothrow_move_constructible<Fn>::value)
+        : fn(std::move(other.fn)), state{other.state}
+    {
+        other.state = nullptr;
+    }
+    TaskRunner(const TaskRunner &) = delete;
+
+    ~TaskRunner()
+    {
+        if (state) {
+            state->error = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+            state->set_ready();
+            state->release();
+        }
+    }
+
+    void operator()()
+    {
+        try {
+            state->result.run(fn);
+        }
+        catch (...) {
+            state->error = std::current_exception();
+        }
+        state->set_ready();
+        state->release();
+        state = nullptr;
+    }
+};
+
+
+// submit(f, args...) 相关的类型推导：参数按值绑定 (与 std::thread / std::async 一致)
+template<class F, class... Args>
+struct TaskTraits
+{
+    typedef decltype(std::bind(std::declval<F>(), std::declval<Args>()...)) Bound;
+    typedef decltype(std::declval<Bound&>()()) Result;
+    typedef TaskRunner<Result, Bound> Runner;
+    typedef TaskFuture<Result> Future;
+};
+
+/**
+ * 把 f(args...) 打包成 (执行端, future)：执行端放进线程池的 Task，future 返回给调用方
+ */
+template<class F, class... Args>
+std::pair<typename TaskTraits<F, Args...>::Runner, typename TaskTraits<F, Args...>::Future>
+make_task(F &&f, Args&&... args)
+{
+    typedef TaskTraits<F, Args...> Traits;
+    typedef typename Traits::Result R;
+
+    detail::TaskState<R> *state = detail::TaskState<R>::create();
+    return std::make_pair(
+        typename Traits::Runner(std::bind(std::forward<F>(f), std::forward<Args>(args)...), state),
+        typename Traits::Future(state));
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+/**
+ * 分层时间轮 (hashed hierarchical timing wheel)，给事件循环管理大量超时用
+ *
+ * 4 层，每层 64 个槽，第 L 层一个槽覆盖 64^L 个 tick：
+ *  - 定时器按 "距离到期还有多少 tick" 放进对应的层，槽号取到期 tick 在这一层的那 6 位
+ *  - 走到第 L 层某个槽的起点时，把槽里的定时器按剩余时间重新放到下面的层 (级联)，最终落到第 0 层到期
+ *  - 节点侵入式地嵌在调用方的结构体里，双向链表挂在槽上：arm / cancel 都是 O(1)，不分配内存
+ *  - 每层一个 64 位的非空位图：下一次到期 (或级联) 的时间用循环移位 + ctz 算出来，
+ *    next_timeout_ms() 直接当 epoll_wait 的超时，没有定时器时返回 -1，不需要固定频率的 tick 唤醒
+ * 超过 64^4 个 tick 的定时器先放在最高层，级联时再按真实到期时间重新放。
+ * 不加锁：一个时间轮只在一个线程里用，或者由调用方加锁。
+ */
+#include <cstddef>
+#include <cstdint>
+
+const int TIMER_WHEEL_BITS = 6;
+const int TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_BITS;    // 每层的槽数
+const int TIMER_WHEEL_LEVELS = 4;
+
+// 嵌在调用方结构体里的定时器节点；全 0 (memset) 就是未 arm 的状态
+struct TimerNode
+{
+    TimerNode *prev = nullptr;
+    TimerNode *next = nullptr;
+    uint64_t expire = 0;    // 到期的 tick
+    int slot = 0;           // 所在的槽：层 * 64 + 槽号
+    void *data = nullptr;   // 调用方自己的指针，到期回调里用来找回所属对象
+
+    bool armed() const { return prev != nullptr; }
+};
+
+class TimingWheel
+{
+public:
+    // now_ms：当前时间 (调用方的单调时钟)；tick_ms：时间轮的精度，到期最多晚一个 tick
+    explicit TimingWheel(int64_t now_ms, int tick_ms = 1) : tick_ms_(tick_ms), current_(now_ms / tick_ms) {
+        for (int i = 0; i < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; i++) {
+            slots_[i].prev = slots_[i].next = &slots_[i];
+        }
+        for (int l = 0; l < TIMER_WHEEL_LEVELS; l++) {
+            bitmap_[l] = 0;
+        }
+    }
+
+    TimingWheel(const TimingWheel &) = delete;
+    TimingWheel &operator=(const TimingWheel &) = delete;
+
+    // 在 deadline_ms 到期 (已经 arm 的先撤销)；不会早于 deadline_ms 到期
+    void arm(TimerNode *node, int64_t deadline_ms) {
+        if (node->armed()) {
+            cancel(node);
+        }
+        int64_t tick = (deadline_ms + tick_ms_ - 1) / tick_ms_;
+        node->expire = tick < (int64_t)current_ ? current_ : (uint64_t)tick;
+        place(node);
+        size_++;
+    }
+
+    void cancel(TimerNode *node) {
+        if (!node->armed()) return;
+        unlink(node);
+        size_--;
+    }
+
+    size_t size() const { return size_; }
+
+    /**
+     * 推进到 now_ms，对每个到期的节点调用 f(TimerNode*)
+     * 回调之前节点已经摘下来了，回调里可以重新 arm 它，也可以 arm / cancel 别的节点
+     * 返回到期的个数
+     */
+    template <typename F>
+    size_t advance(int64_t now_ms, F f) {
+        uint64_t target = now_ms / tick_ms_;
+        size_t fired = 0;
+        while (current_ <= target) {
+            uint64_t tick = next_tick();
+            if (tick > target) {
+                current_ = target + 1;
+                break;
+            }
+            current_ = tick;
+
+            // 先从高层往下级联，到期的节点才会出现在第 0 层的这个槽里
+            for (int l = TIMER_WHEEL_LEVELS - 1; l > 0; l--) {
+                int shift = l * TIMER_WHEEL_BITS;
+                if ((tick & ((1ULL << shift) - 1)) != 0) continue;
+                TimerNode list;
+                take(l * TIMER_WHEEL_SLOTS + (int)((tick >> shift) & (TIMER_WHEEL_SLOTS - 1)), &list);
+                while (list.next != &list) {
+                    TimerNode *node = list.next;
+                    remove(node);
+                    place(node);
+                }
+            }
+
+            TimerNode list;
+            take((int)(tick & (TIMER_WHEEL_SLOTS - 1)), &list);
+            current_ = tick + 1;
+            // 回调可能 cancel 掉 list 里还没轮到的节点，所以每次从 list 头上取
+            while (list.next != &list) {
+                TimerNode *node = list.next;
+                remove(node);
+                node->prev = node->next = nullptr;
+                size_--;
+                fired++;
+                f(node);
+            }
+        }
+        return fired;
+    }
+
+    // 距离下一次需要 advance 还有多少毫秒 (至少 0)，没有定时器返回 -1
+    int next_timeout_ms(int64_t now_ms) const {
+        if (size_ == 0) return -1;
+        int64_t wait = (int64_t)next_tick() * tick_ms_ - now_ms;
+        if (wait < 0) return 0;
+        return wait > INT32_MAX ? INT32_MAX : (int)wait;
+    }
+
+private:
+    // 按到期时间放进对应层的槽
+    void place(TimerNode *node) {
+        uint64_t delta = node->expire > current_ ? node->expire - current_ : 0;
+        uint64_t expire = node->expire < current_ ? current_ : node->expire;
+        int level = 0;
+        while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << ((level + 1) * TIMER_WHEEL_BITS))) {
+            level++;
+        }
+        // 超出最高层的范围：先放在最高层最远的槽，级联时再按真实到期时间放
+        uint64_t span = 1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS);
+        if (delta >= span) {
+            expire = current_ + span - 1;
+        }
+        int shift = level * TIMER_WHEEL_BITS;
+        int index = (int)((expire >> shift) & (TIMER_WHEEL_SLOTS - 1));
+
+        node->slot = level * TIMER_WHEEL_SLOTS + index;
+        TimerNode *head = &slots_[node->slot];
+        node->prev = head->prev;
+        node->next = head;
+        head->prev->next = node;
+        head->prev = node;
+        bitmap_[level] |= 1ULL << index;
+    }
+
+    static void remove(TimerNode *node) {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+    }
+
+    void unlink(TimerNode *node) {
+        remove(node);
+        node->prev = node->next = nullptr;
+        TimerNode *head = &slots_[node->slot];
+        if (head->next == head) {
+            bitmap_[node->slot / TIMER_WHEEL_SLOTS] &= ~(1ULL << (node->slot % TIMER_WHEEL_SLOTS));
+        }
+    }
+
+    // 把整个槽的链表搬到 list 上 (list 作为新的表头)，槽清空
+    void take(int slot, TimerNode *list) {
+        TimerNode *head = &slots_[slot];
+        if (head->next == head) {
+            list->prev = list->next = list;
+            return;
+        }
+        list->next = head->next;
+        list->prev = head->prev;
+        list->next->prev = list;
+        list->prev->next = list;
+        head->prev = head->next = head;
+        bitmap_[slot / TIMER_WHEEL_SLOTS] &= ~(1ULL << (slot % TIMER_WHEEL_SLOTS));
+    }
+
+    /**
+     * 从 current_ 起第一个需要处理的 tick：第 0 层的非空槽，或者高层非空槽的起点 (要级联)
+     * 高层的当前槽：current_ 正好在槽的起点说明还没级联，否则它代表的是转一圈之后
+     */
+    uint64_t next_tick() const {
+        uint64_t best = UINT64_MAX;
+        for (int l = 0; l < TIMER_WHEEL_LEVELS; l++) {
+            uint64_t bits = bitmap_[l];
+            if (bits == 0) continue;
+            int shift = l * TIMER_WHEEL_BITS;
+            uint64_t block = current_ >> shift;
+            int pos = (int)(block & (TIMER_WHEEL_SLOTS - 1));
+            uint64_t rotated = pos == 0 ? bits : (bits >> pos) | (bits << (TIMER_WHEEL_SLOTS - pos));
+
+            uint64_t distance;
+            if (l == 0 || (current_ & ((1ULL << shift) - 1)) == 0) {
+                distance = __builtin_ctzll(rotated);
+            }
+            else {
+                uint64_t later = rotated & ~1ULL;
+                distance = later != 0 ? __builtin_ctzll(later) : TIMER_WHEEL_SLOTS;
+            }
+
+            uint64_t tick = l == 0 ? current_ + distance : (block + distance) << shift;
+            if (tick < best) best = tick;
+        }
+        return best;
+    }
+
+    int tick_ms_;
+    uint64_t current_;      // 下一个要处理的 tick，之前的都已经处理过
+    size_t size_ = 0;
+    uint64_t bitmap_[TIMER_WHEEL_LEVELS];
+    TimerNode slots_[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];   // 每个槽一个哨兵节点
+};
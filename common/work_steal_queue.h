@@ -0,0 +1,54 @@
+#pragma once
+
+/**
+ * 工作窃取 (work stealing) 用的每线程双端队列
+ *
+ *  - 所属 worker 从尾部 push / pop (LIFO)：刚提交的子任务数据还在 cache 里，优先执行
+ *  - 其它空闲 worker 从头部 steal (FIFO)：偷走的是最老、通常也是最大的任务
+ *
+ * 每个队列一把独立的小锁，只有所属 worker 和偶尔来偷的线程会竞争，
+ * 不再有全局的 m_mutex；对齐到 cache line 避免相邻队列伪共享。
+ */
+#include <deque>
+#include <mutex>
+#include <utility>
+
+template<typename T>
+struct alignas(64) WorkStealQueue
+{
+    std::mutex m_mutex;
+    std::deque<T> items;
+
+    void push(T &&item)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        items.push_back(std::move(item));
+    }
+
+    // 所属 worker 调用：取最新的任务
+    bool pop(T &item)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (items.empty()) return false;
+        item = std::move(items.back());
+        items.pop_back();
+        return true;
+    }
+
+    // 其它 worker 调用：取最老的任务
+    // wait_lock = false 时队列正忙就直接放弃去偷下一个；睡眠前的最后一次检查传 true，保证不漏任务
+    bool steal(T &item, bool wait_lock = false)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+        if (wait_lock) {
+            lock.lock();
+        }
+        else if (!lock.try_lock()) {
+            return false;
+        }
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        return true;
+    }
+};
@@ -0,0 +1,509 @@
+/**
+ * Epoll TCP 服务器 (主从 Reactor 模式, one loop per thread)
+ *
+ * 单线程 epoll 服务器的吞吐上限就是一个 CPU 核，这里拆成两层：
+ *  - 主 Reactor (main thread)：只负责 accept，拿到 fd 后轮询分发给某个子 Reactor
+ *  - 子 Reactor (N 个线程)：每个线程一个 epoll 实例 + 自己的连接表，负责该连接全部的 recv/send
+ *
+ * 一个连接从建立到关闭只属于一个子 Reactor，收发数据不需要任何锁；
+ * 主从之间只在交接 fd 时通过 eventfd 唤醒一次。
+ *
+ * 空闲超时：每个子 Reactor 一个时间轮 (common/timing_wheel.h)，连接超过 -I 秒没有收发就关闭，
+ * 下一次到期就是 epoll_wait 的超时。
+ *
+ * 排空 / 交接：监听 socket 由 create_listen_sockets() 创建 (或者从旧进程接手)，
+ * 主 Reactor 和每个子 Reactor 都在自己的 epoll 上注册排空通知：SIGTERM / SIGINT 后主 Reactor 停止 accept，
+ * 子 Reactor 等自己的连接都断开或者排空超时后退出。
+ *
+ * 用法: ./epoll_multi_reactor [子Reactor数量] [-I 空闲秒数] [-s N] [-u PATH] [-d 秒]
+ *   子Reactor数量默认 = CPU 核数，只能是第一个参数；-I 默认 60 秒，0 表示不限；其余见 common/listen_socket.h
+ */
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <cstdlib>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <ctime>
+
+#include "../common/listen_socket.h"
+#include "../common/timing_wheel.h"
+
+// build bash: g++ -std=c++11 -pthread epoll_multi_reactor.cc -o epoll_multi_reactor
+
+const int PORT = 8080;
+const int BUFFER_SIZE = 1024;
+const int MAX_EVENTS = 1024; // 一次最大处理的事件数量
+const size_t HIGH_WATER_MARK = 4 * 1024 * 1024; // 输出缓冲区上限
+const int TIMER_TICK_MS = 10;                   // 空闲超时的精度
+
+
+void epoll_multi_reactor_server(int loop_num, const ListenOptions &opts);
+
+int main(int argc, char *argv[]) {
+    int loop_num = std::thread::hardware_concurrency();
+    if (argc > 1 && argv[1][0] != '-') {
+        loop_num = atoi(argv[1]);
+    }
+    if (loop_num <= 0) {
+        loop_num = 1;
+    }
+
+    ListenOptions opts = parse_listen_options(argc, argv);
+    graceful_init(opts.drain_timeout_ms);
+
+    epoll_multi_reactor_server(loop_num, opts);
+
+    return 0;
+}
+
+int64_t monotonic_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// 子 Reactor 里一个连接的状态
+struct Connection
+{
+    int fd = -1;
+    std::string out;                // 尚未发送出去的数据
+    bool read_closed = false;       // 对端已经关闭写端：不再读，积压数据发完再关闭
+    int64_t last_active_ms = 0;     // 最后一次有读写事件的时间，定时器到期时再决定顺延还是关闭
+    TimerNode idle_timer;           // data 指向所属的 Connection
+};
+
+/**
+ * 子 Reactor：一个线程 + 一个 epoll + 一张连接表
+ * 除了 add_connection() 以外的成员只允许在自己的线程中访问
+ */
+class SubReactor
+{
+private:
+    int id;
+    int epfd;
+    int wakeup_fd;                  // eventfd, 主 Reactor 用它唤醒阻塞在 epoll_wait 的子 Reactor
+    int drain_fd;                   // 排空通知 (所有 Reactor 共用，一直可读)
+    std::thread loop_thread;
+
+    std::mutex pending_mutex;
+    std::vector<int> pending_fds;   // 主 Reactor 交过来、还没注册到 epoll 的新连接
+
+    // 连接表：fd -> 连接状态（ET 模式 + 输出缓冲区，同 epoll_tcp_et.cc）
+    // unordered_map 的元素地址不会因为扩容改变，定时器节点可以直接嵌在里面
+    std::unordered_map<int, Connection> connections;
+    int idle_timeout_ms;
+    TimingWheel wheel;
+
+public:
+    SubReactor(int id, int idle_timeout_ms);
+    ~SubReactor();
+
+    // 由主 Reactor 调用（跨线程）：把新连接交给本 Reactor
+    void add_connection(int client_fd);
+
+private:
+    void loop();
+    void handle_wakeup();
+    void update_events(int fd, bool want_write);
+    void close_connection(int fd);
+    bool flush_output(int fd, std::string &out);
+    bool handle_read(Connection &conn);
+};
+
+SubReactor::SubReactor(int id, int idle_timeout_ms)
+    : id{id}, idle_timeout_ms{idle_timeout_ms}, wheel(monotonic_ms(), TIMER_TICK_MS)
+{
+    epfd = epoll_create(1);
+    wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epfd == -1 || wakeup_fd == -1) {
+        perror("sub reactor create error");
+        exit(1);
+    }
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = wakeup_fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, wakeup_fd, &event) == -1) {
+        perror("epoll_ctl error");
+        exit(1);
+    }
+    drain_fd = drain_state().event_fd;
+    if (drain_fd != -1) {
+        event.data.fd = drain_fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, drain_fd, &event);
+    }
+
+    loop_thread = std::thread(&SubReactor::loop, this);
+}
+
+SubReactor::~SubReactor()
+{
+    // 事件循环在排空结束后退出
+    if (loop_thread.joinable()) {
+        loop_thread.join();
+    }
+}
+
+void SubReactor::add_connection(int client_fd)
+{
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        pending_fds.push_back(client_fd);
+    }
+
+    // 唤醒子 Reactor，让它在自己的线程里注册这个 fd
+    uint64_t one = 1;
+    if (write(wakeup_fd, &one, sizeof(one)) != sizeof(one)) {
+        perror("wakeup write error");
+    }
+}
+
+void SubReactor::handle_wakeup()
+{
+    uint64_t count;
+    while (read(wakeup_fd, &count, sizeof(count)) > 0); // 清空计数
+
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        fds.swap(pending_fds);
+    }
+
+    int64_t now_ms = monotonic_ms();
+    for (int client_fd : fds) {
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        event.data.fd = client_fd;
+
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, client_fd, &event) == -1) {
+            perror("epoll_ctl error");
+            close(client_fd);
+            continue;
+        }
+        Connection &conn = connections[client_fd];
+        conn.fd = client_fd;
+        conn.out.clear();
+        conn.read_closed = false;
+        conn.last_active_ms = now_ms;
+        if (idle_timeout_ms > 0) {
+            conn.idle_timer.data = &conn;
+            wheel.arm(&conn.idle_timer, now_ms + idle_timeout_ms);
+        }
+    }
+}
+
+void SubReactor::update_events(int fd, bool want_write)
+{
+    epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    if (want_write) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.fd = fd;
+
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &event) == -1) {
+        perror("epoll_ctl mod error");
+    }
+}
+
+void SubReactor::close_connection(int fd)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    auto it = connections.find(fd);
+    if (it != connections.end()) {
+        wheel.cancel(&it->second.idle_timer);
+        connections.erase(it);
+    }
+}
+
+bool SubReactor::flush_output(int fd, std::string &out)
+{
+    size_t sent = 0;
+    while (sent < out.size()) {
+        ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+            continue;
+        }
+
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+
+        perror("send error");
+        return false;
+    }
+
+    out.erase(0, sent);
+    return true;
+}
+
+bool SubReactor::handle_read(Connection &conn)
+{
+    int fd = conn.fd;
+    std::string &out = conn.out;
+    char buffer[BUFFER_SIZE];
+
+    while (true) { // ET 模式：必须读到 EAGAIN 为止
+        ssize_t bytes_read = recv(fd, buffer, BUFFER_SIZE, 0);
+
+        if (bytes_read > 0) {
+            if (out.empty()) {
+                // 没有积压时直接发送，只缓存没发完的部分
+                ssize_t n = send(fd, buffer, bytes_read, MSG_NOSIGNAL);
+                if (n == -1) {
+                    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                        perror("send error");
+                        close_connection(fd);
+                        return false;
+                    }
+                    n = 0;
+                }
+                out.append(buffer + n, bytes_read - n);
+            }
+            else {
+                out.append(buffer, bytes_read);
+            }
+
+            if (out.size() > HIGH_WATER_MARK) {
+                std::cout << "[Loop " << id << "] Client " << fd << " output buffer overflow, close" << std::endl;
+                close_connection(fd);
+                return false;
+            }
+        }
+        else if (bytes_read == 0) {
+            // 对端关闭写端：还有积压的回显数据就先停止读取，等 EPOLLOUT 发完再关闭
+            if (out.empty()) {
+                close_connection(fd);
+                return false;
+            }
+            conn.read_closed = true;
+            return true;
+        }
+        else {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+
+            perror("recv error");
+            close_connection(fd);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SubReactor::loop()
+{
+    epoll_event events[MAX_EVENTS];
+    bool is_draining = false;
+
+    while (true) {
+        // 睡到最近的空闲超时，没有定时器时一直等；排空中连接都关闭了或者到了截止时间就退出
+        int timeout = wheel.next_timeout_ms(monotonic_ms());
+        if (is_draining) {
+            int drain_timeout = drain_remaining_ms();
+            if (connections.empty() || drain_timeout == 0) {
+                break;
+            }
+            if (timeout == -1 || drain_timeout < timeout) {
+                timeout = drain_timeout;
+            }
+        }
+
+        int n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait error");
+            break;
+        }
+        int64_t now_ms = monotonic_ms();
+
+        for (int i = 0; i < n; i++)
+        {
+            int c_fd = events[i].data.fd;
+            uint32_t revents = events[i].events;
+
+            // 主 Reactor 交来了新连接
+            if (c_fd == wakeup_fd) {
+                handle_wakeup();
+                continue;
+            }
+
+            // 开始排空：主 Reactor 不再交来新连接，eventfd 一直可读，摘掉
+            if (c_fd == drain_fd) {
+                epoll_ctl(epfd, EPOLL_CTL_DEL, drain_fd, NULL);
+                is_draining = true;
+                continue;
+            }
+
+            // 同一批事件里已经关闭的连接不在表里
+            auto it = connections.find(c_fd);
+            if (it == connections.end()) {
+                continue;
+            }
+            if (revents & (EPOLLERR | EPOLLHUP)) {
+                close_connection(c_fd);
+                continue;
+            }
+
+            // ET 模式下可读 / 可写事件只在有新数据或者对端读走数据时触发，都算一次收发
+            Connection &conn = it->second;
+            conn.last_active_ms = now_ms;
+            std::string &out = conn.out;
+            bool was_pending = !out.empty();
+
+            if (revents & EPOLLOUT) {
+                if (!flush_output(c_fd, out)) {
+                    close_connection(c_fd);
+                    continue;
+                }
+            }
+
+            if (!conn.read_closed && (revents & (EPOLLIN | EPOLLRDHUP))) {
+                if (!handle_read(conn)) {
+                    continue;
+                }
+            }
+
+            // 对端已经关闭写端，积压的回显数据也发完了
+            if (conn.read_closed && out.empty()) {
+                close_connection(c_fd);
+                continue;
+            }
+
+            bool is_pending = !out.empty();
+            if (is_pending != was_pending) {
+                update_events(c_fd, is_pending);
+            }
+        }
+
+        // 到期的空闲定时器：期间有过收发就按最后活跃时间顺延，否则关闭
+        wheel.advance(now_ms, [this, now_ms](TimerNode *node) {
+            Connection *conn = static_cast<Connection*>(node->data);
+            if (now_ms - conn->last_active_ms < idle_timeout_ms) {
+                wheel.arm(node, conn->last_active_ms + idle_timeout_ms);
+                return;
+            }
+            std::cout << "[Loop " << id << "] Client " << conn->fd << " idle timeout" << std::endl;
+            close_connection(conn->fd);
+        });
+    }
+
+    // 排空超时还没断开的连接，以及排空开始时刚交过来、还没注册的连接
+    while (!connections.empty()) {
+        close_connection(connections.begin()->first);
+    }
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        for (int client_fd : pending_fds) {
+            close(client_fd);
+        }
+        pending_fds.clear();
+    }
+
+    close(wakeup_fd);
+    close(epfd);
+}
+
+
+void epoll_multi_reactor_server(int loop_num, const ListenOptions &opts) {
+    // 1~4. 创建 socket、地址复用、绑定、监听 (或者从旧进程接手)
+    std::vector<int> listen_fds = create_listen_sockets(PORT, 1024, opts);
+
+    std::cout << "============== Epoll TCP Server (Multi Reactor)==============" << std::endl;
+    std::cout << "listen net port: " << PORT << std::endl;
+    std::cout << "sub reactor num: " << loop_num << std::endl;
+
+    // 5. 启动子 Reactor
+    std::vector<SubReactor*> loops;
+    for (int i = 0; i < loop_num; i++) {
+        loops.push_back(new SubReactor(i, opts.idle_timeout_ms));
+    }
+
+    // 6. 主 Reactor：等监听 socket (可能不止一个) 可读或者开始排空，accept 后轮询 (round-robin) 分发
+    int epfd = epoll_create(1);
+    if (epfd == -1) {
+        perror("epoll create error");
+        exit(1);
+    }
+    epoll_event event;
+    event.events = EPOLLIN;
+    for (int sockfd : listen_fds) {
+        event.data.fd = sockfd;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &event) == -1) {
+            perror("epoll_ctl error");
+            exit(1);
+        }
+    }
+    int drain_fd = drain_state().event_fd;
+    if (drain_fd != -1) {
+        event.data.fd = drain_fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, drain_fd, &event);
+    }
+
+    size_t next = 0;
+    bool is_draining = false;
+    epoll_event events[MAX_EVENTS];
+    while (!is_draining) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait error");
+            break;
+        }
+
+        for (int i = 0; i < n && !is_draining; i++) {
+            int sockfd = events[i].data.fd;
+            if (sockfd == drain_fd) {
+                is_draining = true;
+                break;
+            }
+
+            while (true) {
+                struct sockaddr_in client_addr;
+                socklen_t sock_len = sizeof(client_addr);
+                // accept4 直接返回非阻塞 fd，省掉一次 fcntl
+                int client_fd = accept4(sockfd, (struct sockaddr*)&client_addr, &sock_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+                if (client_fd == -1) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) break; // 没有更多连接了 (或者被交接后的新进程抢走)
+                    if (errno == EINTR || errno == ECONNABORTED) continue;
+
+                    // fd 用尽等错误：稍后重试，不让整个服务器退出
+                    perror("accept error");
+                    usleep(1000);
+                    break;
+                }
+
+                SubReactor *loop = loops[next];
+                next = (next + 1) % loops.size();
+                loop->add_connection(client_fd);
+            }
+        }
+    }
+
+    // 7. 排空：关闭监听 socket (交接后新进程仍持有它)，等子 Reactor 服务完已有连接
+    for (int sockfd : listen_fds) {
+        close(sockfd);
+    }
+    close(epfd);
+    for (SubReactor *loop : loops) {
+        delete loop;
+    }
+}
@@ -0,0 +1,484 @@
+/**
+ * Epoll TCP 服务器 (ET 模式)
+ * 在 LT 版本的基础上改为边缘触发，并为每个连接维护一个输出缓冲区：
+ *  - send() 写不完（短写 / EAGAIN）的数据先存进缓冲区，不会丢字节
+ *  - 只有缓冲区里还有数据时才关注 EPOLLOUT，写完立即取消，避免空转唤醒
+ *
+ * 用法: ./epoll_tcp_et [-z] [-I 空闲秒数] [-s N] [-u PATH] [-d 秒]
+ *   -z  零拷贝回显：socket -> 管道 -> socket 全程 splice，数据只在内核里搬页，不经过用户态缓冲区
+ *       发送缓冲区满时管道里剩下的数据才读进输出缓冲区 (慢路径拷贝)，之后照常走 send 直到积压清空
+ *   -I  连接空闲 (没有收发，包括对端不读导致发不出去) 超过这么多秒就关闭，默认 60，0 表示不限
+ *       空闲超时挂在时间轮上 (common/timing_wheel.h)，下一次到期就是 epoll_wait 的超时
+ *   -s / -u / -d 见 common/listen_socket.h：单线程，分片时所有监听 socket 都注册在同一个 epoll 上；
+ *       SIGTERM / SIGINT 后停止 accept，已有连接断开或排空超时后退出
+ */
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <cstdlib>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <sys/epoll.h>
+#include <ctime>
+
+#include "../common/listen_socket.h"
+#include "../common/timing_wheel.h"
+
+// build bash: g++ -std=c++11 epoll_tcp_et.cc -o epoll_tcp_et
+
+const int PORT = 8080;
+const int BUFFER_SIZE = 1024;
+const int MAX_EVENTS = 1024; // 一次最大处理的事件数量
+const size_t HIGH_WATER_MARK = 4 * 1024 * 1024; // 输出缓冲区上限，超过则认为对端读得太慢，断开连接
+const int SPLICE_PIPE_SIZE = 256 * 1024;        // -z 模式下中转管道的容量，一次 splice 最多搬这么多
+const int TIMER_TICK_MS = 10;                   // 空闲超时的精度
+
+
+// 设置非阻塞IO （ET 模式必须非阻塞）
+void set_nonblocking(int fd);
+void epoll_tcp_server(const ListenOptions &opts);
+
+int64_t monotonic_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// 每个连接的状态：尚未发送出去的数据 + 空闲定时器
+struct Client
+{
+    int fd = -1;
+    std::string out;
+    bool read_closed = false;       // 对端已经关闭写端：不再读，积压数据发完再关闭
+    int64_t last_active_ms = 0;     // 最后一次有读写事件的时间，定时器到期时再决定顺延还是关闭
+    TimerNode idle_timer;           // data 指向所属的 Client
+};
+
+// fd -> 连接状态 (unordered_map 的元素地址不会因为扩容改变，定时器节点可以直接嵌在里面)
+std::unordered_map<int, Client> g_clients;
+int g_idle_timeout_ms = DEFAULT_IDLE_TIMEOUT_MS;
+TimingWheel g_wheel(monotonic_ms(), TIMER_TICK_MS);
+
+// 修改 fd 关注的事件（ET 模式下需要带上 EPOLLET）
+void update_events(int epfd, int fd, bool want_write);
+// 关闭连接并清理状态
+void close_connection(int epfd, int fd);
+// 尽可能多地发送输出缓冲区中的数据，返回 false 表示连接出错需要关闭
+bool flush_output(int fd, std::string &out);
+// 处理可读事件：读到 EAGAIN 为止，回显数据，返回 false 表示连接已关闭
+// 读到 EOF 时还有积压数据就只设置 read_closed，等发完再关闭
+bool handle_read(int epfd, Client &client);
+// 同 handle_read，数据经管道 splice 回去，不拷贝到用户态 (-z)
+bool handle_read_splice(int epfd, Client &client);
+// 读到 EOF：没有积压数据直接关闭 (返回 false)，否则停止读取，等 EPOLLOUT 把数据发完
+bool handle_eof(int epfd, Client &client);
+
+// -z 模式下所有连接共用的中转管道；单线程，每次 splice 之后管道都会清空
+int g_splice_pipe[2] = {-1, -1};
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-z") == 0) {
+            if (pipe2(g_splice_pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+                perror("pipe error");
+                exit(1);
+            }
+            // 管道默认 64KB，调大减少大消息的 splice 次数；失败就用默认大小
+            fcntl(g_splice_pipe[1], F_SETPIPE_SZ, SPLICE_PIPE_SIZE);
+        }
+    }
+
+    ListenOptions opts = parse_listen_options(argc, argv);
+    graceful_init(opts.drain_timeout_ms);
+    g_idle_timeout_ms = opts.idle_timeout_ms;
+
+    epoll_tcp_server(opts);
+
+    return 0;
+}
+
+void set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1) {
+        perror("fcntl get error");
+        return;
+    }
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+void update_events(int epfd, int fd, bool want_write) {
+    epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    if (want_write) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.fd = fd;
+
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &event) == -1) {
+        perror("epoll_ctl mod error");
+    }
+}
+
+void close_connection(int epfd, int fd) {
+    // 先从 epoll 中移除，再关闭 fd
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    auto it = g_clients.find(fd);
+    if (it != g_clients.end()) {
+        g_wheel.cancel(&it->second.idle_timer);
+        g_clients.erase(it);
+    }
+}
+
+bool flush_output(int fd, std::string &out) {
+    size_t sent = 0;
+    while (sent < out.size()) {
+        ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+            continue;
+        }
+
+        if (n == -1 && errno == EINTR) continue;
+        // 内核发送缓冲区满了，剩下的等 EPOLLOUT 再发
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+
+        perror("send error");
+        return false;
+    }
+
+    // 只保留未发送的部分
+    out.erase(0, sent);
+    return true;
+}
+
+bool handle_eof(int epfd, Client &client) {
+    std::cout << "Client " << client.fd << " disconneted" << std::endl;
+    if (client.out.empty()) {
+        close_connection(epfd, client.fd);
+        return false;
+    }
+    client.read_closed = true;
+    return true;
+}
+
+bool handle_read(int epfd, Client &client) {
+    int fd = client.fd;
+    std::string &out = client.out;
+    char buffer[BUFFER_SIZE];
+
+    while (true) { // ET 模式：必须读到 EAGAIN 为止
+        ssize_t bytes_read = recv(fd, buffer, BUFFER_SIZE, 0);
+
+        if (bytes_read > 0) {
+            if (out.empty()) {
+                // 缓冲区为空时先尝试直接发送，只把没发完的部分存起来
+                ssize_t n = send(fd, buffer, bytes_read, MSG_NOSIGNAL);
+                if (n == -1) {
+                    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                        perror("send error");
+                        close_connection(epfd, fd);
+                        return false;
+                    }
+                    n = 0;
+                }
+                out.append(buffer + n, bytes_read - n);
+            }
+            else {
+                // 已经有积压数据，必须追加到末尾以保证顺序
+                out.append(buffer, bytes_read);
+            }
+
+            if (out.size() > HIGH_WATER_MARK) {
+                std::cout << "Client " << fd << " output buffer overflow, close" << std::endl;
+                close_connection(epfd, fd);
+                return false;
+            }
+        }
+        else if (bytes_read == 0) { // 对端关闭写端
+            return handle_eof(epfd, client);
+        }
+        else {
+            if (errno == EINTR) continue;
+            // 在非阻塞状态下 EAGAIN 和 EWOULDBLOCK 表示本次读完
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+
+            perror("recv error");
+            close_connection(epfd, fd);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// 从管道读出 len 字节追加到 out (out 为空指针时丢弃)，让共用的管道恢复为空
+void drain_pipe(std::string *out, size_t len) {
+    char buffer[BUFFER_SIZE];
+    while (len > 0) {
+        ssize_t n = read(g_splice_pipe[0], buffer, len < sizeof(buffer) ? len : sizeof(buffer));
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) {
+            perror("pipe read error");
+            exit(1); // 管道里的数据对不上，无法继续共用
+        }
+        if (out != nullptr) {
+            out->append(buffer, n);
+        }
+        len -= n;
+    }
+}
+
+bool handle_read_splice(int epfd, Client &client) {
+    int fd = client.fd;
+    std::string &out = client.out;
+    while (true) {
+        // 有积压数据时 splice 出去会乱序，回到拷贝路径
+        if (!out.empty()) {
+            return handle_read(epfd, client);
+        }
+
+        ssize_t in = splice(fd, NULL, g_splice_pipe[1], NULL, SPLICE_PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (in == 0) { // 对端关闭写端
+            return handle_eof(epfd, client);
+        }
+        if (in == -1) {
+            if (errno == EINTR) continue;
+            // 管道每次都是空的，EAGAIN 只可能是 socket 读完了
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            perror("splice in error");
+            close_connection(epfd, fd);
+            return false;
+        }
+
+        size_t left = in;
+        while (left > 0) {
+            ssize_t n = splice(g_splice_pipe[0], NULL, fd, NULL, left, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                left -= n;
+                continue;
+            }
+            if (n == -1 && errno == EINTR) continue;
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+
+            perror("splice out error");
+            drain_pipe(nullptr, left);
+            close_connection(epfd, fd);
+            return false;
+        }
+
+        // 发送缓冲区满了：剩下的读进输出缓冲区，等 EPOLLOUT
+        if (left > 0) {
+            drain_pipe(&out, left);
+        }
+    }
+}
+
+void epoll_tcp_server(const ListenOptions &opts) {
+    // 1~4. 创建 socket、地址复用、绑定、监听 (或者从旧进程接手)
+    std::vector<int> listen_fds = create_listen_sockets(PORT, 1024, opts);
+
+    if (g_splice_pipe[0] != -1) {
+        std::cout << "============== Epoll TCP Server (ET MODE, splice)==============" << std::endl;
+    }
+    else {
+        std::cout << "============== Epoll TCP Server (ET MODE)==============" << std::endl;
+    }
+    std::cout << "listen net port: " << PORT << std::endl;
+
+
+    // 5. 创建epoll实例
+    int epfd = epoll_create(1);
+
+    if (epfd == -1) {
+        perror("epoll create error");
+        exit(1);
+    }
+
+    // 6. 注册监听Socket到epoll (ET 模式，accept 也要循环到 EAGAIN)，排空通知也注册进来
+    epoll_event event;
+    for (int sockfd : listen_fds) {
+        set_nonblocking(sockfd);
+        event.events = EPOLLIN | EPOLLET;
+        event.data.fd = sockfd;
+
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &event) == -1) {
+            perror("epoll_ctl error");
+            exit(1);
+        }
+    }
+    int drain_fd = drain_state().event_fd;
+    if (drain_fd != -1) {
+        event.events = EPOLLIN;
+        event.data.fd = drain_fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, drain_fd, &event);
+    }
+
+    // 7. 事件循环
+    epoll_event events[MAX_EVENTS];
+    bool is_draining = false;
+
+    while (true) {
+        // 睡到最近的空闲超时，没有定时器时 -1 表示无限阻塞等待；排空中连接都关闭了或者到了截止时间就退出
+        int timeout = g_wheel.next_timeout_ms(monotonic_ms());
+        if (is_draining) {
+            int drain_timeout = drain_remaining_ms();
+            if (g_clients.empty() || drain_timeout == 0) {
+                break;
+            }
+            if (timeout == -1 || drain_timeout < timeout) {
+                timeout = drain_timeout;
+            }
+        }
+
+        int n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+
+        if (n == -1) {
+            if (errno == EINTR) continue; // 被信号中断继续
+            perror("epoll_wait error");
+            break;
+        }
+        int64_t now_ms = monotonic_ms();
+
+        for (int i = 0; i < n; i++)
+        {
+            int c_fd = events[i].data.fd;
+            uint32_t revents = events[i].events;
+
+            // 开始排空：摘掉并关闭监听 socket (交接后新进程仍持有它)，eventfd 一直可读，也要摘掉
+            if (c_fd == drain_fd) {
+                epoll_ctl(epfd, EPOLL_CTL_DEL, drain_fd, NULL);
+                for (int sockfd : listen_fds) {
+                    epoll_ctl(epfd, EPOLL_CTL_DEL, sockfd, NULL);
+                    close(sockfd);
+                }
+                listen_fds.clear();
+                is_draining = true;
+                continue;
+            }
+
+            // 情况A: 监听socket事件（有新连接）
+            if (std::find(listen_fds.begin(), listen_fds.end(), c_fd) != listen_fds.end()) {
+                int sockfd = c_fd;
+                while (true) {
+                    struct sockaddr_in client_addr;
+                    socklen_t sock_len = sizeof(client_addr);
+                    int client_fd = accept(sockfd, (struct sockaddr*)&client_addr, &sock_len);
+
+                    if (client_fd == -1) {
+                        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                            break; // 没有更多连接了
+                        }
+                        if (errno == EINTR || errno == ECONNABORTED) continue;
+
+                        // fd 用尽等错误不应让整个服务器退出
+                        perror("accept error");
+                        break;
+                    }
+
+                    std::cout << "[Epoll ET] New client connected " <<
+                    inet_ntoa(client_addr.sin_addr) << ":" << ntohs(client_addr.sin_port) << " (fd = " << client_fd << ")" << std::endl;
+
+                    set_nonblocking(client_fd);
+
+                    // 新连接只关注可读，EPOLLOUT 等到有积压数据时再打开
+                    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+                    event.data.fd = client_fd;
+
+                    if (epoll_ctl(epfd, EPOLL_CTL_ADD, client_fd, &event) == -1) {
+                        perror("epoll_ctl error");
+                        close(client_fd);
+                        continue;
+                    }
+                    Client &client = g_clients[client_fd];
+                    client.fd = client_fd;
+                    client.out.clear();
+                    client.read_closed = false;
+                    client.last_active_ms = now_ms;
+                    if (g_idle_timeout_ms > 0) {
+                        client.idle_timer.data = &client;
+                        g_wheel.arm(&client.idle_timer, now_ms + g_idle_timeout_ms);
+                    }
+                }
+                continue;
+            }
+
+            // 情况B: 客户端Socket fd 就绪 (同一批事件里已经关闭的连接、刚摘掉的监听 socket 不在表里)
+            auto it = g_clients.find(c_fd);
+            if (it == g_clients.end()) {
+                continue;
+            }
+            if (revents & (EPOLLERR | EPOLLHUP)) {
+                close_connection(epfd, c_fd);
+                continue;
+            }
+
+            // 有积压数据 <=> 当前关注了 EPOLLOUT
+            // ET 模式下可读 / 可写事件只在有新数据或者对端读走数据时触发，都算一次收发
+            Client &client = it->second;
+            client.last_active_ms = now_ms;
+            std::string &out = client.out;
+            bool was_pending = !out.empty();
+
+            // 可写：继续发送积压数据
+            if (revents & EPOLLOUT) {
+                if (!flush_output(c_fd, out)) {
+                    close_connection(epfd, c_fd);
+                    continue;
+                }
+            }
+
+            // 可读或对端关闭写端（EPOLLRDHUP 时 recv 会先读完剩余数据再返回 0）
+            if (!client.read_closed && (revents & (EPOLLIN | EPOLLRDHUP))) {
+                bool alive = g_splice_pipe[0] != -1 ? handle_read_splice(epfd, client) : handle_read(epfd, client);
+                if (!alive) {
+                    continue; // 连接已关闭
+                }
+            }
+
+            // 对端已经关闭写端，积压的回显数据也发完了
+            if (client.read_closed && out.empty()) {
+                close_connection(epfd, c_fd);
+                continue;
+            }
+
+            // 只在 "有无积压数据" 状态变化时才修改事件，减少 epoll_ctl 调用
+            bool is_pending = !out.empty();
+            if (is_pending != was_pending) {
+                update_events(epfd, c_fd, is_pending);
+            }
+        }
+
+        // 到期的空闲定时器：期间有过收发就按最后活跃时间顺延，否则关闭
+        g_wheel.advance(now_ms, [epfd, now_ms](TimerNode *node) {
+            Client *client = static_cast<Client*>(node->data);
+            if (now_ms - client->last_active_ms < g_idle_timeout_ms) {
+                g_wheel.arm(node, client->last_active_ms + g_idle_timeout_ms);
+                return;
+            }
+            std::cout << "Client " << client->fd << " idle timeout" << std::endl;
+            close_connection(epfd, client->fd);
+        });
+    }
+
+    // 排空超时还没断开的连接
+    while (!g_clients.empty()) {
+        close_connection(epfd, g_clients.begin()->first);
+    }
+
+    // 关闭socket
+    for (int sockfd : listen_fds) {
+        close(sockfd);
+    }
+    close(epfd);
+}
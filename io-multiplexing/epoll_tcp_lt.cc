@@ -1,9 +1,12 @@
 /**
  * Epoll TCP 服务器 (LT 模式)
  * 这是一个单线程服务器，但能同时处理无数连接。
+ * 每个连接的状态 (缓冲区、最后活跃时间) 放在按 fd 下标的连接表里，epoll_data.ptr 直接指向表项。
+ * 空闲超时由时间轮管理，下一次到期的时间就是 epoll_wait 的超时，不扫描连接表。
  */
 #include <fcntl.h>
 #include <sys/socket.h>
+#include <cstddef>
 #include <cstdlib>
 #include <unistd.h>
 #include <stdio.h>
@@ -12,18 +15,51 @@
 #include <iostream>
 #include <cstring>
 #include <sys/epoll.h>
+#include <sys/uio.h>
+#include <ctime>
+#include <vector>
+#include <deque>
+#include <unordered_set>
+#include <thread>
+
+#include "../common/listen_socket.h"
+#include "../common/io_uring.h"
+#include "../common/buffer_pool.h"
+#include "../common/timing_wheel.h"
+
+// 用法: ./epoll_tcp_lt [-s 分片数] [-c] [-U] [-u 交接路径] [-d 排空秒数] [-I 空闲秒数]
+// 分片模式下每个线程一个 SO_REUSEPORT 监听 socket + 一个独立的 epoll 事件循环
+// -U  用 io_uring 代替 epoll：多次 accept + 多次 recv 进缓冲区环，每轮的所有 send 一次系统调用提交
+// -I  连接空闲 (没有收发，包括对端不读导致发不出去) 超过这么多秒就关闭，0 表示不限
+// SIGTERM / SIGINT：摘掉监听 socket，已有连接全部关闭 (最多 -d 秒) 后退出
 
 const int PORT = 8080;
-const int BUFFER_SIZE = 1024;
 const int MAX_EVENTS = 1024; // 一次最大处理的事件数量
+const unsigned URING_ENTRIES = 1024;        // io_uring 提交队列大小
+const unsigned URING_BUFFER_COUNT = 1024;   // 缓冲区环的块数 (2 的幂)，所有连接共享
+const size_t URING_BUFFER_SIZE = 4096;
+const size_t URING_CONN_MAX_BUFFERS = 16;   // 一个连接最多占着的缓冲区数 (收到还没发完的)，降到一半再继续收
+const int TIMER_TICK_MS = 10;               // 空闲超时的精度
 
 
 // 设置非阻塞IO （epoll最佳搭档）
 void set_nonblocking(int fd);
-void epoll_tcp_server();
+void epoll_tcp_server(const ListenOptions &opts, bool use_uring);
+void epoll_loop(int sockfd, int idle_timeout_ms);
+void uring_loop(int sockfd, int idle_timeout_ms);
+
+int main(int argc, char *argv[]) {
+    bool use_uring = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-U") == 0) {
+            use_uring = true;
+        }
+    }
+
+    ListenOptions opts = parse_listen_options(argc, argv);
+    graceful_init(opts.drain_timeout_ms);
 
-int main() {
-    epoll_tcp_server();
+    epoll_tcp_server(opts, use_uring);
 
     return 0;
 }
@@ -38,44 +74,328 @@ void set_nonblocking(int fd) {
     fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 }
 
-void epoll_tcp_server() {
-    // 1. 创建socket
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd == -1) {
-        perror("failed create socket.");
-        exit(1);
+void epoll_tcp_server(const ListenOptions &opts, bool use_uring) {
+    // 1~4. 创建 socket、地址复用、绑定、监听
+    std::vector<int> listen_fds = create_listen_sockets(PORT, 1024, opts);
+
+    if (use_uring) {
+        std::cout << "============== TCP Server (io_uring)==============" << std::endl;
+    }
+    else {
+        std::cout << "============== Epoll TCP Server (LT MODE)==============" << std::endl;
     }
+    std::cout << "listen net port: " << PORT << std::endl;
 
-    // 2. 设置地址复用，避免端口占用
-    int opt = 1;
-    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (listen_fds.size() == 1) {
+        use_uring ? uring_loop(listen_fds[0], opts.idle_timeout_ms) : epoll_loop(listen_fds[0], opts.idle_timeout_ms);
+        return;
+    }
 
-    // 3. 绑定
-    struct sockaddr_in address;
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY; // 监听所有网卡请求
-    address.sin_port = htons(PORT); // 设置监听端口 TODO: 必须转换数据类型
+    std::cout << "listen shards: " << listen_fds.size() << std::endl;
+    std::vector<std::thread> loops;
+    for (size_t i = 0; i < listen_fds.size(); i++) {
+        int sockfd = listen_fds[i];
+        bool steering = opts.cpu_steering;
+        int idle_timeout_ms = opts.idle_timeout_ms;
+        loops.emplace_back([sockfd, steering, i, use_uring, idle_timeout_ms]() {
+            if (steering) {
+                bind_to_cpu(i);
+            }
+            use_uring ? uring_loop(sockfd, idle_timeout_ms) : epoll_loop(sockfd, idle_timeout_ms);
+        });
+    }
 
-    if (bind(sockfd, (struct sockaddr*)&address, sizeof(address)) == -1) {
-        perror("bind error");
-        close(sockfd);
-        exit(1);
+    for (auto &t : loops) {
+        t.join();
     }
+}
 
-    // 4. listen 监听
-    if (listen(sockfd, 1024) == -1) { // listen 第二个参数的含义是当连接数小于设置值时会进入等待队列，若超过该值，则直接拒绝服务请求
-        perror("listen error");
-        close(sockfd);
-        exit(1);
+/**
+ * epoll 版本的连接表
+ *
+ * 连接状态放在按 fd 下标的表里，epoll_data.ptr 直接指向表项：就绪事件解引用一次指针就拿到状态，不查哈希表。
+ *  - 表项按缓存行 (64 字节) 对齐，收发路径上的热数据正好第一条缓存行；
+ *    空闲定时器在第二条，只在到期和接入时访问 (收发只更新 last_active_ms，到期时才按它重新 arm)
+ *  - 每 CONN_TABLE_CHUNK 个表项一块，块分配后不再移动 (ptr 一直有效)；fd 关闭后表项留给复用这个 fd 的新连接
+ *  - 输入 / 输出缓冲区是从 BufferPool 借的块，只在数据在途时持有，空闲连接不占缓冲区
+ * 监听 socket 和排空通知的 eventfd 也占一个表项，靠 state 区分。
+ */
+const size_t CONN_BLOCK_SIZE = 16 * 1024;   // 连接缓冲区块，BufferPool 的一级
+const int CONN_TABLE_CHUNK = 256;           // 连接表每次分配的表项数
+const int CONN_MAX_IOV = 16;                // 一次 sendmsg 最多合并的块数
+
+// 缓冲区块：头部之后就是数据
+struct ConnBlock
+{
+    ConnBlock *next;
+    uint32_t begin;     // 已发送到的位置
+    uint32_t end;       // 已写入到的位置
+
+    char *data() { return reinterpret_cast<char*>(this + 1); }
+};
+const uint32_t CONN_BLOCK_DATA = CONN_BLOCK_SIZE - sizeof(ConnBlock);
+
+ConnBlock *conn_block_alloc() {
+    ConnBlock *b = static_cast<ConnBlock*>(BufferPool::Allocate(BufferPool::ClassOf(CONN_BLOCK_SIZE)));
+    b->next = nullptr;
+    b->begin = 0;
+    b->end = 0;
+    return b;
+}
+
+void conn_block_free(ConnBlock *b) {
+    BufferPool::Deallocate(BufferPool::ClassOf(CONN_BLOCK_SIZE), b);
+}
+
+enum ConnState : uint8_t
+{
+    CONN_FREE = 0,      // 表项空闲
+    CONN_LISTEN,        // 监听 socket
+    CONN_DRAIN,         // 排空通知
+    CONN_OPEN,          // 客户端连接 (回显协议只有这一个状态)
+};
+
+struct alignas(64) Connection
+{
+    int fd;
+    uint32_t events;            // 当前注册的 epoll 事件
+    int64_t last_active_ms;     // 最后一次收发的时间 (单调时钟)
+    ConnBlock *in;              // 正在接收的块
+    ConnBlock *out_head;        // 待发送的块链
+    ConnBlock *out_tail;
+    size_t out_bytes;
+    ConnState state;
+
+    alignas(64) TimerNode idle_timer;   // 空闲超时，data 指回本表项
+};
+static_assert(offsetof(Connection, idle_timer) == 64, "Connection hot fields should fit in the first cache line");
+static_assert(sizeof(Connection) == 128, "Connection should take exactly two cache lines");
+
+class ConnectionTable
+{
+public:
+    ConnectionTable() = default;
+    ConnectionTable(const ConnectionTable &) = delete;
+    ConnectionTable &operator=(const ConnectionTable &) = delete;
+
+    ~ConnectionTable() {
+        for (Connection *chunk : chunks_) {
+            free(chunk);
+        }
+    }
+
+    // fd 对应的表项，所在的块还没有就分配
+    Connection *get(int fd) {
+        size_t c = fd / CONN_TABLE_CHUNK;
+        if (c >= chunks_.size()) {
+            chunks_.resize(c + 1, nullptr);
+        }
+        if (chunks_[c] == nullptr) {
+            void *mem = nullptr;
+            if (posix_memalign(&mem, alignof(Connection), sizeof(Connection) * CONN_TABLE_CHUNK) != 0) {
+                perror("connection table alloc error");
+                exit(1);
+            }
+            memset(mem, 0, sizeof(Connection) * CONN_TABLE_CHUNK);  // 全部 CONN_FREE
+            chunks_[c] = static_cast<Connection*>(mem);
+        }
+        return &chunks_[c][fd % CONN_TABLE_CHUNK];
     }
 
+    // 对所有处于 state 的表项调用 f
+    template <typename F>
+    void for_each(ConnState state, F f) {
+        for (Connection *chunk : chunks_) {
+            if (chunk == nullptr) continue;
+            for (int i = 0; i < CONN_TABLE_CHUNK; i++) {
+                if (chunk[i].state == state) f(&chunk[i]);
+            }
+        }
+    }
+
+private:
+    std::vector<Connection*> chunks_;
+};
+
+int64_t monotonic_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+Connection *conn_register(int epfd, ConnectionTable &table, int fd, ConnState state, uint32_t events) {
+    Connection *conn = table.get(fd);
+    conn->fd = fd;
+    conn->state = state;
+    conn->events = events;
+    conn->in = nullptr;
+    conn->out_head = nullptr;
+    conn->out_tail = nullptr;
+    conn->out_bytes = 0;
+
+    epoll_event event;
+    event.events = events;
+    event.data.ptr = conn;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        perror("epoll_ctl error");
+        conn->state = CONN_FREE;
+        return nullptr;
+    }
+    return conn;
+}
+
+void conn_close(int epfd, Connection *conn) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+
+    if (conn->in != nullptr) {
+        conn_block_free(conn->in);
+    }
+    while (conn->out_head != nullptr) {
+        ConnBlock *next = conn->out_head->next;
+        conn_block_free(conn->out_head);
+        conn->out_head = next;
+    }
+    conn->state = CONN_FREE;
+}
+
+// 积压时只关注可写、不再读：对端发得比读得快时靠 TCP 流控顶回去，积压最多一个块
+void conn_update_events(int epfd, Connection *conn) {
+    uint32_t events = conn->out_bytes > 0 ? EPOLLOUT : EPOLLIN;
+    if (events == conn->events) return;
+
+    epoll_event event;
+    event.events = events;
+    event.data.ptr = conn;
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &event) == -1) {
+        perror("epoll_ctl mod error");
+    }
+    conn->events = events;
+}
+
+// 尽可能多地发出积压数据 (多个块一次 sendmsg)，返回 false 表示连接出错
+bool conn_flush(Connection *conn) {
+    while (conn->out_bytes > 0) {
+        struct iovec iov[CONN_MAX_IOV];
+        int iovcnt = 0;
+        for (ConnBlock *b = conn->out_head; b != nullptr && iovcnt < CONN_MAX_IOV; b = b->next) {
+            iov[iovcnt].iov_base = b->data() + b->begin;
+            iov[iovcnt].iov_len = b->end - b->begin;
+            iovcnt++;
+        }
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            // 内核发送缓冲区满了，剩下的等 EPOLLOUT
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            perror("sendmsg error");
+            return false;
+        }
+
+        // 发完的块还给池子
+        conn->out_bytes -= n;
+        size_t sent = n;
+        while (sent > 0) {
+            ConnBlock *b = conn->out_head;
+            size_t left = b->end - b->begin;
+            if (sent < left) {
+                b->begin += sent;
+                break;
+            }
+            sent -= left;
+            conn->out_head = b->next;
+            conn_block_free(b);
+        }
+        if (conn->out_head == nullptr) {
+            conn->out_tail = nullptr;
+        }
+    }
+    return true;
+}
+
+// 处理客户端连接的就绪事件，返回 false 表示连接已关闭
+bool conn_handle(int epfd, Connection *conn, uint32_t revents, int64_t now_ms) {
+    if (revents & EPOLLERR) {
+        conn_close(epfd, conn);
+        return false;
+    }
+    conn->last_active_ms = now_ms;
+
+    if ((revents & EPOLLOUT) && !conn_flush(conn)) {
+        conn_close(epfd, conn);
+        return false;
+    }
+
+    // 没有积压时才读：每读到一块就整块挂到输出链上 (回显协议：收到的就是要发的，不拷贝) 并立即发送
+    while (conn->out_bytes == 0 && (revents & (EPOLLIN | EPOLLHUP))) {
+        if (conn->in == nullptr) {
+            conn->in = conn_block_alloc();
+        }
+        ConnBlock *b = conn->in;
+        ssize_t bytes_read = recv(conn->fd, b->data() + b->end, CONN_BLOCK_DATA - b->end, 0);
+
+        if (bytes_read > 0) {
+            b->end += bytes_read;
+            conn->in = nullptr;
+            conn->out_head = conn->out_tail = b;
+            conn->out_bytes = bytes_read;
+            if (!conn_flush(conn)) {
+                conn_close(epfd, conn);
+                return false;
+            }
+            continue;
+        }
+
+        if (bytes_read == 0) { // 断开连接
+            std::cout << "Client " << conn->fd << " disconneted" << std::endl;
+            conn_close(epfd, conn);
+            return false;
+        }
+
+        if (errno == EINTR) continue;
+        // 在非阻塞状态下 EAGAIN 和 EWOULDBLOCK 表示本次读完
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+
+        perror("recv error");
+        conn_close(epfd, conn);
+        return false;
+    }
+
+    // 读完了还没用上的接收块也还回去，空闲连接不持有缓冲区
+    if (conn->in != nullptr) {
+        conn_block_free(conn->in);
+        conn->in = nullptr;
+    }
+    conn_update_events(epfd, conn);
+    return true;
+}
+
+/**
+ * 空闲定时器到期：期间有过收发就按最后活跃时间重新 arm，否则关闭连接
+ * 收发路径上不碰时间轮，每个连接每个空闲周期最多到期一次，arm / cancel 都是 O(1)
+ * 返回 false 表示连接已关闭
+ */
+bool conn_expire(int epfd, TimingWheel &wheel, Connection *conn, int idle_timeout_ms, int64_t now_ms) {
+    if (now_ms - conn->last_active_ms < idle_timeout_ms) {
+        wheel.arm(&conn->idle_timer, conn->last_active_ms + idle_timeout_ms);
+        return true;
+    }
+    std::cout << "Client " << conn->fd << " idle timeout" << std::endl;
+    conn_close(epfd, conn);
+    return false;
+}
+
+// 单个监听 socket 的 epoll 事件循环
+void epoll_loop(int sockfd, int idle_timeout_ms) {
     // 设置为非阻塞
     set_nonblocking(sockfd);
 
-    std::cout << "============== Epoll TCP Server (LT MODE)==============" << std::endl;
-    std::cout << "listen net port: " << PORT << std::endl;
-
-    
     // 5. 创建epoll实例
     int epfd = epoll_create(1);
 
@@ -85,26 +405,40 @@ void epoll_tcp_server() {
         exit(1);
     }
 
-    // 6. 注册监听Socket到epoll
-    epoll_event event;
-    event.events = EPOLLIN; // 关注可读事件
-    event.data.fd = sockfd; // 保存fd, 方便后续取出
-
-    // 注册
-    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &event) == -1) {
-        perror("epoll_ctl error");
+    // 6. 注册监听Socket到epoll，排空通知也注册进来
+    ConnectionTable table;
+    if (conn_register(epfd, table, sockfd, CONN_LISTEN, EPOLLIN) == nullptr) {
         close(sockfd);
         close(epfd);
         exit(1);
     }
+    int drain_fd = drain_state().event_fd;
+    if (drain_fd != -1) {
+        conn_register(epfd, table, drain_fd, CONN_DRAIN, EPOLLIN);
+    }
 
     // 7. 事件循环
     epoll_event events[MAX_EVENTS];
+    int client_count = 0;     // 本循环上的连接数
+    bool is_draining = false;
+    TimingWheel wheel(monotonic_ms(), TIMER_TICK_MS);
 
     while (true) {
+        // 没有定时器也不在排空时无限阻塞等待；否则等到下一个定时器 (或排空截止)
+        int timeout = wheel.next_timeout_ms(monotonic_ms());
+        if (is_draining) {
+            int drain_timeout = drain_remaining_ms();
+            if (client_count == 0 || drain_timeout == 0) {
+                break;
+            }
+            if (timeout == -1 || drain_timeout < timeout) {
+                timeout = drain_timeout;
+            }
+        }
+
         // 阻塞等待
         // 返回待处理的事件数量
-        int n = epoll_wait(epfd, events, MAX_EVENTS, -1); // -1 表示无限阻塞等待
+        int n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
 
         if (n == -1) {
             if (errno == EINTR) continue; // 被信号中断继续
@@ -112,87 +446,375 @@ void epoll_tcp_server() {
             break;
         }
 
+        int64_t now_ms = monotonic_ms();
+        bool accept_ready = false;
+
         // 遍历所有的就绪事件
-        for (size_t i = 0; i < n; i++)
+        for (int i = 0; i < n; i++)
         {
-            int c_fd = events[i].data.fd;
-
-            // 情况A: 监听socket事件（有新连接）
-            if (c_fd == sockfd) {
-                struct sockaddr_in client_addr;
-                socklen_t sock_len = sizeof(client_addr);
+            Connection *conn = static_cast<Connection*>(events[i].data.ptr);
+
+            switch (conn->state) {
+            case CONN_DRAIN:
+                // 开始排空：摘掉监听 socket (交接后新进程仍持有它)，eventfd 一直可读，也要摘掉
+                epoll_ctl(epfd, EPOLL_CTL_DEL, drain_fd, NULL);
+                epoll_ctl(epfd, EPOLL_CTL_DEL, sockfd, NULL);
+                conn->state = CONN_FREE;
+                table.get(sockfd)->state = CONN_FREE;
+                is_draining = true;
+                break;
+
+            case CONN_LISTEN:
+                // 本批事件处理完再 accept：新连接可能复用本批里刚关闭的 fd，迟到的旧事件会落到新连接的表项上
+                accept_ready = true;
+                break;
+
+            case CONN_OPEN:
+                if (!conn_handle(epfd, conn, events[i].events, now_ms)) {
+                    wheel.cancel(&conn->idle_timer);
+                    client_count--;
+                }
+                break;
 
-                // 循环遍历accept
-                while (true) {
-                    int client_fd = accept(sockfd, (struct sockaddr*)&client_addr, &sock_len);
+            case CONN_FREE:
+                break; // 同一批事件里已经关闭
+            }
+        }
 
-                    if (client_fd == -1) {
-                        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                            break; // 没有更多连接了
-                        }
+        // 情况A: 监听socket事件（有新连接）
+        while (accept_ready && !is_draining) {
+            struct sockaddr_in client_addr;
+            socklen_t sock_len = sizeof(client_addr);
+            int client_fd = accept4(sockfd, (struct sockaddr*)&client_addr, &sock_len, SOCK_NONBLOCK);
 
-                        perror("accept error");
-                        exit(1);
-                    }
+            if (client_fd == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break; // 没有更多连接了
+                }
+                if (errno == EINTR || errno == ECONNABORTED) continue;
 
-                    // 打印当前连接信息
-                    std::cout << "[Epoll] New client connected " <<
-                    inet_ntoa(client_addr.sin_addr) << ":" << ntohs(client_addr.sin_port) << " (fd = " << client_fd << ")" << std::endl;
+                perror("accept error");
+                exit(1);
+            }
 
-                    // 关键：TODO: 将新连接设置为非阻塞
-                    set_nonblocking(client_fd);
-                    
-                    // 注册新连接到epoll
-                    event.events = EPOLLIN;
-                    event.data.fd = client_fd;
+            // 打印当前连接信息
+            std::cout << "[Epoll] New client connected " <<
+            inet_ntoa(client_addr.sin_addr) << ":" << ntohs(client_addr.sin_port) << " (fd = " << client_fd << ")" << std::endl;
 
-                    if (epoll_ctl(epfd, EPOLL_CTL_ADD, client_fd, &event) == -1) {
-                        perror("epoll_ctl error");
-                        close(client_fd);
-                    }
+            Connection *conn = conn_register(epfd, table, client_fd, CONN_OPEN, EPOLLIN);
+            if (conn == nullptr) {
+                close(client_fd);
+                continue;
+            }
+            conn->last_active_ms = now_ms;
+            if (idle_timeout_ms > 0) {
+                conn->idle_timer.data = conn;
+                wheel.arm(&conn->idle_timer, now_ms + idle_timeout_ms);
+            }
+            client_count++;
+        }
 
-                }
+        // 到期的空闲定时器；本轮有事件的连接已经更新过 last_active_ms，只会被重新 arm
+        wheel.advance(now_ms, [&](TimerNode *node) {
+            if (!conn_expire(epfd, wheel, static_cast<Connection*>(node->data), idle_timeout_ms, now_ms)) {
+                client_count--;
             }
-            else { // 情况B: 客户端Socket fd 就绪（可读或断开）
-                char buffer[BUFFER_SIZE];
+        });
+    }
 
-                while (true) { // 循环读取
-                    memset(buffer, 0, BUFFER_SIZE);
+    // 排空超时还没断开的连接
+    table.for_each(CONN_OPEN, [epfd](Connection *conn) { conn_close(epfd, conn); });
 
-                    ssize_t bytes_read = recv(c_fd, buffer, BUFFER_SIZE, 0);
+    // 关闭socket
+    close(sockfd);
+    close(epfd);
+}
 
-                    if (bytes_read > 0) { // 正常，进行数据回显
-                        send(c_fd, buffer, bytes_read, 0);
-                    }
-                    else if (bytes_read == 0) { // 断开连接
-                        // 正常断开连接
-                        std::cout << "Client " << c_fd << " disconneted" << std::endl;
-                        close(c_fd);
-                        // TODO: 重要！ 从epoll中移除close的fd（随人close的fd会自动移除，但是显示处理是好习惯）
-                        epoll_ctl(epfd, EPOLL_CTL_DEL, c_fd, NULL);
+/**
+ * io_uring 版本的事件循环 (-U)
+ *
+ * 不再 "等就绪 → 自己 recv / send"，而是把请求交给内核、收割完成事件：
+ *  - 监听 socket 上挂一个多次 accept，每来一个连接一个完成事件，拿到的就是新连接 fd
+ *  - 每个连接挂一个多次 recv，数据由内核直接写进缓冲区环里的一块缓冲区
+ *  - 回显时直接把这块缓冲区 send 出去 (不拷贝)，send 完成后才把缓冲区还给环
+ *  - 一轮完成事件处理中产生的 accept / recv / send 请求，在下一次 io_uring_enter 里和 "等待" 一起提交
+ * 同一连接上同时只有一个 send 在途，后到的数据排队，保证回显顺序。
+ * 排队的缓冲区达到 URING_CONN_MAX_BUFFERS 就取消这个连接的 recv，send 完成降到一半再重新挂：
+ * 一个只发不收的客户端不会把所有连接共享的缓冲区环占光。
+ * 空闲超时同 epoll 版本：时间轮的下一次到期作为 io_uring_enter 的等待超时。
+ */
+
+// user_data 低 3 位是请求类型，其余是连接指针 (new 出来的对象至少 8 字节对齐)
+enum UringOp : uint64_t { URING_ACCEPT = 1, URING_DRAIN = 2, URING_RECV = 3, URING_SEND = 4, URING_CANCEL = 5 };
+const uint64_t URING_OP_MASK = 7;
+
+// 等待回显的一段数据：缓冲区环中的一块
+struct UringSegment
+{
+    unsigned bid;
+    unsigned offset;
+    unsigned len;
+};
+
+struct UringConnection
+{
+    int fd;
+    bool closed = false;
+    bool recv_armed = false;            // 多次 recv 还在生效
+    bool send_inflight = false;
+    bool starved = false;               // 在 starved 列表里，等缓冲区还回来重新挂 recv
+    bool throttled = false;             // 占着的缓冲区到了上限，recv 已取消，等 send 发完一半再挂
+    std::deque<UringSegment> output;    // 第一段就是在途 send 的那段
+    int64_t last_active_ms = 0;         // 最后一次收发完成的时间
+    TimerNode idle_timer;
+};
+
+void uring_loop(int sockfd, int idle_timeout_ms) {
+    // SINGLE_ISSUER：ring 必须在使用它的线程里创建
+    IoUring ring(URING_ENTRIES);
+    IoUringBufferRing buffers(ring, 0, URING_BUFFER_COUNT, URING_BUFFER_SIZE);
+
+    std::unordered_set<UringConnection*> connections;
+    std::vector<UringConnection*> starved;  // 缓冲区用完后停掉了 recv 的连接，等缓冲区还回来再挂
+    int client_count = 0;
+    bool is_draining = false;
+    bool accept_armed = false;
+    TimingWheel wheel(monotonic_ms(), TIMER_TICK_MS);
+    int64_t now_ms = monotonic_ms();
+
+    auto get_sqe = [&ring]() {
+        struct io_uring_sqe *sqe = ring.GetSqe();
+        if (sqe == nullptr) {
+            fprintf(stderr, "io_uring submission queue full\n");
+            exit(1);
+        }
+        return sqe;
+    };
+    auto tag = [](UringConnection *conn, UringOp op) { return reinterpret_cast<uint64_t>(conn) | op; };
+
+    auto arm_accept = [&]() {
+        uring_prep_multishot_accept(get_sqe(), sockfd, URING_ACCEPT);
+        accept_armed = true;
+    };
+    auto arm_recv = [&](UringConnection *conn) {
+        uring_prep_multishot_recv(get_sqe(), conn->fd, buffers.group(), tag(conn, URING_RECV));
+        conn->recv_armed = true;
+    };
+    auto submit_send = [&](UringConnection *conn) {
+        const UringSegment &seg = conn->output.front();
+        uring_prep_send(get_sqe(), conn->fd, buffers.buffer(seg.bid) + seg.offset, seg.len - seg.offset,
+                        tag(conn, URING_SEND));
+        conn->send_inflight = true;
+    };
+    // 关闭连接；还有请求在途时等它们都完成 (shutdown 让它们尽快结束) 再释放
+    auto close_connection = [&](UringConnection *conn) {
+        if (!conn->closed) {
+            conn->closed = true;
+            wheel.cancel(&conn->idle_timer);
+            shutdown(conn->fd, SHUT_RDWR);
+            close(conn->fd);
+            client_count--;
+            std::cout << "Client " << conn->fd << " disconneted" << std::endl;
+        }
+        if (conn->recv_armed || conn->send_inflight || conn->starved) return;
+        for (const UringSegment &seg : conn->output) {
+            buffers.Recycle(seg.bid);
+        }
+        connections.erase(conn);
+        delete conn;
+    };
+
+    arm_accept();
+    int drain_fd = drain_state().event_fd;
+    if (drain_fd != -1) {
+        uring_prep_poll_add(get_sqe(), drain_fd, POLLIN, URING_DRAIN);
+    }
+
+    while (true) {
+        int timeout = wheel.next_timeout_ms(monotonic_ms());
+        if (is_draining) {
+            int drain_timeout = drain_remaining_ms();
+            if (client_count == 0 || drain_timeout == 0) {
+                break;
+            }
+            if (timeout == -1 || drain_timeout < timeout) {
+                timeout = drain_timeout;
+            }
+        }
+
+        // 提交上一轮攒下的所有请求，同时等下一批完成事件
+        if (ring.Submit(1, timeout) == -1) {
+            perror("io_uring_enter error");
+            break;
+        }
+        now_ms = monotonic_ms();
+
+        bool recycled = false;
+        ring.ForEachCqe([&](const struct io_uring_cqe &cqe) {
+            UringOp op = static_cast<UringOp>(cqe.user_data & URING_OP_MASK);
+            UringConnection *conn = reinterpret_cast<UringConnection*>(cqe.user_data & ~URING_OP_MASK);
+            bool more = cqe.flags & IORING_CQE_F_MORE;
+
+            switch (op) {
+            case URING_ACCEPT: {
+                if (!more) accept_armed = false;
+                if (cqe.res >= 0) {
+                    if (is_draining) {
+                        close(cqe.res);
                         break;
                     }
+                    UringConnection *c = new UringConnection;
+                    c->fd = cqe.res;
+                    c->last_active_ms = now_ms;
+                    if (idle_timeout_ms > 0) {
+                        c->idle_timer.data = c;
+                        wheel.arm(&c->idle_timer, now_ms + idle_timeout_ms);
+                    }
+                    connections.insert(c);
+                    client_count++;
+                    std::cout << "[io_uring] New client connected (fd = " << c->fd << ")" << std::endl;
+                    arm_recv(c);
+                }
+                else if (cqe.res != -ECANCELED && cqe.res != -EAGAIN && cqe.res != -ECONNABORTED && cqe.res != -EINTR) {
+                    fprintf(stderr, "accept error: %s\n", strerror(-cqe.res));
+                }
+                // 多次 accept 因为出错停了：重新挂上
+                if (!accept_armed && !is_draining) {
+                    arm_accept();
+                }
+                break;
+            }
+
+            case URING_DRAIN:
+                // 开始排空：取消 accept (监听 socket 交接后新进程还在用)，已有连接继续服务
+                is_draining = true;
+                if (accept_armed) {
+                    uring_prep_cancel(get_sqe(), URING_ACCEPT, URING_CANCEL);
+                }
+                break;
+
+            case URING_RECV: {
+                if (!more) conn->recv_armed = false;
+                if (cqe.res > 0) {
+                    unsigned bid = IoUringBufferRing::BufferId(cqe);
+                    if (conn->closed) {
+                        buffers.Recycle(bid);
+                        recycled = true;
+                    }
                     else {
-                        // 在非阻塞状态下 EAGAIN 和 EWOULDBLOCK 表示本次读完
-                        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                            break;
+                        // 收到的缓冲区原样排进输出队列，直接 send 它
+                        conn->last_active_ms = now_ms;
+                        conn->output.push_back(UringSegment{bid, 0, (unsigned)cqe.res});
+                        if (!conn->send_inflight) {
+                            submit_send(conn);
                         }
+                    }
+                }
 
-                        // 发生了错误
-                        perror("recv error");
-                        close(c_fd);
-                        // 移除发生错误的fd
-                        epoll_ctl(epfd, EPOLL_CTL_DEL, c_fd, NULL);
-                        break;
+                if (conn->closed) {
+                    close_connection(conn); // 已关闭：在途请求都结束了才真正释放
+                }
+                else if (cqe.res == -ENOBUFS) {
+                    // 缓冲区环空了：等 send 完成还回缓冲区后再挂 recv
+                    conn->starved = true;
+                    starved.push_back(conn);
+                }
+                else if (cqe.res == -ECANCELED) {
+                    // 达到上限时取消的 recv；取消生效之前已经降下来了就直接重新挂
+                    if (!conn->throttled && !conn->recv_armed) {
+                        arm_recv(conn);
+                    }
+                }
+                else if (cqe.res <= 0) {
+                    // 0 是对端关闭，其余是错误
+                    close_connection(conn);
+                }
+                else if (conn->output.size() >= URING_CONN_MAX_BUFFERS) {
+                    // 对端读得太慢：先不收了，取消生效前已经在路上的几块照样排队
+                    if (!conn->throttled) {
+                        conn->throttled = true;
+                        if (conn->recv_armed) {
+                            uring_prep_cancel(get_sqe(), tag(conn, URING_RECV), URING_CANCEL);
+                        }
+                    }
+                }
+                else if (!conn->recv_armed) {
+                    arm_recv(conn);
+                }
+                break;
+            }
+
+            case URING_SEND: {
+                conn->send_inflight = false;
+                if (cqe.res < 0 || conn->closed) {
+                    if (cqe.res < 0 && !conn->closed) {
+                        fprintf(stderr, "send error: %s\n", strerror(-cqe.res));
                     }
+                    close_connection(conn);
+                    recycled = true;
+                    break;
+                }
+
+                // 短写：从剩下的位置继续发；发完了把缓冲区还给环
+                conn->last_active_ms = now_ms;
+                UringSegment &seg = conn->output.front();
+                seg.offset += cqe.res;
+                if (seg.offset == seg.len) {
+                    buffers.Recycle(seg.bid);
+                    recycled = true;
+                    conn->output.pop_front();
+                }
+                if (!conn->output.empty()) {
+                    submit_send(conn);
                 }
+                if (conn->throttled && conn->output.size() <= URING_CONN_MAX_BUFFERS / 2) {
+                    conn->throttled = false;
+                    if (!conn->recv_armed && !conn->starved) {
+                        arm_recv(conn);
+                    }
+                }
+                break;
             }
+
+            default:
+                break;
+            }
+        });
+
+        if (recycled) {
+            buffers.Publish();
+            // 有缓冲区了，之前饿着的连接重新挂 recv
+            for (UringConnection *conn : starved) {
+                conn->starved = false;
+                if (conn->closed) {
+                    close_connection(conn);
+                }
+                else if (!conn->recv_armed && !conn->throttled) {
+                    arm_recv(conn);
+                }
+            }
+            starved.clear();
         }
-        
-    }
 
+        // 空闲超时：期间有过收发就按最后活跃时间重新 arm，否则关闭 (shutdown 让在途请求尽快结束)
+        wheel.advance(now_ms, [&](TimerNode *node) {
+            UringConnection *conn = static_cast<UringConnection*>(node->data);
+            if (now_ms - conn->last_active_ms < idle_timeout_ms) {
+                wheel.arm(&conn->idle_timer, conn->last_active_ms + idle_timeout_ms);
+                return;
+            }
+            std::cout << "Client " << conn->fd << " idle timeout" << std::endl;
+            close_connection(conn);
+        });
+    }
 
-    // 关闭socket
+    // 排空超时：剩下的连接直接关闭 (先 shutdown，在途 recv 不会再往缓冲区里写)，ring 销毁时内核取消在途请求
+    for (UringConnection *conn : connections) {
+        if (!conn->closed) {
+            shutdown(conn->fd, SHUT_RDWR);
+            close(conn->fd);
+        }
+        delete conn;
+    }
     close(sockfd);
-    close(epfd);
-}
\ No newline at end of file
+}
@@ -1,6 +1,36 @@
-g++ -std=c++11 -o rpc_test \
+#!/bin/bash
+# 编译 RPC 服务端 rpc_test、客户端示例 rpc_client 和压测工具 rpc_bench
+cd "$(dirname "$0")"
+
+# 先用 protoc 生成 user.pb.h / user.pb.cc (需要 cc_generic_services)，放在 build/ 下
+mkdir -p build
+protoc --cpp_out=build -I../protobuf/protocol ../protobuf/protocol/user.proto
+
+g++ -std=c++17 -o rpc_test \
     src/main.cpp \
     src/rpc_provider.cpp \
-    src/user_service_impl.cpp \
-    -I./include \
-    -pthread
\ No newline at end of file
+    src/rpc_codec.cpp \
+    src/rpc_event_loop.cpp \
+    src/rpc_event_loop_uring.cpp \
+    src/rpc_method_table.cpp \
+    src/rpc_arena_pool.cpp \
+    ../thread_pool_demo/ThreadPool.cc \
+    build/user.pb.cc \
+    -I./include -Ibuild \
+    -pthread -lprotobuf
+
+g++ -std=c++17 -o rpc_client \
+    src/rpc_client.cpp \
+    src/rpc_channel.cpp \
+    src/rpc_codec.cpp \
+    build/user.pb.cc \
+    -I./include -Ibuild \
+    -pthread -lprotobuf
+
+g++ -std=c++17 -O2 -o rpc_bench \
+    src/rpc_bench.cpp \
+    src/rpc_channel.cpp \
+    src/rpc_codec.cpp \
+    build/user.pb.cc \
+    -I./include -Ibuild \
+    -pthread -lprotobuf
@@ -0,0 +1,36 @@
+#pragma once
+
+/**
+ * 每次调用的 protobuf Arena 池
+ *
+ * request / response 都分配在调用自己的 Arena 上，调用结束时 Reset 一次整体释放，不再逐个 new / delete。
+ * 每个 RpcArena 自带一块首块内存 (initial_block)，Reset 后首块保留，小消息复用时不再 malloc。
+ *
+ * Arena 在 I/O 线程取出、在 done 线程 (worker 或业务线程) 归还，所以池子分两层：
+ *  - 每个线程一个本地缓存，取 / 还都不加锁
+ *  - 本地缓存满了把一半整批还给全局池，空了从全局池整批取一半，一次加锁搬很多个
+ */
+#include <google/protobuf/arena.h>
+#include <cstddef>
+
+const size_t RPC_ARENA_BLOCK_SIZE = 4096;       // 每个 arena 自带的首块内存，Reset 后保留
+const size_t RPC_ARENA_CACHE_SIZE = 64;         // 每个线程本地缓存的上限
+const size_t RPC_ARENA_GLOBAL_MAX = 4096;       // 全局池上限，超过的直接释放
+
+struct RpcArena
+{
+    alignas(8) char block[RPC_ARENA_BLOCK_SIZE];
+    google::protobuf::Arena arena;
+
+    RpcArena();
+};
+
+class RpcArenaPool
+{
+public:
+    // 取一个空的 arena
+    static RpcArena *Acquire();
+
+    // Reset 后放回当前线程的缓存，可以在任意线程调用
+    static void Release(RpcArena *a);
+};
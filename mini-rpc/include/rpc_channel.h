@@ -0,0 +1,154 @@
+#pragma once
+
+/**
+ * RPC 客户端：实现 google::protobuf::RpcChannel，生成的 UserService_Stub 直接用它发请求
+ *
+ *  - 连接池：启动时建立 connections 条长连接，调用轮询分配；断开的连接在下次被选中时重连
+ *  - 流水线：一个连接上可以同时有很多个未完成的调用，响应按请求ID匹配，不要求按顺序返回
+ *  - 超时：每个调用有截止时间 (RpcController::SetTimeout，默认 timeout_ms)，超时以失败结束
+ *  - 同步 / 异步：done == nullptr 时 CallMethod 阻塞到调用结束；否则立即返回，结束时调用 done
+ *
+ * 所有连接的收包、超时检查都在 channel 自己的一个 I/O 线程里做；发包在调用方线程里直接写，写不完的交给 I/O 线程。
+ * 调用的截止时间挂在时间轮上 (common/timing_wheel.h)，I/O 线程睡到最近的截止时间；
+ * 调用方登记的截止时间比 I/O 线程计划醒来的时间还早时，通过 eventfd 把它提前叫醒。
+ * 异步调用的 done 在 I/O 线程中执行，应当尽快返回，不能在里面发起同步调用。
+ * 和 protobuf 的约定一样：调用结束之前 request 之外的 controller / response 都必须保持有效。
+ */
+#include <google/protobuf/service.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rpc_codec.h"
+#include "../../common/timing_wheel.h"
+
+const int RPC_CLIENT_DEFAULT_CONNECTIONS = 4;
+const int RPC_CLIENT_DEFAULT_TIMEOUT_MS = 5000;
+const int RPC_CLIENT_TIMER_TICK_MS = 1;         // 调用超时的精度
+const int RPC_CLIENT_MAX_EVENTS = 256;
+
+struct RpcChannelOptions
+{
+    std::string host = "127.0.0.1";
+    int port = 8888;
+    int connections = RPC_CLIENT_DEFAULT_CONNECTIONS;  // 连接池大小
+    int timeout_ms = RPC_CLIENT_DEFAULT_TIMEOUT_MS;    // 调用默认超时
+};
+
+// 记录一次调用的结果，以及可选的单次超时
+class RpcController : public google::protobuf::RpcController
+{
+public:
+    void Reset() override;
+    bool Failed() const override { return failed_; }
+    std::string ErrorText() const override { return error_text_; }
+    void StartCancel() override {}
+    void SetFailed(const std::string &reason) override;
+    bool IsCanceled() const override { return false; }
+    void NotifyOnCancel(google::protobuf::Closure *) override {}
+
+    // 本次调用的超时，0 表示使用 channel 的默认值
+    void SetTimeout(int timeout_ms) { timeout_ms_ = timeout_ms; }
+    int timeout_ms() const { return timeout_ms_; }
+
+private:
+    bool failed_ = false;
+    std::string error_text_;
+    int timeout_ms_ = 0;
+};
+
+class RpcChannel : public google::protobuf::RpcChannel
+{
+public:
+    explicit RpcChannel(const RpcChannelOptions &opts = RpcChannelOptions());
+    ~RpcChannel();
+
+    RpcChannel(const RpcChannel &) = delete;
+    RpcChannel &operator=(const RpcChannel &) = delete;
+
+    void CallMethod(const google::protobuf::MethodDescriptor *method,
+                    google::protobuf::RpcController *controller,
+                    const google::protobuf::Message *request,
+                    google::protobuf::Message *response,
+                    google::protobuf::Closure *done) override;
+
+private:
+    struct ClientConnection;
+    struct PendingCall;
+
+    // 到期的调用，在 timer_mutex_ 里从时间轮上摘下来时记下；之后只按 (连接, 请求ID) 去 pending 里找
+    struct TimerEntry
+    {
+        ClientConnection *conn;
+        uint32_t request_id;
+    };
+
+    // 一个未完成的调用：同步调用在调用方栈上，异步调用 new 出来、结束时 delete
+    struct PendingCall
+    {
+        uint32_t request_id;
+        google::protobuf::RpcController *controller;
+        google::protobuf::Message *response;
+        google::protobuf::Closure *done;    // nullptr 表示同步调用
+        ClientConnection *conn = nullptr;   // 发往的连接
+
+        // 截止时间，挂在 timers_ 上，timer_mutex_ 保护 (调用结束前一定先把自己摘掉)
+        TimerNode timer;
+
+        // 同步调用在这里等待
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool finished = false;
+    };
+
+    struct ClientConnection
+    {
+        std::mutex mutex;                   // 保护以下字段 (input 除外)
+        int fd = -1;
+        bool broken = true;                 // 未连接或已断开，下次选中时重连
+        bool want_write = false;            // 已经注册了 EPOLLOUT
+        std::string output;                 // 调用方没写完、等 EPOLLOUT 的数据
+        std::unordered_map<uint32_t, PendingCall*> pending;
+
+        RpcBuffer input;                    // 只在 I/O 线程访问
+    };
+
+    // 建立连接并加入 epoll，调用方持有 conn->mutex
+    bool Connect(ClientConnection *conn);
+
+    // 轮询选一个可用连接，断开的顺便重连；全部不可用返回 nullptr
+    ClientConnection *PickConnection();
+
+    // 调用结束：撤销超时、唤醒同步调用方或执行 done
+    void Complete(PendingCall *call);
+    void Fail(PendingCall *call, const std::string &reason);
+
+    void Loop();
+    void HandleRead(ClientConnection *conn);
+    void HandleWrite(ClientConnection *conn);
+    void HandleResponse(ClientConnection *conn, const RpcResponseFrame &frame);
+    void CloseConnection(ClientConnection *conn, const std::string &reason);
+    void CheckTimeouts();
+
+    RpcChannelOptions opts_;
+    int epfd_;
+    int wakeup_fd_;                         // 唤醒 I/O 线程：析构时退出，或者登记了更早的截止时间
+    std::atomic<bool> quit_{false};
+    std::thread thread_;
+
+    std::vector<std::unique_ptr<ClientConnection>> connections_;
+    std::atomic<unsigned> next_conn_{0};
+    std::atomic<uint32_t> next_request_id_{1};
+
+    // 调用的截止时间；超时后按 (连接, 请求ID) 从 pending 里摘，摘到的一方负责结束调用
+    // 加锁顺序：conn->mutex 在前，timer_mutex_ 在后 (CallMethod 在 conn->mutex 里 arm)
+    std::mutex timer_mutex_;
+    TimingWheel timers_;
+    int64_t wake_at_ms_ = INT64_MAX;        // I/O 线程本次 epoll_wait 最晚醒来的时间，timer_mutex_ 保护
+};
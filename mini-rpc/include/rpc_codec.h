@@ -0,0 +1,120 @@
+#pragma once
+
+/**
+ * RPC 帧编解码
+ *
+ * 请求帧：[请求ID][服务名长度][服务名][方法名长度][方法名][数据长度][数据]
+ * 响应帧：[请求ID][状态码][数据长度][数据]
+ * 所有整数字段都是 4 字节网络字节序 (大端)。
+ *
+ * 连接是长连接，一个连接上可以连续发送 (流水线) 多个请求；
+ * 响应带回请求ID，客户端据此匹配，服务端不必按请求顺序返回。
+ *
+ * 解码是增量的：数据先追加进每个连接自己的 RpcBuffer，凑够一整帧才解析，
+ * 一次 recv 收到半帧或多帧都没问题；解析结果直接指向缓冲区内部，不额外拷贝。
+ */
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <sys/types.h>
+
+const uint32_t RPC_MAX_NAME_LEN = 256;                 // 服务名 / 方法名最大长度
+const uint32_t RPC_MAX_FRAME_SIZE = 64 * 1024 * 1024;  // 单帧最大字节数，超过视为非法请求
+const size_t RPC_BUFFER_INITIAL_SIZE = 4096;
+const size_t RPC_RESPONSE_HEADER_SIZE = 3 * sizeof(uint32_t); // [请求ID][状态码][数据长度]
+
+// 响应状态码
+enum RpcStatus : uint32_t
+{
+    RPC_OK = 0,
+    RPC_NO_SUCH_METHOD = 1,     // 服务或方法不存在
+    RPC_BAD_REQUEST = 2,        // 请求数据解析失败
+    RPC_INTERNAL_ERROR = 3,     // 响应序列化失败等服务端错误
+};
+
+/**
+ * 每个连接的输入缓冲区：[已读 | 可读 | 可写]
+ * 空间不够时先把可读数据挪到头部，还不够再扩容
+ */
+class RpcBuffer
+{
+public:
+    RpcBuffer() : buf_(RPC_BUFFER_INITIAL_SIZE), read_idx_(0), write_idx_(0) {}
+
+    size_t ReadableBytes() const { return write_idx_ - read_idx_; }
+    size_t WritableBytes() const { return buf_.size() - write_idx_; }
+    const char *Peek() const { return buf_.data() + read_idx_; }
+
+    // 消费 n 字节 (n 不超过 ReadableBytes)
+    void Retrieve(size_t n);
+
+    // 保证至少有 n 字节可写空间
+    void EnsureWritable(size_t n);
+
+    // 从 fd 读一次，返回值同 recv()
+    ssize_t ReadFd(int fd);
+
+    // 追加 n 字节 (io_uring 模式下从内核选的缓冲区拷进来)
+    void Append(const char *data, size_t n);
+
+private:
+    std::vector<char> buf_;
+    size_t read_idx_;
+    size_t write_idx_;
+};
+
+// 解码出来的一帧请求，指针都指向 RpcBuffer 内部，下一次 Retrieve / ReadFd 之前有效
+struct RpcRequestFrame
+{
+    uint32_t request_id;
+    const char *service;
+    uint32_t service_len;
+    const char *method;
+    uint32_t method_len;
+    const char *data;
+    uint32_t data_len;
+    size_t frame_len;   // 整帧字节数，处理完后 Retrieve(frame_len)
+};
+
+enum class DecodeStatus
+{
+    NEED_MORE,  // 还不够一整帧，need 给出至少还需要多少字节 (整帧长度未知时为 0)
+    FRAME,      // 解出一帧
+    BAD_FRAME,  // 长度超限，应当关闭连接
+};
+
+/**
+ * 从 [data, data + len) 中解析一帧请求 (所有长度都做边界检查)
+ */
+DecodeStatus DecodeRequestFrame(const char *data, size_t len, RpcRequestFrame *frame, size_t *need);
+
+// 解码出来的一帧响应 (客户端)，data 指向 RpcBuffer 内部
+struct RpcResponseFrame
+{
+    uint32_t request_id;
+    uint32_t status;    // RpcStatus
+    const char *data;
+    uint32_t data_len;
+    size_t frame_len;
+};
+
+/**
+ * 从 [data, data + len) 中解析一帧响应，返回值含义同 DecodeRequestFrame
+ */
+DecodeStatus DecodeResponseFrame(const char *data, size_t len, RpcResponseFrame *frame, size_t *need);
+
+// 请求帧的总字节数
+size_t RequestFrameSize(size_t service_len, size_t method_len, size_t data_len);
+
+// 写请求帧头 (数据之前的部分)，返回数据应该写入的位置；dst 至少有 RequestFrameSize 字节
+char *EncodeRequestHeader(char *dst, uint32_t request_id,
+                          const char *service, uint32_t service_len,
+                          const char *method, uint32_t method_len,
+                          uint32_t data_len);
+
+// 4 字节网络字节序长度
+void EncodeLength(char *dst, uint32_t len);
+uint32_t DecodeLength(const char *src);
+
+// 写响应帧头 (RPC_RESPONSE_HEADER_SIZE 字节)
+void EncodeResponseHeader(char *dst, uint32_t request_id, uint32_t status, uint32_t data_len);
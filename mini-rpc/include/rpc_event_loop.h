@@ -0,0 +1,215 @@
+#pragma once
+
+/**
+ * RPC 服务端的 I/O 事件循环 (one loop per thread，结构同 io-multiplexing/epoll_multi_reactor.cc)
+ *
+ *  - accept 线程拿到连接后轮询交给某个 RpcEventLoop
+ *  - 每个 RpcEventLoop 一个线程 + 一个 epoll (ET 模式) + 自己的连接表，负责连接全部的读写和帧解码
+ *  - 解出的请求帧通过 FrameCallback 交给 RpcProvider，由它派发到 worker 线程池
+ *  - worker 产生的响应通过 Send() 交回连接所属的 loop 线程写出，连接的缓冲区始终只被一个线程访问
+ *  - use_uring 时 loop 线程改用 io_uring (src/rpc_event_loop_uring.cpp)：多次 recv 进内核选的缓冲区，
+ *    每个连接同时只有一个 sendmsg 在途，一轮产生的所有请求和等待合并成一次 io_uring_enter
+ *  - zerocopy 时 (epoll 模式) 大批响应用 MSG_ZEROCOPY 发送：内核直接引用 arena 里的页，
+ *    发完的响应先留在 zerocopy_pending，等错误队列上的完成通知 (EPOLLERR) 再释放；
+ *    关闭时还有零拷贝没完成的连接先不 close，通知到齐 (最多 RPC_ZEROCOPY_LINGER_MS) 再关
+ *  - idle_timeout_ms > 0 时连接超过这么久没有收发 (包括对端不读导致响应发不出去) 就关闭；
+ *    超时挂在每个 loop 自己的时间轮上 (common/timing_wheel.h)，下一次到期就是 epoll_wait / io_uring_enter 的等待超时
+ */
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <ctime>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rpc_codec.h"
+#include "rpc_arena_pool.h"
+#include "../../common/timing_wheel.h"
+
+const int RPC_MAX_EVENTS = 1024;
+const int RPC_MAX_IOV = 64;                                 // 一次 sendmsg 最多合并的响应段数
+const size_t RPC_OUTPUT_HIGH_WATER_MARK = 64 * 1024 * 1024; // 输出积压超过这个值认为客户端读得太慢，断开
+const unsigned RPC_URING_ENTRIES = 1024;                    // io_uring 提交队列大小
+const unsigned RPC_URING_BUFFER_COUNT = 1024;               // 每个 loop 的 recv 缓冲区块数 (2 的幂)
+const size_t RPC_URING_BUFFER_SIZE = 4096;
+const size_t RPC_ZEROCOPY_THRESHOLD = 16 * 1024;            // 一次 sendmsg 超过这么多字节才用 MSG_ZEROCOPY，小包 pin 页 + 通知比拷贝还贵
+const int RPC_ZEROCOPY_LINGER_MS = 5000;                    // 已关闭的连接最多等这么久的零拷贝完成通知，之后 RST 丢掉发送队列
+const int RPC_TIMER_TICK_MS = 10;                           // 空闲超时的精度
+
+// 定时器用的单调时钟 (毫秒，粗粒度就够)
+inline int64_t rpc_loop_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+class RpcEventLoop;
+class IoUring;
+class IoUringBufferRing;
+struct io_uring_cqe;
+
+/**
+ * 一段待发送的响应，两种来源：
+ *  - 正常响应直接序列化在调用的 arena 上 (帧头预留在最前面)，写完才把 arena 还给池子，中间不再拷贝
+ *  - 错误帧之类的小数据自己持有一个 std::string
+ */
+class RpcOutputChunk
+{
+public:
+    explicit RpcOutputChunk(std::string &&data) : owned_(std::move(data)), arena_(nullptr), data_(nullptr), len_(owned_.size()) {}
+    RpcOutputChunk(RpcArena *arena, const char *data, size_t len) : arena_(arena), data_(data), len_(len) {}
+
+    RpcOutputChunk(RpcOutputChunk &&other)
+        : owned_(std::move(other.owned_)), arena_(other.arena_), data_(other.data_), len_(other.len_) {
+        other.arena_ = nullptr;
+    }
+    RpcOutputChunk(const RpcOutputChunk &) = delete;
+    RpcOutputChunk &operator=(const RpcOutputChunk &) = delete;
+
+    ~RpcOutputChunk() {
+        if (arena_ != nullptr) {
+            RpcArenaPool::Release(arena_);
+        }
+    }
+
+    const char *data() const { return arena_ != nullptr ? data_ : owned_.data(); }
+    size_t size() const { return len_; }
+
+private:
+    std::string owned_;
+    RpcArena *arena_;
+    const char *data_;
+    size_t len_;
+};
+
+// 一个客户端连接：除了 loop 以外的字段只在所属 loop 线程中访问
+struct RpcConnection
+{
+    int fd;
+    RpcEventLoop *loop;
+    RpcBuffer input;                    // 收到、还没解出完整帧的数据
+    std::deque<RpcOutputChunk> output;  // 还没写出去的响应，按到达顺序
+    size_t output_offset = 0;           // output.front() 已经写出的字节数
+    size_t output_bytes = 0;            // output 中还没写出的总字节数
+    bool dirty = false;                 // 本轮有新响应，等本轮事件处理完一起 flush
+    bool want_write = false;            // 已经注册了 EPOLLOUT
+    bool closed = false;                // 关闭后迟到的响应直接丢弃
+
+    // io_uring 模式：在途的请求引用着连接，全部完成之前连接不能释放
+    bool recv_armed = false;            // 多次 recv 还在生效
+    bool send_inflight = false;         // sendmsg 在途，send_msg / send_iov 和 output 前几段被内核引用
+    struct msghdr send_msg;
+    std::vector<struct iovec> send_iov;
+
+    // MSG_ZEROCOPY：内核按成功的零拷贝 sendmsg 次数编号，完成通知给出一段编号区间；
+    // 区间不保证按顺序到达 (例如重传之后)，只有从头连续完成的部分才能释放
+    bool zerocopy = false;              // 已开启 SO_ZEROCOPY
+    uint32_t zerocopy_issued = 0;       // 已发出的零拷贝 sendmsg 个数
+    uint32_t zerocopy_completed = 0;    // 编号小于它的发送都已完成
+    std::vector<std::pair<uint32_t, uint32_t>> zerocopy_early;         // zerocopy_completed 之后已经完成的编号区间 [lo, hi]
+    std::deque<std::pair<uint32_t, RpcOutputChunk>> zerocopy_pending;   // (最后引用它的编号, 已发完但内核可能还在读的响应)
+
+    // 空闲超时：收发只更新 last_active_ms，定时器到期时再看要不要顺延；
+    // 关闭后在等零拷贝通知的连接复用这个定时器作为等待的截止时间
+    int64_t last_active_ms = 0;
+    TimerNode timer;
+
+    RpcConnection(int fd, RpcEventLoop *loop) : fd(fd), loop(loop) {}
+};
+typedef std::shared_ptr<RpcConnection> RpcConnectionPtr;
+
+struct RpcEventLoopOptions
+{
+    bool use_uring = false;     // 用 io_uring 代替 epoll (Linux >= 5.19)
+    bool zerocopy = false;      // 大批响应用 MSG_ZEROCOPY 发送 (Linux >= 4.14，仅 epoll 模式)
+    int idle_timeout_ms = 0;    // 连接多久没有收发就关闭，0 表示不限
+};
+
+class RpcEventLoop
+{
+public:
+    // 在 loop 线程中调用；frame 指向连接的输入缓冲区，只在回调期间有效
+    typedef std::function<void(const RpcConnectionPtr&, const RpcRequestFrame&)> FrameCallback;
+    // 连接关闭时在 loop 线程中调用
+    typedef std::function<void(const RpcConnectionPtr&)> CloseCallback;
+
+    RpcEventLoop(int id, FrameCallback on_frame, CloseCallback on_close,
+                 const RpcEventLoopOptions &opts = RpcEventLoopOptions());
+    ~RpcEventLoop();
+
+    // 退出事件循环并关闭剩余连接；之后 Send() 仍可调用，数据会被丢弃
+    void Stop();
+
+    // 任意线程调用：把新连接 (非阻塞 fd) 交给本 loop
+    void AddConnection(int fd);
+
+    // 任意线程调用：把一段编码好的响应写到连接上
+    // 不会立即 send：同一轮里同一连接的所有响应合并成一次 sendmsg
+    void Send(const RpcConnectionPtr &conn, RpcOutputChunk &&chunk);
+
+private:
+    void Loop();
+    void Wakeup();
+    void HandleWakeup();
+    void HandleRead(const RpcConnectionPtr &conn);
+    bool DecodeFrames(const RpcConnectionPtr &conn);
+    bool DecodeFrom(const RpcConnectionPtr &conn, const char *data, size_t len, size_t *consumed, size_t *need);
+    void AppendOutput(const RpcConnectionPtr &conn, RpcOutputChunk &&chunk);
+    void FlushDirty();
+    bool Flush(const RpcConnectionPtr &conn);
+    void ConsumeOutput(const RpcConnectionPtr &conn, size_t sent);
+    bool ReapZerocopy(const RpcConnectionPtr &conn);
+    void HandleLinger(const RpcConnectionPtr &conn);
+    void FinishClose(const RpcConnectionPtr &conn, bool abort);
+    void StartIdleTimer(const RpcConnectionPtr &conn);
+    int NextTimeout();
+    void AdvanceTimers();
+    void UpdateEvents(const RpcConnectionPtr &conn, bool want_write);
+    void CloseConnection(const RpcConnectionPtr &conn);
+
+    // io_uring 模式 (rpc_event_loop_uring.cpp)
+    void LoopUring();
+    void ArmWakeup();
+    void ArmRecv(const RpcConnectionPtr &conn);
+    void StartSend(const RpcConnectionPtr &conn);
+    void HandleRecvCompletion(const RpcConnectionPtr &conn, const struct io_uring_cqe &cqe);
+    void HandleSendCompletion(const RpcConnectionPtr &conn, int res);
+    void ReleaseIfIdle(const RpcConnectionPtr &conn);
+
+    int id_;
+    bool use_uring_;
+    bool zerocopy_;
+    int idle_timeout_ms_;
+    int epfd_;
+    int wakeup_fd_;                 // eventfd，其它线程交来连接 / 响应时唤醒 epoll_wait
+    std::thread thread_;
+    std::thread::id thread_id_;
+    std::atomic<bool> quit_{false};
+
+    FrameCallback on_frame_;
+    CloseCallback on_close_;
+
+    std::mutex pending_mutex_;
+    std::vector<int> pending_fds_;
+    std::vector<std::pair<RpcConnectionPtr, RpcOutputChunk>> pending_sends_;
+
+    std::unordered_map<int, RpcConnectionPtr> connections_;
+    std::unordered_map<int, RpcConnectionPtr> lingering_;  // 已关闭 (epoll 模式)，fd 留着等零拷贝完成通知
+    std::vector<RpcConnectionPtr> dirty_;   // 本轮有新响应的连接 (loop 线程)
+    TimingWheel wheel_;                     // 空闲超时和零拷贝等待的截止时间 (loop 线程)
+    int64_t now_ms_;                        // 本轮事件开始处理的时间 (loop 线程)
+
+    // io_uring 模式，都只在 loop 线程访问；ring 必须在 loop 线程里创建 (SINGLE_ISSUER)
+    IoUring *ring_ = nullptr;
+    IoUringBufferRing *buffers_ = nullptr;
+    uint64_t wakeup_value_ = 0;                                     // eventfd 读请求的目标
+    std::unordered_map<RpcConnection*, RpcConnectionPtr> closing_;  // 已关闭但还有请求在途
+    std::vector<RpcConnectionPtr> starved_;                         // 缓冲区用完停掉了 recv，等缓冲区还回来再挂
+};
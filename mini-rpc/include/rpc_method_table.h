@@ -0,0 +1,57 @@
+#pragma once
+
+/**
+ * RPC 方法分发表
+ *
+ * NotifyService 时把每个方法解析好 (服务对象、MethodDescriptor、请求/响应原型) 存进一个连续数组，
+ * 再建一张开放寻址 (线性探测) 哈希表，键是 "服务名 + 方法名" 的哈希。
+ * 请求到达时直接拿帧里的 (指针, 长度) 查表：一次哈希 + 通常一次探测，不构造 std::string，不再调用 FindMethodByName。
+ * 注册只在 Run 之前进行，之后只读，多个 I/O 线程并发查找无需加锁。
+ */
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace protobuf {
+class Service;
+class MethodDescriptor;
+class Message;
+}
+}
+
+const size_t RPC_METHOD_TABLE_MIN_SLOTS = 16;
+
+// 一个已注册的方法，查表结果直接可用
+struct RpcMethod
+{
+    std::string service_name;
+    std::string method_name;
+    uint64_t hash;
+    google::protobuf::Service *service;
+    const google::protobuf::MethodDescriptor *md;
+    const google::protobuf::Message *request_prototype;
+    const google::protobuf::Message *response_prototype;
+};
+
+class RpcMethodTable
+{
+public:
+    // 注册服务的所有方法；同名方法后注册的覆盖先注册的
+    void Add(google::protobuf::Service *service);
+
+    // 找不到返回 nullptr
+    const RpcMethod *Find(const char *service, size_t service_len, const char *method, size_t method_len) const;
+
+    size_t size() const { return methods_.size(); }
+
+private:
+    static uint64_t Hash(const char *service, size_t service_len, const char *method, size_t method_len);
+
+    // 装载率保持在 1/2 以下，探测链很短
+    void Rebuild();
+
+    std::vector<RpcMethod> methods_;
+    std::vector<int32_t> slots_;    // methods_ 的下标，-1 表示空槽；大小是 2 的幂
+};
@@ -1,7 +1,67 @@
 #pragma once
 #include <google/protobuf/service.h>
-#include <map>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include "../../common/listen_socket.h"
+#include "../../thread_pool_demo/ThreadPool.h"
+#include "rpc_event_loop.h"
+#include "rpc_method_table.h"
+#include "rpc_arena_pool.h"
+
+const int RPC_DEFAULT_IO_THREADS = 1;
+const int RPC_DEFAULT_WORKER_THREADS = 4;
+const int RPC_BACKEND_THREADS = 2;     // 业务异步完成调用的执行器线程数
+const int RPC_DRAIN_POLL_MS = 50;
+
+// I/O 线程和 worker 线程数
+struct RpcServerOptions
+{
+    int io_threads = RPC_DEFAULT_IO_THREADS;         // RpcEventLoop 个数，负责收发和解码
+    int worker_threads = RPC_DEFAULT_WORKER_THREADS; // 执行 CallMethod 的线程数
+    bool use_uring = false;                          // 事件循环用 io_uring 代替 epoll
+    bool zerocopy = false;                           // 大批响应用 MSG_ZEROCOPY 发送 (epoll 模式)
+};
+
+// 解析 -i N (I/O 线程数)、-t N (worker 线程数)、-U (io_uring) 和 -z (MSG_ZEROCOPY)，写法同 parse_listen_options，两者可以共用 argv
+inline RpcServerOptions parse_rpc_server_options(int argc, char *argv[])
+{
+    RpcServerOptions opts;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            opts.io_threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            opts.worker_threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-U") == 0) {
+            opts.use_uring = true;
+        }
+        else if (strcmp(argv[i], "-z") == 0) {
+            opts.zerocopy = true;
+        }
+    }
+    if (opts.io_threads <= 0) opts.io_threads = RPC_DEFAULT_IO_THREADS;
+    if (opts.worker_threads <= 0) opts.worker_threads = RPC_DEFAULT_WORKER_THREADS;
+    return opts;
+}
+
+/**
+ * 一次调用的上下文：request / response 分配在它的 arena 上，done 回调 (SendResponse) 里整体归还
+ * 业务实现可以把 done 带到别的线程、等后端返回后再调用，框架不假设 CallMethod 返回时调用已经结束
+ */
+struct RpcCall
+{
+    RpcConnectionPtr conn;  // 响应交回连接所属的 loop 写出；连接已关闭时丢弃
+    uint32_t request_id;
+    RpcArena *arena;        // 从 RpcArenaPool 取出；响应序列化在上面，写出后由 loop 归还
+    google::protobuf::Message *request;
+    google::protobuf::Message *response;
+};
 
 class RpcProvider {
 public:
@@ -10,33 +70,47 @@ public:
     void NotifyService(Service *service);
 
     // 启动 RPC 服务器
-    void Run();
+    // opts.shards > 1 时使用 SO_REUSEPORT 分片监听，每个分片一个 accept 线程
+    // accept 到的连接轮询交给 server_opts.io_threads 个事件循环，CallMethod 在 worker 线程池中执行
+    void Run(const ListenOptions &opts = ListenOptions(),
+             const RpcServerOptions &server_opts = RpcServerOptions());
 
     // 【新增】声明发送响应的成员函数
-    // 参数：connfd (连接句柄), response (响应消息指针)
-    void SendResponse(int connfd, google::protobuf::Message* response);
+    // 参数：call (连接句柄、请求ID、arena 和其上的请求 / 响应消息)，arena 随响应交给连接所属的 loop
+    // 作为 done 回调可以在任意线程、CallMethod 返回之后的任意时刻调用，每次调用恰好一次
+    void SendResponse(RpcCall *call);
+
+    // 业务异步完成调用用的执行器 (Run 开始后有效)：线程数固定，不会每个调用起一个线程；
+    // 排空时在 worker 之后停掉，provider 销毁前所有投递的任务都已结束
+    ThreadPool &Backend() { return *backend_; }
 
 private:
-    // 存储服务的映射表：服务名 -> (方法名 -> 服务对象指针)
-    std::map<std::string, std::map<std::string, google::protobuf::Service*>> service_map_;
+    // 方法分发表：(服务名, 方法名) -> 服务对象、方法描述符、请求/响应原型
+    RpcMethodTable method_table_;
     
-    // 处理客户端请求的函数
-    void OnMessage(int connfd);
+    std::vector<std::unique_ptr<RpcEventLoop>> loops_;
+    std::unique_ptr<ThreadPool> workers_;
+    std::unique_ptr<ThreadPool> backend_;   // Backend()
+    std::atomic<unsigned> next_loop_{0};    // 新连接轮询分配
+    std::atomic<int> connection_count_{0};  // 排空时等它归零
+    std::atomic<int> pending_calls_{0};     // 已派发、done 还没调用的请求数，排空时等它归零
+
+    // 单个监听 socket 上的 accept 循环
+    void AcceptLoop(int server_fd);
+
+    // 开始排空后：等已有连接断开、已派发的调用完成 (不超过排空截止时间)
+    void Drain();
+
+    // 处理一帧请求 (在 I/O 线程中调用)：查找方法、解析请求，然后派发到 worker
+    void OnMessage(const RpcConnectionPtr &conn, const RpcRequestFrame &frame);
+
+    // 请求无法处理时只回状态码
+    void SendError(const RpcConnectionPtr &conn, uint32_t request_id, uint32_t status);
 };
 
 // 模板函数的实现必须写在头文件里
 template<typename Service>
 void RpcProvider::NotifyService(Service *service) {
-    // 1. 获取服务描述符 (Protobuf 生成的元数据)
-    const google::protobuf::ServiceDescriptor* sd = service->GetDescriptor();
-    std::string service_name = sd->name();
-
-    // 2. 遍历该服务的所有方法
-    for (int i = 0; i < sd->method_count(); ++i) {
-        const google::protobuf::MethodDescriptor* md = sd->method(i);
-        std::string method_name = md->name();
-        
-        // 3. 存入映射表
-        service_map_[service_name][method_name] = service;
-    }
+    // 通过 Protobuf 反射 (服务描述符) 遍历所有方法，注册时就解析好分发需要的一切
+    method_table_.Add(service);
 }
\ No newline at end of file
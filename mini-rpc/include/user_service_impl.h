@@ -0,0 +1,64 @@
+#pragma once
+#include "user.pb.h"
+#include "rpc_provider.h"
+#include <iostream>
+
+// 继承自 Protobuf 生成的 UserService 基类
+class UserServiceImpl : public fixbug::UserService {
+public:
+    // provider 提供异步完成调用的执行器
+    explicit UserServiceImpl(RpcProvider *provider) : provider_(provider) {}
+
+    // 实现 Login 方法
+    void Login(google::protobuf::RpcController* controller,
+               const ::fixbug::LoginRequest* request,
+               ::fixbug::LoginResponse* response,
+               google::protobuf::Closure* done) override {
+        
+        std::string name = request->name();
+        std::string pwd = request->pwd();
+
+        std::cout << "[Business Logic] Login called. Name: " << name << ", Pwd: " << pwd << std::endl;
+
+        // 模拟业务判断
+        if (name == "zhangsan" && pwd == "123456") {
+            response->set_code(0);
+            response->set_msg("Login successful!");
+        } else {
+            response->set_code(1);
+            response->set_msg("Invalid username or password.");
+        }
+
+        // 执行回调，发送响应
+        if (done != nullptr) {
+            done->Run();
+        }
+    }
+
+    // 实现 GetUserInfo 方法：演示异步完成
+    // 模拟去后端查询 (在 provider 的 backend 执行器里完成)，CallMethod 立即返回，worker 线程不被占住；
+    // request / response 由框架保留到 done 运行为止
+    void GetUserInfo(google::protobuf::RpcController* /*controller*/,
+                     const ::fixbug::GetUserInfoRequest* request,
+                     ::fixbug::GetUserInfoResponse* response,
+                     google::protobuf::Closure* done) override {
+        provider_->Backend().submit([request, response, done]() {
+            int id = request->id();
+            if (id > 0) {
+                response->set_code(0);
+                response->set_name("user_" + std::to_string(id));
+                response->set_is_vip(id % 2 == 0);
+            } else {
+                response->set_code(1);
+            }
+
+            // 查询完成后再回复，可以在任意线程调用
+            if (done != nullptr) {
+                done->Run();
+            }
+        });
+    }
+
+private:
+    RpcProvider *provider_;
+};
\ No newline at end of file
@@ -0,0 +1,10 @@
+#include "rpc_provider.h"
+#include "user_service_impl.h"
+
+// RPC 服务端：-i / -t 设置 I/O、worker 线程数，-s / -c / -u / -d 同其它服务器
+int main(int argc, char *argv[]) {
+    RpcProvider provider;
+    provider.NotifyService(new UserServiceImpl(&provider));
+    provider.Run(parse_listen_options(argc, argv), parse_rpc_server_options(argc, argv));
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "rpc_arena_pool.h"
+#include <mutex>
+#include <vector>
+
+namespace {
+
+google::protobuf::ArenaOptions arena_options(char *block)
+{
+    google::protobuf::ArenaOptions opts;
+    opts.initial_block = block;
+    opts.initial_block_size = RPC_ARENA_BLOCK_SIZE;
+    return opts;
+}
+
+// 全局池：只在本地缓存满 / 空时整批访问
+struct GlobalArenaPool
+{
+    std::mutex mutex;
+    std::vector<RpcArena*> items;
+};
+
+GlobalArenaPool &global_pool()
+{
+    // 故意不析构：进程退出时其它线程的本地缓存可能还在往里还
+    static GlobalArenaPool *pool = new GlobalArenaPool;
+    return *pool;
+}
+
+// 线程退出时把缓存还给全局池
+struct LocalArenaCache
+{
+    std::vector<RpcArena*> items;
+
+    ~LocalArenaCache() {
+        GlobalArenaPool &global = global_pool();
+        std::lock_guard<std::mutex> lock(global.mutex);
+        for (RpcArena *a : items) {
+            if (global.items.size() < RPC_ARENA_GLOBAL_MAX) {
+                global.items.push_back(a);
+            }
+            else {
+                delete a;
+            }
+        }
+    }
+};
+
+thread_local LocalArenaCache local_cache;
+
+} // namespace
+
+RpcArena::RpcArena() : arena(arena_options(block)) {}
+
+RpcArena *RpcArenaPool::Acquire() {
+    std::vector<RpcArena*> &local = local_cache.items;
+    if (local.empty()) {
+        // 本地空了：从全局池整批拿一半缓存容量
+        GlobalArenaPool &global = global_pool();
+        std::lock_guard<std::mutex> lock(global.mutex);
+        size_t n = global.items.size() < RPC_ARENA_CACHE_SIZE / 2 ? global.items.size() : RPC_ARENA_CACHE_SIZE / 2;
+        local.insert(local.end(), global.items.end() - n, global.items.end());
+        global.items.resize(global.items.size() - n);
+    }
+
+    if (local.empty()) {
+        return new RpcArena;
+    }
+    RpcArena *a = local.back();
+    local.pop_back();
+    return a;
+}
+
+void RpcArenaPool::Release(RpcArena *a) {
+    // 释放 arena 上的所有消息 (以及超出首块的内存)，首块保留
+    a->arena.Reset();
+
+    std::vector<RpcArena*> &local = local_cache.items;
+    local.push_back(a);
+    if (local.size() < RPC_ARENA_CACHE_SIZE) return;
+
+    // 本地满了：整批还一半给全局池，全局池也满了就直接释放
+    GlobalArenaPool &global = global_pool();
+    std::vector<RpcArena*> overflow;
+    {
+        std::lock_guard<std::mutex> lock(global.mutex);
+        for (size_t i = RPC_ARENA_CACHE_SIZE / 2; i < local.size(); i++) {
+            if (global.items.size() < RPC_ARENA_GLOBAL_MAX) {
+                global.items.push_back(local[i]);
+            }
+            else {
+                overflow.push_back(local[i]);
+            }
+        }
+    }
+    local.resize(RPC_ARENA_CACHE_SIZE / 2);
+    for (RpcArena *extra : overflow) {
+        delete extra;
+    }
+}
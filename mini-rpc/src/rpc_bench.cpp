@@ -0,0 +1,330 @@
+/**
+ * RPC 压测工具：用 RpcChannel 对 RpcProvider 施压，统计吞吐和延迟分位数
+ *
+ *   ./rpc_bench [-h host] [-p port] [-c 连接数] [-T client I/O 线程数] [-d 每连接并发深度]
+ *               [-s 请求体字节数] [-r 目标 QPS] [-t 压测秒数] [-w 预热秒数] [-m login|info] [-q]
+ *
+ * 闭环 (默认)：每个连接上始终保持 depth 个调用在途，一个完成立即补发下一个，测的是最大吞吐。
+ * 开环 (-r QPS)：按固定间隔排好每个请求"应该发出"的时间，延迟从这个时间算起，而不是实际发出的时间。
+ *   服务端一卡顿，后面排队没发出去的请求也会被记上等待时间，避免协调遗漏 (coordinated omission)
+ *   把尾延迟藏起来。在途调用数同样受 depth 限制，发不出去的请求继续按计划时间累计延迟。
+ * -q：给 benchmark/run_echo_bench.sh 用，预热结束开始统计时输出一行 "# measuring"，
+ *     结束后输出一行 CSV：requests,errors,throughput,p50,p90,p99,p999,max (延迟单位微秒)
+ */
+#include "rpc_channel.h"
+#include "user.pb.h"
+#include "../../common/latency_histogram.h"
+#include <google/protobuf/descriptor.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+
+struct BenchOptions
+{
+    RpcChannelOptions channel;
+    int channels = 1;           // RpcChannel 个数，每个一个 I/O 线程，连接平均分配
+    int depth = 1;              // 每个连接的在途调用数
+    int payload = 16;           // Login 请求中 name 字段的字节数
+    long rate = 0;              // 开环目标 QPS，0 表示闭环
+    int duration_sec = 10;
+    int warmup_sec = 1;         // 预热期间的结果不计入统计
+    std::string method = "login";
+    bool csv = false;           // -q：只输出一行 CSV
+};
+
+static int64_t bench_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+class BenchClient;
+
+// 一个在途调用，完成后复用 (自己就是 done 回调，不用每次 NewCallback)
+struct BenchCall : public google::protobuf::Closure
+{
+    BenchClient *client;
+    RpcController controller;
+    std::unique_ptr<google::protobuf::Message> request;
+    std::unique_ptr<google::protobuf::Message> response;
+    int64_t start_ns;           // 计算延迟的起点：闭环是发出时间，开环是计划发出时间
+
+    void Run() override;
+};
+
+/**
+ * 一个 RpcChannel 及其上的所有调用；done 回调都在这个 channel 的 I/O 线程中执行，
+ * 所以直方图和计数只被一个线程写，不需要加锁
+ */
+class BenchClient
+{
+public:
+    BenchClient(const BenchOptions &opts, const RpcChannelOptions &channel_opts)
+        : opts_(opts), channel_(channel_opts), max_inflight_(channel_opts.connections * opts.depth) {
+        const google::protobuf::ServiceDescriptor *sd = fixbug::UserService::descriptor();
+        method_ = sd->FindMethodByName(opts.method == "info" ? "GetUserInfo" : "Login");
+
+        fixbug::UserService_Stub stub(&channel_);
+        for (int i = 0; i < max_inflight_; i++) {
+            BenchCall *call = new BenchCall;
+            call->client = this;
+            call->request.reset(stub.GetRequestPrototype(method_).New());
+            call->response.reset(stub.GetResponsePrototype(method_).New());
+            FillRequest(call->request.get(), i);
+            free_calls_.push_back(call);
+        }
+    }
+
+    ~BenchClient() {
+        for (BenchCall *call : free_calls_) {
+            delete call;
+        }
+    }
+
+    // 闭环：一次把所有调用发出去，之后在 done 里补发
+    void StartClosedLoop(int64_t measure_from_ns, int64_t stop_ns) {
+        measure_from_ns_ = measure_from_ns;
+        stop_ns_ = stop_ns;
+        std::vector<BenchCall*> calls;
+        calls.swap(free_calls_);
+        for (BenchCall *call : calls) {
+            Issue(call, bench_now_ns());
+        }
+    }
+
+    // 开环：在调用方线程里按计划时间发请求，直到 stop_ns
+    void RunOpenLoop(long rate, int64_t start_ns, int64_t measure_from_ns, int64_t stop_ns) {
+        measure_from_ns_ = measure_from_ns;
+        stop_ns_ = stop_ns;
+        open_loop_ = true;
+        double interval_ns = 1e9 / rate;
+
+        for (long n = 0; ; n++) {
+            int64_t intended = start_ns + (int64_t)(n * interval_ns);
+            if (intended >= stop_ns) break;
+
+            // 计划时间还没到就等；落后了就立刻发，延迟仍从计划时间算
+            int64_t wait = intended - bench_now_ns();
+            if (wait > 100000) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(wait - 50000));
+            }
+            while (bench_now_ns() < intended) {}
+
+            BenchCall *call = nullptr;
+            while ((call = TakeFreeCall()) == nullptr) {
+                std::this_thread::yield(); // 在途已满：请求继续排队，等待时间算进延迟
+            }
+            Issue(call, intended);
+        }
+    }
+
+    // 等所有在途调用结束
+    void WaitIdle() {
+        while (inflight_.load(std::memory_order_acquire) > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    void OnDone(BenchCall *call) {
+        int64_t now = bench_now_ns();
+        bool failed = call->controller.Failed();
+        if (now >= measure_from_ns_ && now < stop_ns_) {
+            if (failed) {
+                errors_.fetch_add(1, std::memory_order_relaxed);
+            }
+            else {
+                // 成功的调用只会在 I/O 线程里结束，直方图不需要加锁
+                histogram_.record(now - call->start_ns);
+            }
+        }
+
+        // 闭环：立刻补发，保持 depth 个在途；先补发再减计数，WaitIdle 不会看到中间的 0
+        // 失败的不补发：没有连接时 CallMethod 会在当前线程里直接失败，补发会无限递归
+        if (!open_loop_ && now < stop_ns_ && !failed) {
+            Issue(call, now);
+            inflight_.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(free_mutex_);
+            free_calls_.push_back(call);
+        }
+        inflight_.fetch_sub(1, std::memory_order_release);
+    }
+
+    const LatencyHistogram &histogram() const { return histogram_; }
+    uint64_t errors() const { return errors_.load(); }
+
+private:
+    void FillRequest(google::protobuf::Message *request, int i) {
+        if (opts_.method == "info") {
+            static_cast<fixbug::GetUserInfoRequest*>(request)->set_id(i + 1);
+        }
+        else {
+            fixbug::LoginRequest *login = static_cast<fixbug::LoginRequest*>(request);
+            login->set_name(std::string(opts_.payload, 'x'));
+            login->set_pwd("123456");
+        }
+    }
+
+    BenchCall *TakeFreeCall() {
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        if (free_calls_.empty()) return nullptr;
+        BenchCall *call = free_calls_.back();
+        free_calls_.pop_back();
+        return call;
+    }
+
+    void Issue(BenchCall *call, int64_t start_ns) {
+        call->controller.Reset();
+        call->response->Clear();
+        call->start_ns = start_ns;
+        inflight_.fetch_add(1, std::memory_order_relaxed);
+        channel_.CallMethod(method_, &call->controller, call->request.get(), call->response.get(), call);
+    }
+
+    const BenchOptions &opts_;
+    RpcChannel channel_;
+    const google::protobuf::MethodDescriptor *method_;
+    int max_inflight_;
+    bool open_loop_ = false;
+    int64_t measure_from_ns_ = 0;
+    int64_t stop_ns_ = 0;
+
+    std::mutex free_mutex_;
+    std::vector<BenchCall*> free_calls_;
+    std::atomic<int> inflight_{0};
+
+    LatencyHistogram histogram_;
+    std::atomic<uint64_t> errors_{0};   // 立即失败的调用会在发送线程里结束，所以用原子
+};
+
+void BenchCall::Run() {
+    client->OnDone(this);
+}
+
+static BenchOptions parse_bench_options(int argc, char *argv[]) {
+    BenchOptions opts;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) {
+            opts.csv = true;
+            continue;
+        }
+        if (i + 1 >= argc) break;
+        if (strcmp(argv[i], "-h") == 0) opts.channel.host = argv[++i];
+        else if (strcmp(argv[i], "-p") == 0) opts.channel.port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0) opts.channel.connections = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-T") == 0) opts.channels = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0) opts.depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0) opts.payload = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0) opts.rate = atol(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0) opts.duration_sec = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0) opts.warmup_sec = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0) opts.method = argv[++i];
+    }
+    if (opts.channel.connections < 1) opts.channel.connections = 1;
+    if (opts.channels < 1) opts.channels = 1;
+    if (opts.channels > opts.channel.connections) opts.channels = opts.channel.connections;
+    if (opts.depth < 1) opts.depth = 1;
+    if (opts.payload < 0) opts.payload = 0;
+    if (opts.duration_sec < 1) opts.duration_sec = 1;
+    if (opts.warmup_sec < 0) opts.warmup_sec = 0;
+    return opts;
+}
+
+// 压测脚本看到这一行才开始统计服务端 CPU，建连和预热的时间不算进去
+static void print_measuring(int64_t measure_from_ns) {
+    std::this_thread::sleep_for(std::chrono::nanoseconds(measure_from_ns - bench_now_ns()));
+    printf("# measuring\n");
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions opts = parse_bench_options(argc, argv);
+
+    // 连接平均分到各个 channel
+    std::vector<std::unique_ptr<BenchClient>> clients;
+    for (int i = 0; i < opts.channels; i++) {
+        RpcChannelOptions channel_opts = opts.channel;
+        channel_opts.connections = opts.channel.connections / opts.channels
+                                 + (i < opts.channel.connections % opts.channels ? 1 : 0);
+        clients.emplace_back(new BenchClient(opts, channel_opts));
+    }
+
+    if (!opts.csv) {
+        printf("target %s:%d, method %s, %d connections x depth %d, %d client threads, payload %d B, %s\n",
+               opts.channel.host.c_str(), opts.channel.port, opts.method.c_str(),
+               opts.channel.connections, opts.depth, opts.channels, opts.payload,
+               opts.rate > 0 ? "open loop" : "closed loop");
+        if (opts.rate > 0) {
+            printf("target rate %ld req/s\n", opts.rate);
+        }
+    }
+
+    int64_t start = bench_now_ns();
+    int64_t measure_from = start + (int64_t)opts.warmup_sec * 1000000000;
+    int64_t stop = measure_from + (int64_t)opts.duration_sec * 1000000000;
+
+    if (opts.rate > 0) {
+        // 每个 channel 一个发送线程，各承担 1/channels 的速率
+        std::vector<std::thread> pacers;
+        long per_client = opts.rate / opts.channels > 0 ? opts.rate / opts.channels : 1;
+        for (auto &client : clients) {
+            BenchClient *c = client.get();
+            pacers.emplace_back([c, per_client, start, measure_from, stop]() {
+                c->RunOpenLoop(per_client, start, measure_from, stop);
+            });
+        }
+        if (opts.csv) {
+            print_measuring(measure_from);
+        }
+        for (auto &t : pacers) {
+            t.join();
+        }
+    }
+    else {
+        for (auto &client : clients) {
+            client->StartClosedLoop(measure_from, stop);
+        }
+        if (opts.csv) {
+            print_measuring(measure_from);
+        }
+        std::this_thread::sleep_until(std::chrono::steady_clock::now() + std::chrono::nanoseconds(stop - bench_now_ns()));
+    }
+
+    for (auto &client : clients) {
+        client->WaitIdle();
+    }
+
+    LatencyHistogram total;
+    uint64_t errors = 0;
+    for (auto &client : clients) {
+        total.merge(client->histogram());
+        errors += client->errors();
+    }
+
+    if (opts.csv) {
+        printf("%llu,%llu,%.0f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+               (unsigned long long)total.count(), (unsigned long long)errors, (double)total.count() / opts.duration_sec,
+               total.percentile(50) / 1000.0, total.percentile(90) / 1000.0, total.percentile(99) / 1000.0,
+               total.percentile(99.9) / 1000.0, total.max() / 1000.0);
+        return errors == 0 ? 0 : 1;
+    }
+
+    printf("requests %llu, errors %llu, duration %d s, throughput %.0f req/s\n",
+           (unsigned long long)total.count(), (unsigned long long)errors, opts.duration_sec,
+           (double)total.count() / opts.duration_sec);
+    printf("latency (us): p50 %.1f  p90 %.1f  p99 %.1f  p999 %.1f  max %.1f\n",
+           total.percentile(50) / 1000.0, total.percentile(90) / 1000.0, total.percentile(99) / 1000.0,
+           total.percentile(99.9) / 1000.0, total.max() / 1000.0);
+    return errors == 0 ? 0 : 1;
+}
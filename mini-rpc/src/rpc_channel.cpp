@@ -0,0 +1,454 @@
+#include "rpc_channel.h"
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+static int64_t channel_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static const char *rpc_status_text(uint32_t status) {
+    switch (status) {
+    case RPC_NO_SUCH_METHOD: return "no such method";
+    case RPC_BAD_REQUEST: return "bad request";
+    case RPC_INTERNAL_ERROR: return "server internal error";
+    default: return "unknown status";
+    }
+}
+
+void RpcController::Reset() {
+    failed_ = false;
+    error_text_.clear();
+    timeout_ms_ = 0;
+}
+
+void RpcController::SetFailed(const std::string &reason) {
+    failed_ = true;
+    error_text_ = reason;
+}
+
+RpcChannel::RpcChannel(const RpcChannelOptions &opts)
+    : opts_(opts), timers_(channel_now_ms(), RPC_CLIENT_TIMER_TICK_MS) {
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epfd_ == -1 || wakeup_fd_ == -1) {
+        perror("rpc channel create error");
+        exit(1);
+    }
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr; // nullptr 表示唤醒 eventfd
+    if (epoll_ctl(epfd_, EPOLL_CTL_ADD, wakeup_fd_, &event) == -1) {
+        perror("epoll_ctl error");
+        exit(1);
+    }
+
+    // 先把池子里的连接都建好；连不上的留到第一次被选中时再重连
+    int count = opts_.connections > 0 ? opts_.connections : 1;
+    for (int i = 0; i < count; i++) {
+        connections_.emplace_back(new ClientConnection);
+        ClientConnection *conn = connections_.back().get();
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        Connect(conn);
+    }
+
+    thread_ = std::thread(&RpcChannel::Loop, this);
+}
+
+RpcChannel::~RpcChannel() {
+    quit_.store(true, std::memory_order_relaxed);
+    uint64_t one = 1;
+    if (write(wakeup_fd_, &one, sizeof(one)) != sizeof(one)) {
+        perror("wakeup write error");
+    }
+    thread_.join();
+
+    // 还没结束的调用全部以失败结束
+    for (auto &conn : connections_) {
+        CloseConnection(conn.get(), "channel closed");
+    }
+    close(epfd_);
+    close(wakeup_fd_);
+}
+
+bool RpcChannel::Connect(ClientConnection *conn) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("socket error");
+        return false;
+    }
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(opts_.port);
+    if (inet_pton(AF_INET, opts_.host.c_str(), &server_addr.sin_addr) != 1) {
+        fprintf(stderr, "invalid server address: %s\n", opts_.host.c_str());
+        close(fd);
+        return false;
+    }
+
+    // 阻塞 connect，连上之后再改成非阻塞
+    if (connect(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1) {
+        perror("connect error");
+        close(fd);
+        return false;
+    }
+
+    // 请求都是小包，关掉 Nagle，流水线上的请求不用等上一个的 ACK
+    int opt = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = conn;
+    if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &event) == -1) {
+        perror("epoll_ctl error");
+        close(fd);
+        return false;
+    }
+
+    conn->fd = fd;
+    conn->broken = false;
+    conn->want_write = false;
+    conn->output.clear();
+    return true;
+}
+
+RpcChannel::ClientConnection *RpcChannel::PickConnection() {
+    size_t count = connections_.size();
+    for (size_t i = 0; i < count; i++) {
+        ClientConnection *conn = connections_[next_conn_.fetch_add(1, std::memory_order_relaxed) % count].get();
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        if (!conn->broken || Connect(conn)) {
+            return conn;
+        }
+    }
+    return nullptr;
+}
+
+void RpcChannel::CallMethod(const google::protobuf::MethodDescriptor *method,
+                            google::protobuf::RpcController *controller,
+                            const google::protobuf::Message *request,
+                            google::protobuf::Message *response,
+                            google::protobuf::Closure *done) {
+    // 同步调用的上下文放在栈上，结束前不会返回
+    PendingCall local;
+    PendingCall *call = done != nullptr ? new PendingCall : &local;
+    call->request_id = next_request_id_.fetch_add(1, std::memory_order_relaxed);
+    call->controller = controller;
+    call->response = response;
+    call->done = done;
+
+    // 1. 编码请求帧：[请求ID][服务名长度][服务名][方法名长度][方法名][数据长度][数据]，一次分配
+    const std::string &service_name = method->service()->name();
+    const std::string &method_name = method->name();
+    size_t data_len = request->ByteSizeLong();
+    std::string frame(RequestFrameSize(service_name.size(), method_name.size(), data_len), '\0');
+    char *body = EncodeRequestHeader(&frame[0], call->request_id,
+                                     service_name.data(), service_name.size(),
+                                     method_name.data(), method_name.size(), data_len);
+
+    ClientConnection *conn = nullptr;
+    if (!request->SerializeToArray(body, data_len)) {
+        Fail(call, "serialize request failed");
+    }
+    else if ((conn = PickConnection()) == nullptr) {
+        Fail(call, "no connection available");
+    }
+    else {
+        // 2. 登记 pending 和超时都在 conn->mutex 里、发送之前：响应可能在 send 返回之前就到了，
+        //    超时检查也只能在 pending 里已经有这个调用之后才看到它的定时器，否则会把定时器丢掉
+        int timeout_ms = opts_.timeout_ms;
+        RpcController *rpc_controller = dynamic_cast<RpcController*>(controller);
+        if (rpc_controller != nullptr && rpc_controller->timeout_ms() > 0) {
+            timeout_ms = rpc_controller->timeout_ms();
+        }
+        bool wake = false;
+        bool closed = false;
+        {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            if (conn->broken) {
+                closed = true;
+            }
+            else {
+                conn->pending[call->request_id] = call;
+                {
+                    std::lock_guard<std::mutex> timer_lock(timer_mutex_);
+                    int64_t deadline = channel_now_ms() + timeout_ms;
+                    call->conn = conn;
+                    call->timer.data = call;
+                    timers_.arm(&call->timer, deadline);
+                    // I/O 线程睡得比这个截止时间还久：叫醒它重新算超时
+                    if (deadline < wake_at_ms_) {
+                        wake_at_ms_ = deadline;
+                        wake = true;
+                    }
+                }
+
+                // 3. 发送：前面没有积压就直接写，写不完的交给 I/O 线程等 EPOLLOUT
+                size_t sent = 0;
+                if (conn->output.empty()) {
+                    while (sent < frame.size()) {
+                        ssize_t n = send(conn->fd, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+                        if (n > 0) {
+                            sent += n;
+                            continue;
+                        }
+                        if (n == -1 && errno == EINTR) continue;
+                        break; // EAGAIN 或者出错：出错由 I/O 线程发现后关闭连接
+                    }
+                }
+                if (sent < frame.size()) {
+                    conn->output.append(frame, sent, std::string::npos);
+                }
+
+                if (!conn->output.empty() && !conn->want_write) {
+                    epoll_event event;
+                    event.events = EPOLLIN | EPOLLOUT;
+                    event.data.ptr = conn;
+                    epoll_ctl(epfd_, EPOLL_CTL_MOD, conn->fd, &event);
+                    conn->want_write = true;
+                }
+            }
+        }
+        if (wake) {
+            uint64_t one = 1;
+            ssize_t ret = write(wakeup_fd_, &one, sizeof(one));
+            (void)ret;
+        }
+        if (closed) {
+            Fail(call, "connection closed");
+        }
+    }
+
+    // 4. 同步调用：等 I/O 线程收到响应、超时或者连接断开
+    if (done == nullptr) {
+        std::unique_lock<std::mutex> lock(call->mutex);
+        call->cv.wait(lock, [call]() { return call->finished; });
+    }
+}
+
+void RpcChannel::Complete(PendingCall *call) {
+    {
+        std::lock_guard<std::mutex> lock(timer_mutex_);
+        timers_.cancel(&call->timer);
+    }
+
+    if (call->done != nullptr) {
+        call->done->Run();
+        delete call;
+        return;
+    }
+
+    // 在锁内通知：调用方被唤醒后会立即销毁栈上的 call
+    std::lock_guard<std::mutex> lock(call->mutex);
+    call->finished = true;
+    call->cv.notify_one();
+}
+
+void RpcChannel::Fail(PendingCall *call, const std::string &reason) {
+    if (call->controller != nullptr) {
+        call->controller->SetFailed(reason);
+    }
+    else {
+        fprintf(stderr, "rpc call %u failed: %s\n", call->request_id, reason.c_str());
+    }
+    Complete(call);
+}
+
+void RpcChannel::CloseConnection(ClientConnection *conn, const std::string &reason) {
+    std::unordered_map<uint32_t, PendingCall*> pending;
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        if (conn->broken) return;
+        conn->broken = true;
+
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, conn->fd, NULL);
+        close(conn->fd);
+        conn->fd = -1;
+        conn->want_write = false;
+        conn->output.clear();
+        pending.swap(conn->pending);
+    }
+    // 只有 I/O 线程 (或者析构时) 会走到这里，此时没有人在读 input
+    conn->input = RpcBuffer();
+
+    for (auto &item : pending) {
+        Fail(item.second, reason);
+    }
+}
+
+void RpcChannel::HandleResponse(ClientConnection *conn, const RpcResponseFrame &frame) {
+    PendingCall *call = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        auto it = conn->pending.find(frame.request_id);
+        if (it == conn->pending.end()) return; // 已经超时，丢弃迟到的响应
+        call = it->second;
+        conn->pending.erase(it);
+    }
+
+    if (frame.status != RPC_OK) {
+        Fail(call, rpc_status_text(frame.status));
+    }
+    else if (!call->response->ParseFromArray(frame.data, frame.data_len)) {
+        Fail(call, "parse response failed");
+    }
+    else {
+        Complete(call);
+    }
+}
+
+void RpcChannel::HandleRead(ClientConnection *conn) {
+    int fd;
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        if (conn->broken) return;
+        fd = conn->fd;
+    }
+
+    // 水平触发：每次读一次，一个连接不会饿死其它连接
+    ssize_t n = conn->input.ReadFd(fd);
+    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (n <= 0) {
+        CloseConnection(conn, "connection closed");
+        return;
+    }
+
+    RpcBuffer &input = conn->input;
+    RpcResponseFrame frame;
+    size_t need = 0;
+    DecodeStatus status;
+    while ((status = DecodeResponseFrame(input.Peek(), input.ReadableBytes(), &frame, &need)) == DecodeStatus::FRAME) {
+        HandleResponse(conn, frame);
+        input.Retrieve(frame.frame_len);
+    }
+
+    if (status == DecodeStatus::BAD_FRAME) {
+        CloseConnection(conn, "bad response frame");
+        return;
+    }
+    input.EnsureWritable(need);
+}
+
+void RpcChannel::HandleWrite(ClientConnection *conn) {
+    bool error = false;
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        if (conn->broken) return;
+
+        size_t sent = 0;
+        while (sent < conn->output.size()) {
+            ssize_t n = send(conn->fd, conn->output.data() + sent, conn->output.size() - sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                sent += n;
+                continue;
+            }
+            if (n == -1 && errno == EINTR) continue;
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            error = true;
+            break;
+        }
+        conn->output.erase(0, sent);
+
+        if (!error && conn->output.empty()) {
+            epoll_event event;
+            event.events = EPOLLIN;
+            event.data.ptr = conn;
+            epoll_ctl(epfd_, EPOLL_CTL_MOD, conn->fd, &event);
+            conn->want_write = false;
+        }
+    }
+
+    if (error) {
+        CloseConnection(conn, "connection closed");
+    }
+}
+
+void RpcChannel::CheckTimeouts() {
+    std::vector<TimerEntry> expired;
+    {
+        std::lock_guard<std::mutex> lock(timer_mutex_);
+        timers_.advance(channel_now_ms(), [&expired](TimerNode *node) {
+            PendingCall *call = static_cast<PendingCall*>(node->data);
+            expired.push_back(TimerEntry{call->conn, call->request_id});
+        });
+    }
+
+    // 能从 pending 里摘下来才由这里结束；摘不到说明响应刚好到了，由收包的一方结束
+    for (auto &entry : expired) {
+        PendingCall *call = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(entry.conn->mutex);
+            auto it = entry.conn->pending.find(entry.request_id);
+            if (it != entry.conn->pending.end()) {
+                call = it->second;
+                entry.conn->pending.erase(it);
+            }
+        }
+        if (call != nullptr) {
+            Fail(call, "timeout");
+        }
+    }
+}
+
+void RpcChannel::Loop() {
+    epoll_event events[RPC_CLIENT_MAX_EVENTS];
+    while (!quit_.load(std::memory_order_relaxed)) {
+        // 睡到最近的截止时间；期间有更早的截止时间登记进来，调用方会写 eventfd 叫醒
+        int timeout;
+        {
+            std::lock_guard<std::mutex> lock(timer_mutex_);
+            int64_t now = channel_now_ms();
+            timeout = timers_.next_timeout_ms(now);
+            wake_at_ms_ = timeout < 0 ? INT64_MAX : now + timeout;
+        }
+        int n = epoll_wait(epfd_, events, RPC_CLIENT_MAX_EVENTS, timeout);
+        if (n == -1 && errno != EINTR) {
+            perror("epoll_wait error");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            ClientConnection *conn = static_cast<ClientConnection*>(events[i].data.ptr);
+            if (conn == nullptr) {
+                // 唤醒 eventfd：析构要退出，或者有更早的截止时间，读掉计数下一轮重新算超时
+                uint64_t value;
+                ssize_t ret = read(wakeup_fd_, &value, sizeof(value));
+                (void)ret;
+                continue;
+            }
+
+            uint32_t revents = events[i].events;
+            if (revents & (EPOLLERR | EPOLLHUP)) {
+                CloseConnection(conn, "connection closed");
+                continue;
+            }
+            if (revents & EPOLLOUT) {
+                HandleWrite(conn);
+            }
+            if (revents & EPOLLIN) {
+                HandleRead(conn);
+            }
+        }
+
+        CheckTimeouts();
+    }
+}
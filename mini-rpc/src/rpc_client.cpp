@@ -0,0 +1,80 @@
+#include "rpc_channel.h"
+#include "user.pb.h" // 引入生成的头文件
+#include <iostream>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+
+const int ASYNC_CALLS = 1000;
+
+// 一次异步调用要保存到 done 回调里的东西
+struct AsyncUserInfoCall
+{
+    RpcController controller;
+    fixbug::GetUserInfoRequest request;
+    fixbug::GetUserInfoResponse response;
+};
+
+std::atomic<int> g_async_done{0};
+std::atomic<int> g_async_failed{0};
+
+void on_user_info(AsyncUserInfoCall *call) {
+    // 在 channel 的 I/O 线程中执行，尽快返回
+    if (call->controller.Failed()) {
+        g_async_failed++;
+    }
+    g_async_done++;
+    delete call;
+}
+
+int main(int argc, char *argv[]) {
+    RpcChannelOptions opts;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 && i + 1 < argc) {
+            opts.host = argv[++i];
+        }
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            opts.port = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            opts.connections = atoi(argv[++i]);
+        }
+    }
+
+    RpcChannel channel(opts);
+    fixbug::UserService_Stub stub(&channel);
+
+    // 1. 同步调用：像调用本地函数一样
+    fixbug::LoginRequest request;
+    request.set_name("zhangsan");
+    request.set_pwd("123456");
+    fixbug::LoginResponse response;
+    RpcController controller;
+    stub.Login(&controller, &request, &response, nullptr);
+
+    if (controller.Failed()) {
+        std::cout << "Login failed: " << controller.ErrorText() << std::endl;
+        return 1;
+    }
+    std::cout << "Login response: code=" << response.code() << ", msg=" << response.msg() << std::endl;
+
+    // 2. 异步调用：一次发出去很多个，在连接池上流水线执行
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ASYNC_CALLS; i++) {
+        AsyncUserInfoCall *call = new AsyncUserInfoCall;
+        call->request.set_id(i + 1);
+        call->controller.SetTimeout(1000);
+        stub.GetUserInfo(&call->controller, &call->request, &call->response,
+                         google::protobuf::NewCallback(&on_user_info, call));
+    }
+    while (g_async_done.load() < ASYNC_CALLS) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    std::cout << "GetUserInfo x" << ASYNC_CALLS << ": " << elapsed.count() << " ms, failed: "
+              << g_async_failed.load() << std::endl;
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "rpc_codec.h"
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <cstring>
+#include <cerrno>
+
+void EncodeLength(char *dst, uint32_t len) {
+    uint32_t be = htonl(len);
+    memcpy(dst, &be, sizeof(be));
+}
+
+uint32_t DecodeLength(const char *src) {
+    uint32_t be = 0;
+    memcpy(&be, src, sizeof(be));
+    return ntohl(be);
+}
+
+void EncodeResponseHeader(char *dst, uint32_t request_id, uint32_t status, uint32_t data_len) {
+    EncodeLength(dst, request_id);
+    EncodeLength(dst + sizeof(uint32_t), status);
+    EncodeLength(dst + 2 * sizeof(uint32_t), data_len);
+}
+
+void RpcBuffer::Retrieve(size_t n) {
+    read_idx_ += n;
+    // 读空了就回到开头，下次不用挪数据
+    if (read_idx_ == write_idx_) {
+        read_idx_ = 0;
+        write_idx_ = 0;
+    }
+}
+
+void RpcBuffer::EnsureWritable(size_t n) {
+    if (WritableBytes() >= n) return;
+
+    size_t readable = ReadableBytes();
+    if (read_idx_ + WritableBytes() >= n) {
+        // 前面已读的空间加起来够用：把可读数据挪到头部
+        memmove(buf_.data(), buf_.data() + read_idx_, readable);
+    }
+    else {
+        // 按需扩容 (至少翻倍，避免大包多次扩容)
+        size_t want = readable + n;
+        size_t cap = buf_.size() * 2;
+        std::vector<char> bigger(cap > want ? cap : want);
+        memcpy(bigger.data(), buf_.data() + read_idx_, readable);
+        buf_.swap(bigger);
+    }
+    read_idx_ = 0;
+    write_idx_ = readable;
+}
+
+ssize_t RpcBuffer::ReadFd(int fd) {
+    if (WritableBytes() == 0) {
+        EnsureWritable(RPC_BUFFER_INITIAL_SIZE);
+    }
+
+    ssize_t n;
+    do {
+        n = recv(fd, buf_.data() + write_idx_, WritableBytes(), 0);
+    } while (n == -1 && errno == EINTR);
+
+    if (n > 0) {
+        write_idx_ += n;
+    }
+    return n;
+}
+
+void RpcBuffer::Append(const char *data, size_t n) {
+    EnsureWritable(n);
+    memcpy(buf_.data() + write_idx_, data, n);
+    write_idx_ += n;
+}
+
+DecodeStatus DecodeRequestFrame(const char *data, size_t len, RpcRequestFrame *frame, size_t *need) {
+    const size_t LEN = sizeof(uint32_t);
+    *need = 0;
+
+    // [请求ID]
+    size_t offset = 0;
+    if (len < offset + LEN) return DecodeStatus::NEED_MORE;
+    frame->request_id = DecodeLength(data + offset);
+    offset += LEN;
+
+    // [服务名长度][服务名]
+    if (len < offset + LEN) return DecodeStatus::NEED_MORE;
+    uint32_t service_len = DecodeLength(data + offset);
+    if (service_len == 0 || service_len > RPC_MAX_NAME_LEN) return DecodeStatus::BAD_FRAME;
+    offset += LEN;
+    frame->service = data + offset;
+    frame->service_len = service_len;
+    offset += service_len;
+
+    // [方法名长度][方法名]
+    if (len < offset + LEN) return DecodeStatus::NEED_MORE;
+    uint32_t method_len = DecodeLength(data + offset);
+    if (method_len == 0 || method_len > RPC_MAX_NAME_LEN) return DecodeStatus::BAD_FRAME;
+    offset += LEN;
+    frame->method = data + offset;
+    frame->method_len = method_len;
+    offset += method_len;
+
+    // [数据长度][数据]：到这里整帧长度已知，告诉调用方一次准备好空间
+    if (len < offset + LEN) return DecodeStatus::NEED_MORE;
+    uint32_t data_len = DecodeLength(data + offset);
+    if (data_len > RPC_MAX_FRAME_SIZE - offset - LEN) return DecodeStatus::BAD_FRAME;
+    offset += LEN;
+    frame->data = data + offset;
+    frame->data_len = data_len;
+    offset += data_len;
+
+    if (len < offset) {
+        *need = offset - len;
+        return DecodeStatus::NEED_MORE;
+    }
+
+    frame->frame_len = offset;
+    return DecodeStatus::FRAME;
+}
+
+DecodeStatus DecodeResponseFrame(const char *data, size_t len, RpcResponseFrame *frame, size_t *need) {
+    *need = 0;
+    if (len < RPC_RESPONSE_HEADER_SIZE) return DecodeStatus::NEED_MORE;
+
+    // [请求ID][状态码][数据长度]
+    frame->request_id = DecodeLength(data);
+    frame->status = DecodeLength(data + sizeof(uint32_t));
+    uint32_t data_len = DecodeLength(data + 2 * sizeof(uint32_t));
+    if (data_len > RPC_MAX_FRAME_SIZE - RPC_RESPONSE_HEADER_SIZE) return DecodeStatus::BAD_FRAME;
+
+    frame->data = data + RPC_RESPONSE_HEADER_SIZE;
+    frame->data_len = data_len;
+    size_t total = RPC_RESPONSE_HEADER_SIZE + data_len;
+    if (len < total) {
+        *need = total - len;
+        return DecodeStatus::NEED_MORE;
+    }
+
+    frame->frame_len = total;
+    return DecodeStatus::FRAME;
+}
+
+size_t RequestFrameSize(size_t service_len, size_t method_len, size_t data_len) {
+    return 4 * sizeof(uint32_t) + service_len + method_len + data_len;
+}
+
+char *EncodeRequestHeader(char *dst, uint32_t request_id,
+                          const char *service, uint32_t service_len,
+                          const char *method, uint32_t method_len,
+                          uint32_t data_len) {
+    const size_t LEN = sizeof(uint32_t);
+    // [请求ID][服务名长度][服务名][方法名长度][方法名][数据长度]
+    EncodeLength(dst, request_id);
+    dst += LEN;
+    EncodeLength(dst, service_len);
+    dst += LEN;
+    memcpy(dst, service, service_len);
+    dst += service_len;
+    EncodeLength(dst, method_len);
+    dst += LEN;
+    memcpy(dst, method, method_len);
+    dst += method_len;
+    EncodeLength(dst, data_len);
+    return dst + LEN;
+}
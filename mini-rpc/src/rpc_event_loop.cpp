@@ -0,0 +1,560 @@
+#include "rpc_event_loop.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+
+RpcEventLoop::RpcEventLoop(int id, FrameCallback on_frame, CloseCallback on_close, const RpcEventLoopOptions &opts)
+    : id_(id), use_uring_(opts.use_uring), zerocopy_(opts.zerocopy && !opts.use_uring), idle_timeout_ms_(opts.idle_timeout_ms),
+      on_frame_(std::move(on_frame)), on_close_(std::move(on_close)),
+      wheel_(rpc_loop_now_ms(), RPC_TIMER_TICK_MS), now_ms_(rpc_loop_now_ms()) {
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epfd_ == -1 || wakeup_fd_ == -1) {
+        perror("rpc event loop create error");
+        exit(1);
+    }
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = wakeup_fd_;
+    if (epoll_ctl(epfd_, EPOLL_CTL_ADD, wakeup_fd_, &event) == -1) {
+        perror("epoll_ctl error");
+        exit(1);
+    }
+
+    thread_ = std::thread(&RpcEventLoop::Loop, this);
+    // 其它线程只会在交来连接 (加锁) 之后才比较它，不需要原子
+    thread_id_ = thread_.get_id();
+}
+
+RpcEventLoop::~RpcEventLoop() {
+    Stop();
+    close(epfd_);
+    close(wakeup_fd_);
+}
+
+void RpcEventLoop::Stop() {
+    if (!thread_.joinable()) return;
+    quit_.store(true, std::memory_order_relaxed);
+    Wakeup();
+    thread_.join();
+
+    // 停止之后才到的响应：丢弃 (arena 随 chunk 析构归还)
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    pending_sends_.clear();
+}
+
+void RpcEventLoop::Wakeup() {
+    uint64_t one = 1;
+    if (write(wakeup_fd_, &one, sizeof(one)) != sizeof(one)) {
+        perror("wakeup write error");
+    }
+}
+
+void RpcEventLoop::AddConnection(int fd) {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_fds_.push_back(fd);
+    }
+    Wakeup();
+}
+
+void RpcEventLoop::Send(const RpcConnectionPtr &conn, RpcOutputChunk &&chunk) {
+    // 本 loop 线程里直接挂到连接上，省一次唤醒
+    if (std::this_thread::get_id() == thread_id_) {
+        AppendOutput(conn, std::move(chunk));
+        return;
+    }
+
+    bool need_wakeup;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        // 队列原本非空说明已经唤醒过了，loop 会一起处理
+        need_wakeup = pending_sends_.empty();
+        pending_sends_.emplace_back(conn, std::move(chunk));
+    }
+    if (need_wakeup) {
+        Wakeup();
+    }
+}
+
+void RpcEventLoop::HandleWakeup() {
+    uint64_t count;
+    while (read(wakeup_fd_, &count, sizeof(count)) > 0); // 清空计数
+
+    std::vector<int> fds;
+    std::vector<std::pair<RpcConnectionPtr, RpcOutputChunk>> sends;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        fds.swap(pending_fds_);
+        sends.swap(pending_sends_);
+    }
+
+    for (int fd : fds) {
+        if (use_uring_) {
+            RpcConnectionPtr conn = std::make_shared<RpcConnection>(fd, this);
+            connections_[fd] = conn;
+            StartIdleTimer(conn);
+            ArmRecv(conn);
+            continue;
+        }
+
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        event.data.fd = fd;
+        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &event) == -1) {
+            perror("epoll_ctl error");
+            close(fd);
+            on_close_(nullptr);
+            continue;
+        }
+        RpcConnectionPtr conn = std::make_shared<RpcConnection>(fd, this);
+        if (zerocopy_) {
+            int one = 1;
+            conn->zerocopy = setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+        }
+        connections_[fd] = conn;
+        StartIdleTimer(conn);
+    }
+
+    // 只挂到连接上，本轮结束时每个连接一次 sendmsg 写出
+    for (auto &item : sends) {
+        AppendOutput(item.first, std::move(item.second));
+    }
+}
+
+void RpcEventLoop::AppendOutput(const RpcConnectionPtr &conn, RpcOutputChunk &&chunk) {
+    if (conn->closed) return;
+
+    conn->output_bytes += chunk.size();
+    conn->output.push_back(std::move(chunk));
+    if (!conn->dirty) {
+        conn->dirty = true;
+        dirty_.push_back(conn);
+    }
+}
+
+void RpcEventLoop::FlushDirty() {
+    std::vector<RpcConnectionPtr> dirty;
+    dirty.swap(dirty_);
+
+    for (auto &conn : dirty) {
+        conn->dirty = false;
+        if (conn->closed) continue;
+
+        if (use_uring_) {
+            // sendmsg 在途：新数据排在后面，它完成时接着发
+            if (!conn->send_inflight) {
+                StartSend(conn);
+            }
+            if (conn->output_bytes > RPC_OUTPUT_HIGH_WATER_MARK) {
+                fprintf(stderr, "[loop %d] client %d output overflow, close\n", id_, conn->fd);
+                CloseConnection(conn);
+            }
+            continue;
+        }
+
+        // 已经在等 EPOLLOUT：新数据排在后面，等可写时一起发
+        if (conn->want_write) continue;
+
+        if (!Flush(conn)) {
+            CloseConnection(conn);
+            continue;
+        }
+        if (conn->output_bytes > RPC_OUTPUT_HIGH_WATER_MARK) {
+            fprintf(stderr, "[loop %d] client %d output overflow, close\n", id_, conn->fd);
+            CloseConnection(conn);
+            continue;
+        }
+        if (!conn->output.empty()) {
+            UpdateEvents(conn, true);
+        }
+    }
+}
+
+bool RpcEventLoop::Flush(const RpcConnectionPtr &conn) {
+    // 所有排队的响应用 iovec 串起来，一次 sendmsg 写出 (sendmsg 才能带 MSG_NOSIGNAL)
+    while (!conn->output.empty()) {
+        struct iovec iov[RPC_MAX_IOV];
+        int iovcnt = 0;
+        size_t bytes = 0;
+        size_t offset = conn->output_offset;
+        for (auto it = conn->output.begin(); it != conn->output.end() && iovcnt < RPC_MAX_IOV; ++it) {
+            iov[iovcnt].iov_base = const_cast<char*>(it->data()) + offset;
+            iov[iovcnt].iov_len = it->size() - offset;
+            bytes += iov[iovcnt].iov_len;
+            iovcnt++;
+            offset = 0;
+        }
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        bool zerocopy = conn->zerocopy && bytes >= RPC_ZEROCOPY_THRESHOLD;
+        ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | (zerocopy ? MSG_ZEROCOPY : 0));
+        if (n == -1 && zerocopy && errno == ENOBUFS) {
+            // 锁定的页超过了 optmem 上限：这一次退回普通拷贝
+            zerocopy = false;
+            n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        }
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            // 内核发送缓冲区满了，剩下的等 EPOLLOUT 再发
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            perror("sendmsg error");
+            return false;
+        }
+
+        if (zerocopy) {
+            conn->zerocopy_issued++;
+        }
+        ConsumeOutput(conn, n);
+    }
+    return true;
+}
+
+void RpcEventLoop::ConsumeOutput(const RpcConnectionPtr &conn, size_t sent) {
+    // 写完的段出队 (arena 随之归还)，写了一半的记下偏移
+    conn->last_active_ms = now_ms_;
+    conn->output_bytes -= sent;
+    while (sent > 0) {
+        size_t left = conn->output.front().size() - conn->output_offset;
+        if (sent < left) {
+            conn->output_offset += sent;
+            break;
+        }
+        sent -= left;
+        if (conn->zerocopy_issued != conn->zerocopy_completed) {
+            // 还有零拷贝发送没完成，这段可能被其中某次引用：等最新那次完成再释放
+            conn->zerocopy_pending.emplace_back(conn->zerocopy_issued - 1, std::move(conn->output.front()));
+        }
+        conn->output.pop_front();
+        conn->output_offset = 0;
+    }
+}
+
+bool RpcEventLoop::ReapZerocopy(const RpcConnectionPtr &conn) {
+    // 完成通知挂在错误队列上，读到 EAGAIN 为止 (ET)
+    while (true) {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(conn->fd, &msg, MSG_ERRQUEUE) == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            perror("recvmsg errqueue error");
+            return false;
+        }
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            bool recverr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                           (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+            if (!recverr) continue;
+
+            struct sock_extended_err *err = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+            if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                return false;
+            }
+            // 编号 [ee_info, ee_data] 的发送完成了；前面还有没完成的就先记下，
+            // 从 zerocopy_completed 开始连续完成的区间才推进水位 (编号会回绕，按差值比较)
+            std::vector<std::pair<uint32_t, uint32_t>> &early = conn->zerocopy_early;
+            early.emplace_back(err->ee_info, err->ee_data);
+            for (size_t i = 0; i < early.size(); ) {
+                if ((int32_t)(early[i].first - conn->zerocopy_completed) > 0) {
+                    i++;
+                    continue;
+                }
+                if ((int32_t)(early[i].second + 1 - conn->zerocopy_completed) > 0) {
+                    conn->zerocopy_completed = early[i].second + 1;
+                }
+                early[i] = early.back();
+                early.pop_back();
+                i = 0;  // 水位变了，前面跳过的区间可能也连上了
+            }
+            // 最后引用它的发送已经完成的响应，内核不会再读
+            while (!conn->zerocopy_pending.empty() &&
+                   (int32_t)(conn->zerocopy_pending.front().first - conn->zerocopy_completed) < 0) {
+                conn->zerocopy_pending.pop_front();
+            }
+            // 内核退回了拷贝 (例如回环网卡)：零拷贝白白多了通知的开销，这个连接不再用
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                conn->zerocopy = false;
+            }
+        }
+    }
+
+    // 错误队列读空了，再看是不是真有 socket 错误
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &len) == -1 || error != 0) {
+        return false;
+    }
+    return true;
+}
+
+void RpcEventLoop::UpdateEvents(const RpcConnectionPtr &conn, bool want_write) {
+    epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    if (want_write) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.fd = conn->fd;
+
+    if (epoll_ctl(epfd_, EPOLL_CTL_MOD, conn->fd, &event) == -1) {
+        perror("epoll_ctl mod error");
+    }
+    conn->want_write = want_write;
+}
+
+void RpcEventLoop::CloseConnection(const RpcConnectionPtr &conn) {
+    if (conn->closed) return;
+    conn->closed = true;
+    wheel_.cancel(&conn->timer);
+
+    // conn 可能就是表里那一份引用，先拷贝一份再 erase
+    RpcConnectionPtr keep = conn;
+    if (use_uring_) {
+        // 在途的 recv / sendmsg 持有文件引用，close 不会让它们结束；shutdown 让它们立即完成
+        shutdown(conn->fd, SHUT_RDWR);
+        close(conn->fd);
+        connections_.erase(conn->fd);
+        // 在途的 sendmsg 还引用着 output，等它完成时再清空
+        closing_[conn.get()] = keep;
+        ReleaseIfIdle(keep);
+        on_close_(keep);
+        return;
+    }
+
+    connections_.erase(conn->fd);
+    conn->output_bytes = 0;
+    if (conn->zerocopy_issued != conn->zerocopy_completed) {
+        // 内核可能还在发零拷贝引用的 arena 页，现在归还会让别的调用改写正在发的数据；
+        // close 之后又读不到完成通知，所以 fd 先留着 (只发 FIN)，没发的响应也一起等通知到齐
+        for (auto &chunk : conn->output) {
+            conn->zerocopy_pending.emplace_back(conn->zerocopy_issued - 1, std::move(chunk));
+        }
+        conn->output.clear();
+        shutdown(conn->fd, SHUT_RDWR);
+        UpdateEvents(conn, false);
+        wheel_.arm(&conn->timer, rpc_loop_now_ms() + RPC_ZEROCOPY_LINGER_MS);
+        lingering_[conn->fd] = keep;
+        on_close_(keep);
+        return;
+    }
+
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->output.clear();
+    conn->zerocopy_pending.clear();
+    on_close_(keep);
+}
+
+void RpcEventLoop::HandleLinger(const RpcConnectionPtr &conn) {
+    // 读出错 (比如被 RST) 时发送队列已经被内核清掉，直接关
+    bool ok = ReapZerocopy(conn);
+    if (!ok || conn->zerocopy_issued == conn->zerocopy_completed) {
+        FinishClose(conn, !ok);
+    }
+}
+
+void RpcEventLoop::FinishClose(const RpcConnectionPtr &conn, bool abort) {
+    if (abort) {
+        // SO_LINGER 0：close 发 RST 并丢掉发送队列，内核不再读这些页
+        struct linger lg;
+        lg.l_onoff = 1;
+        lg.l_linger = 0;
+        setsockopt(conn->fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    }
+    wheel_.cancel(&conn->timer);
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->zerocopy_pending.clear();
+    lingering_.erase(conn->fd);
+}
+
+void RpcEventLoop::StartIdleTimer(const RpcConnectionPtr &conn) {
+    conn->last_active_ms = now_ms_;
+    conn->timer.data = conn.get();
+    if (idle_timeout_ms_ > 0) {
+        wheel_.arm(&conn->timer, now_ms_ + idle_timeout_ms_);
+    }
+}
+
+int RpcEventLoop::NextTimeout() {
+    return wheel_.next_timeout_ms(rpc_loop_now_ms());
+}
+
+void RpcEventLoop::AdvanceTimers() {
+    wheel_.advance(now_ms_, [this](TimerNode *node) {
+        RpcConnection *raw = static_cast<RpcConnection*>(node->data);
+        // 已关闭的连接：等零拷贝完成通知超时了
+        if (raw->closed) {
+            RpcConnectionPtr conn = lingering_.at(raw->fd);
+            fprintf(stderr, "[loop %d] client %d zerocopy completions timed out, reset\n", id_, conn->fd);
+            FinishClose(conn, true);
+            return;
+        }
+        // 期间有过收发：按最后活跃时间顺延
+        if (now_ms_ - raw->last_active_ms < idle_timeout_ms_) {
+            wheel_.arm(node, raw->last_active_ms + idle_timeout_ms_);
+            return;
+        }
+        RpcConnectionPtr conn = connections_.at(raw->fd);
+        fprintf(stderr, "[loop %d] client %d idle timeout, close\n", id_, conn->fd);
+        CloseConnection(conn);
+    });
+}
+
+bool RpcEventLoop::DecodeFrom(const RpcConnectionPtr &conn, const char *data, size_t len, size_t *consumed, size_t *need) {
+    RpcRequestFrame frame;
+    DecodeStatus status;
+    *consumed = 0;
+    while ((status = DecodeRequestFrame(data + *consumed, len - *consumed, &frame, need)) == DecodeStatus::FRAME) {
+        on_frame_(conn, frame);
+        *consumed += frame.frame_len;
+        if (conn->closed) return false;
+    }
+
+    if (status == DecodeStatus::BAD_FRAME) {
+        fprintf(stderr, "[loop %d] client %d bad frame, close\n", id_, conn->fd);
+        return false;
+    }
+    return true;
+}
+
+bool RpcEventLoop::DecodeFrames(const RpcConnectionPtr &conn) {
+    RpcBuffer &input = conn->input;
+    size_t consumed = 0;
+    size_t need = 0;
+    bool ok = DecodeFrom(conn, input.Peek(), input.ReadableBytes(), &consumed, &need);
+    if (!ok) return false;
+    input.Retrieve(consumed);
+
+    // 整帧长度已知时一次准备好空间，大包只扩容一次
+    input.EnsureWritable(need);
+    return true;
+}
+
+void RpcEventLoop::HandleRead(const RpcConnectionPtr &conn) {
+    // ET 模式：读到 EAGAIN 为止，每读一次就解一次帧，缓冲区不会无限增长
+    while (true) {
+        ssize_t n = conn->input.ReadFd(conn->fd);
+        if (n > 0) {
+            conn->last_active_ms = now_ms_;
+            if (!DecodeFrames(conn)) {
+                CloseConnection(conn);
+                return;
+            }
+            continue;
+        }
+
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n == -1) {
+            perror("recv error");
+        }
+        CloseConnection(conn);
+        return;
+    }
+}
+
+void RpcEventLoop::Loop() {
+    if (use_uring_) {
+        LoopUring();
+        return;
+    }
+
+    epoll_event events[RPC_MAX_EVENTS];
+    while (!quit_.load(std::memory_order_relaxed)) {
+        // 睡到时间轮上最近的截止时间 (空闲超时 / 零拷贝等待)，没有定时器就一直等
+        int n = epoll_wait(epfd_, events, RPC_MAX_EVENTS, NextTimeout());
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait error");
+            break;
+        }
+        now_ms_ = rpc_loop_now_ms();
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            uint32_t revents = events[i].events;
+
+            if (fd == wakeup_fd_) {
+                HandleWakeup();
+                continue;
+            }
+
+            auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                auto lingering = lingering_.find(fd);
+                if (lingering != lingering_.end()) {
+                    RpcConnectionPtr conn = lingering->second;
+                    HandleLinger(conn);
+                }
+                continue; // 同一批事件里已经关闭
+            }
+            RpcConnectionPtr conn = it->second;
+
+            // 零拷贝的完成通知也以 EPOLLERR 报告，读完通知后仍有错误才关闭
+            if ((revents & EPOLLERR) && conn->zerocopy_issued != 0) {
+                if (!ReapZerocopy(conn)) {
+                    CloseConnection(conn);
+                    continue;
+                }
+                revents &= ~EPOLLERR;
+            }
+
+            if (revents & (EPOLLERR | EPOLLHUP)) {
+                CloseConnection(conn);
+                continue;
+            }
+
+            if (revents & EPOLLOUT) {
+                if (!Flush(conn)) {
+                    CloseConnection(conn);
+                    continue;
+                }
+                if (conn->output.empty()) {
+                    UpdateEvents(conn, false);
+                }
+            }
+
+            if (revents & (EPOLLIN | EPOLLRDHUP)) {
+                HandleRead(conn);
+            }
+        }
+
+        // 本轮产生的响应 (本线程的错误帧、worker 交回的响应) 每个连接合并写一次
+        FlushDirty();
+        AdvanceTimers();
+    }
+
+    // 退出前关闭还没断开的连接 (排空超时的那些)
+    std::vector<RpcConnectionPtr> rest;
+    for (auto &item : connections_) {
+        rest.push_back(item.second);
+    }
+    for (auto &conn : rest) {
+        CloseConnection(conn);
+    }
+    // 还在等零拷贝通知的：loop 要退出了，RST 掉，之后 arena 才能归还
+    rest.clear();
+    for (auto &item : lingering_) {
+        rest.push_back(item.second);
+    }
+    for (auto &conn : rest) {
+        FinishClose(conn, true);
+    }
+}
@@ -0,0 +1,225 @@
+#include "rpc_event_loop.h"
+#include "../../common/io_uring.h"
+#include <cstdio>
+#include <cstring>
+
+/**
+ * RpcEventLoop 的 io_uring 版本 (use_uring)，对外接口、连接管理和帧解码与 epoll 版本共用
+ *
+ *  - 唤醒：对 eventfd 挂一个 read 请求，完成时处理交来的连接 / 响应，再挂下一个
+ *  - 读：每个连接一个多次 recv，内核从缓冲区池里挑缓冲区；输入缓冲区为空时直接在内核给的缓冲区上解帧，
+ *    只有不完整的尾巴才拷进 conn->input，缓冲区当轮还回去
+ *  - 写：每个连接同时只有一个 sendmsg 在途，把排队的响应用 iovec 串起来；完成后还有数据就接着发
+ *  - 一轮完成事件处理中产生的所有请求，跟下一次等待一起在一次 io_uring_enter 里提交
+ *
+ * user_data = 连接指针 | 操作类型 (指针至少 8 字节对齐，低 3 位空闲)；唤醒请求的指针部分为 0
+ */
+enum RpcUringOp : uint64_t { RPC_URING_WAKEUP = 1, RPC_URING_RECV = 2, RPC_URING_SEND = 3 };
+const uint64_t RPC_URING_OP_MASK = 7;
+
+static uint64_t uring_tag(RpcConnection *conn, RpcUringOp op) {
+    return reinterpret_cast<uint64_t>(conn) | op;
+}
+
+static struct io_uring_sqe *uring_get_sqe(IoUring *ring) {
+    struct io_uring_sqe *sqe = ring->GetSqe();
+    if (sqe == nullptr) {
+        // GetSqe 已经提交过一次还是满的：内核处理不过来，没有恢复的余地
+        fprintf(stderr, "io_uring submission queue full\n");
+        exit(1);
+    }
+    return sqe;
+}
+
+void RpcEventLoop::ArmWakeup() {
+    uring_prep_read(uring_get_sqe(ring_), wakeup_fd_, &wakeup_value_, sizeof(wakeup_value_), RPC_URING_WAKEUP);
+}
+
+void RpcEventLoop::ArmRecv(const RpcConnectionPtr &conn) {
+    uring_prep_multishot_recv(uring_get_sqe(ring_), conn->fd, buffers_->group(), uring_tag(conn.get(), RPC_URING_RECV));
+    conn->recv_armed = true;
+}
+
+void RpcEventLoop::StartSend(const RpcConnectionPtr &conn) {
+    if (conn->output.empty()) return;
+
+    // 排队的响应一次 sendmsg 写出；iovec 和 msghdr 放在连接上，请求完成之前保持有效
+    conn->send_iov.clear();
+    size_t offset = conn->output_offset;
+    for (auto it = conn->output.begin(); it != conn->output.end() && (int)conn->send_iov.size() < RPC_MAX_IOV; ++it) {
+        struct iovec iov;
+        iov.iov_base = const_cast<char*>(it->data()) + offset;
+        iov.iov_len = it->size() - offset;
+        conn->send_iov.push_back(iov);
+        offset = 0;
+    }
+
+    memset(&conn->send_msg, 0, sizeof(conn->send_msg));
+    conn->send_msg.msg_iov = conn->send_iov.data();
+    conn->send_msg.msg_iovlen = conn->send_iov.size();
+    uring_prep_sendmsg(uring_get_sqe(ring_), conn->fd, &conn->send_msg, uring_tag(conn.get(), RPC_URING_SEND));
+    conn->send_inflight = true;
+}
+
+void RpcEventLoop::ReleaseIfIdle(const RpcConnectionPtr &conn) {
+    if (!conn->closed || conn->recv_armed || conn->send_inflight) return;
+    // 内核不再引用连接了：响应可以丢弃 (arena 归还)，连接随最后一份引用释放
+    conn->output.clear();
+    conn->output_bytes = 0;
+    closing_.erase(conn.get());
+}
+
+void RpcEventLoop::HandleRecvCompletion(const RpcConnectionPtr &conn, const struct io_uring_cqe &cqe) {
+    int res = cqe.res;
+    unsigned flags = cqe.flags;
+    // 没有 F_MORE：多次 recv 结束了 (对端关闭、出错、缓冲区用完)
+    if (!(flags & IORING_CQE_F_MORE)) {
+        conn->recv_armed = false;
+    }
+
+    if (res > 0 && (flags & IORING_CQE_F_BUFFER)) {
+        conn->last_active_ms = now_ms_;
+        unsigned bid = IoUringBufferRing::BufferId(cqe);
+        const char *data = buffers_->buffer(bid);
+        size_t len = res;
+
+        if (!conn->closed) {
+            bool ok;
+            if (conn->input.ReadableBytes() == 0) {
+                // 没有上次剩下的半帧：直接在内核给的缓冲区上解帧，只拷贝不完整的尾巴
+                size_t consumed = 0;
+                size_t need = 0;
+                ok = DecodeFrom(conn, data, len, &consumed, &need);
+                if (ok && consumed < len) {
+                    conn->input.Append(data + consumed, len - consumed);
+                    conn->input.EnsureWritable(need);
+                }
+            }
+            else {
+                conn->input.Append(data, len);
+                ok = DecodeFrames(conn);
+            }
+            if (!ok) {
+                CloseConnection(conn);
+            }
+        }
+        buffers_->Recycle(bid);
+
+        // 多次 recv 意外结束 (例如 CQ 溢出)：等本轮的缓冲区发布之后重新挂上
+        if (!conn->closed && !conn->recv_armed) {
+            starved_.push_back(conn);
+        }
+    }
+    else if (res == -ENOBUFS) {
+        if (!conn->closed && !conn->recv_armed) {
+            starved_.push_back(conn);
+        }
+    }
+    else if (!conn->closed) {
+        if (res < 0) {
+            fprintf(stderr, "[loop %d] client %d recv error: %s\n", id_, conn->fd, strerror(-res));
+        }
+        CloseConnection(conn);
+    }
+    ReleaseIfIdle(conn);
+}
+
+void RpcEventLoop::HandleSendCompletion(const RpcConnectionPtr &conn, int res) {
+    conn->send_inflight = false;
+    if (conn->closed) {
+        ReleaseIfIdle(conn);
+        return;
+    }
+    if (res < 0) {
+        fprintf(stderr, "[loop %d] client %d sendmsg error: %s\n", id_, conn->fd, strerror(-res));
+        CloseConnection(conn);
+        return;
+    }
+
+    ConsumeOutput(conn, res);
+    // 发送期间又排进来的响应 (或者这次没写完的部分) 接着发
+    StartSend(conn);
+}
+
+void RpcEventLoop::LoopUring() {
+    std::unique_ptr<IoUring> ring(new IoUring(RPC_URING_ENTRIES));
+    std::unique_ptr<IoUringBufferRing> buffers(
+        new IoUringBufferRing(*ring, 0, RPC_URING_BUFFER_COUNT, RPC_URING_BUFFER_SIZE));
+    ring_ = ring.get();
+    buffers_ = buffers.get();
+
+    ArmWakeup();
+    while (!quit_.load(std::memory_order_relaxed)) {
+        // 提交上一轮攒下的请求，等到下一批完成事件或者时间轮上最近的截止时间
+        if (ring_->Submit(1, NextTimeout()) < 0) {
+            perror("io_uring_enter error");
+            break;
+        }
+        now_ms_ = rpc_loop_now_ms();
+
+        ring_->ForEachCqe([this](const struct io_uring_cqe &cqe) {
+            RpcUringOp op = static_cast<RpcUringOp>(cqe.user_data & RPC_URING_OP_MASK);
+            RpcConnection *raw = reinterpret_cast<RpcConnection*>(cqe.user_data & ~RPC_URING_OP_MASK);
+
+            switch (op) {
+            case RPC_URING_WAKEUP:
+                HandleWakeup();
+                if (!quit_.load(std::memory_order_relaxed)) {
+                    ArmWakeup();
+                }
+                break;
+
+            case RPC_URING_RECV:
+            case RPC_URING_SEND: {
+                // 连接要么还在表里，要么在 closing_ 里等在途请求完成
+                auto it = closing_.find(raw);
+                RpcConnectionPtr conn;
+                if (it != closing_.end()) {
+                    conn = it->second;
+                }
+                else {
+                    conn = connections_.at(raw->fd);
+                }
+                if (op == RPC_URING_RECV) {
+                    HandleRecvCompletion(conn, cqe);
+                }
+                else {
+                    HandleSendCompletion(conn, cqe.res);
+                }
+                break;
+            }
+
+            default:
+                break;  // user_data == 0：缓冲区池内部的请求
+            }
+        });
+
+        // 本轮产生的响应每个连接一个 sendmsg；还回来的缓冲区一次发布，再给停掉 recv 的连接重新挂上
+        FlushDirty();
+        buffers_->Publish();
+        std::vector<RpcConnectionPtr> starved;
+        starved.swap(starved_);
+        for (auto &conn : starved) {
+            if (!conn->closed && !conn->recv_armed) {
+                ArmRecv(conn);
+            }
+        }
+        AdvanceTimers();
+    }
+
+    // 退出前关闭还没断开的连接 (排空超时的那些)
+    std::vector<RpcConnectionPtr> rest;
+    for (auto &item : connections_) {
+        rest.push_back(item.second);
+    }
+    for (auto &conn : rest) {
+        CloseConnection(conn);
+    }
+
+    // 关闭 ring 会取消所有在途请求，之后才能释放它们引用的连接和响应
+    buffers_ = nullptr;
+    ring_ = nullptr;
+    buffers.reset();
+    ring.reset();
+    closing_.clear();
+}
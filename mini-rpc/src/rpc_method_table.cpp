@@ -0,0 +1,83 @@
+#include "rpc_method_table.h"
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/service.h>
+#include <cstring>
+
+uint64_t RpcMethodTable::Hash(const char *service, size_t service_len, const char *method, size_t method_len) {
+    // FNV-1a，服务名和方法名之间加一个分隔字节，避免 "ab"+"c" 与 "a"+"bc" 相同
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < service_len; i++) {
+        h = (h ^ (unsigned char)service[i]) * 1099511628211ULL;
+    }
+    h = (h ^ '.') * 1099511628211ULL;
+    for (size_t i = 0; i < method_len; i++) {
+        h = (h ^ (unsigned char)method[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+void RpcMethodTable::Add(google::protobuf::Service *service) {
+    const google::protobuf::ServiceDescriptor *sd = service->GetDescriptor();
+    const std::string &service_name = sd->name();
+
+    for (int i = 0; i < sd->method_count(); ++i) {
+        const google::protobuf::MethodDescriptor *md = sd->method(i);
+        const std::string &method_name = md->name();
+
+        RpcMethod entry;
+        entry.service_name = service_name;
+        entry.method_name = method_name;
+        entry.hash = Hash(service_name.data(), service_name.size(), method_name.data(), method_name.size());
+        entry.service = service;
+        entry.md = md;
+        entry.request_prototype = &service->GetRequestPrototype(md);
+        entry.response_prototype = &service->GetResponsePrototype(md);
+
+        // 重复注册：覆盖原来的条目
+        RpcMethod *existing = const_cast<RpcMethod*>(
+            Find(service_name.data(), service_name.size(), method_name.data(), method_name.size()));
+        if (existing != nullptr) {
+            *existing = entry;
+        }
+        else {
+            methods_.push_back(entry);
+        }
+    }
+
+    Rebuild();
+}
+
+void RpcMethodTable::Rebuild() {
+    size_t capacity = RPC_METHOD_TABLE_MIN_SLOTS;
+    while (capacity < methods_.size() * 2) {
+        capacity *= 2;
+    }
+
+    slots_.assign(capacity, -1);
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < methods_.size(); i++) {
+        size_t pos = methods_[i].hash & mask;
+        while (slots_[pos] != -1) {
+            pos = (pos + 1) & mask;
+        }
+        slots_[pos] = (int32_t)i;
+    }
+}
+
+const RpcMethod *RpcMethodTable::Find(const char *service, size_t service_len, const char *method, size_t method_len) const {
+    if (slots_.empty()) return nullptr;
+
+    uint64_t h = Hash(service, service_len, method, method_len);
+    size_t mask = slots_.size() - 1;
+    for (size_t pos = h & mask; slots_[pos] != -1; pos = (pos + 1) & mask) {
+        const RpcMethod &entry = methods_[slots_[pos]];
+        if (entry.hash == h
+            && entry.service_name.size() == service_len
+            && entry.method_name.size() == method_len
+            && memcmp(entry.service_name.data(), service, service_len) == 0
+            && memcmp(entry.method_name.data(), method, method_len) == 0) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
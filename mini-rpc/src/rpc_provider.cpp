@@ -1,152 +1,201 @@
 #include "rpc_provider.h"
+#include "rpc_codec.h"
 #include "user.pb.h" // 引入生成的头文件
 #include <iostream>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstring>
+#include <cerrno>
+#include <chrono>
 #include <thread>
+#include <vector>
 
 // 简单的日志宏
 #define LOG_INFO(fmt, ...) printf("[INFO] " fmt "\n", ##__VA_ARGS__)
 
-void RpcProvider::Run() {
-    // 1. 创建 socket
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) {
-        perror("socket create failed");
-        exit(EXIT_FAILURE);
+void RpcProvider::Run(const ListenOptions &opts, const RpcServerOptions &server_opts) {
+    // 排空通知要在创建任何线程之前建立
+    graceful_init(opts.drain_timeout_ms);
+
+    // 1~3. 创建 socket、绑定地址 (端口 8888)、监听
+    std::vector<int> listen_fds = create_listen_sockets(8888, 5, opts);
+
+    // 4. I/O 事件循环和 worker 线程池
+    // 慢的 CallMethod 只占用一个 worker，不会挡住其它连接的收发
+    workers_.reset(new ThreadPool(server_opts.worker_threads));
+    backend_.reset(new ThreadPool(RPC_BACKEND_THREADS));
+    RpcEventLoopOptions loop_opts;
+    loop_opts.use_uring = server_opts.use_uring;
+    loop_opts.zerocopy = server_opts.zerocopy;
+    loop_opts.idle_timeout_ms = opts.idle_timeout_ms;
+    for (int i = 0; i < server_opts.io_threads; i++) {
+        loops_.emplace_back(new RpcEventLoop(i,
+            [this](const RpcConnectionPtr &conn, const RpcRequestFrame &frame) { OnMessage(conn, frame); },
+            [this](const RpcConnectionPtr &) {
+                LOG_INFO("Client disconnected");
+                connection_count_.fetch_sub(1, std::memory_order_relaxed);
+            },
+            loop_opts));
     }
 
-    // 2. 绑定地址
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY; // 监听所有网卡
-    server_addr.sin_port = htons(8888);       // 端口 8888
+    LOG_INFO("RPC Server started on port 8888 (io threads: %d, worker threads: %d, %s%s) ...",
+             server_opts.io_threads, server_opts.worker_threads, server_opts.use_uring ? "io_uring" : "epoll",
+             server_opts.zerocopy && !server_opts.use_uring ? ", zerocopy" : "");
 
-    if (bind(server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("bind failed");
-        exit(EXIT_FAILURE);
+    if (listen_fds.size() == 1) {
+        AcceptLoop(listen_fds[0]);
+        Drain();
+        return;
     }
 
-    // 3. 监听
-    if (listen(server_fd, 5) < 0) {
-        perror("listen failed");
-        exit(EXIT_FAILURE);
+    // 分片模式：每个 SO_REUSEPORT 监听 socket 一个 accept 线程
+    // method_table_ 在 Run 之前已注册完毕，之后只读，多线程查找无需加锁
+    LOG_INFO("listen shards: %d", (int)listen_fds.size());
+    std::vector<std::thread> acceptors;
+    for (size_t i = 0; i < listen_fds.size(); i++) {
+        int server_fd = listen_fds[i];
+        bool steering = opts.cpu_steering;
+        acceptors.emplace_back([this, server_fd, steering, i]() {
+            if (steering) {
+                bind_to_cpu(i);
+            }
+            AcceptLoop(server_fd);
+        });
     }
 
-    LOG_INFO("RPC Server started on port 8888 ...");
+    for (auto &t : acceptors) {
+        t.join();
+    }
+    Drain();
+}
 
-    // 4. 接受连接 (简化版：单线程，一个接一个处理)
+void RpcProvider::AcceptLoop(int server_fd) {
+    // 5. 接受连接，轮询交给各个事件循环
     while (true) {
+        // 监听 socket 是非阻塞的，先等待可读；开始排空时不再接受新连接
+        if (!wait_accept(server_fd)) {
+            break;
+        }
+
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
-        int connfd = accept(server_fd, (struct sockaddr*)&client_addr, &client_len);
+        int connfd = accept4(server_fd, (struct sockaddr*)&client_addr, &client_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
         
         if (connfd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) continue;
             perror("accept failed");
             continue;
         }
 
         LOG_INFO("New client connected!");
-        
-        // 处理请求 (实际项目中会放到线程池，这里为了简单直接处理)
-        OnMessage(connfd);
-        
-        close(connfd);
+
+        // 响应是小包，同一连接在不同轮次写出的响应不能被 Nagle 压住等上一个的 ACK
+        int opt = 1;
+        setsockopt(connfd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+        connection_count_.fetch_add(1, std::memory_order_relaxed);
+        unsigned idx = next_loop_.fetch_add(1, std::memory_order_relaxed) % loops_.size();
+        loops_[idx]->AddConnection(connfd);
     }
 }
 
-// ... 其他 include ...
-
-// 【新增】实现 SendResponse 函数
-void RpcProvider::SendResponse(int connfd, google::protobuf::Message* response) {
-    std::string resp_str;
-    if (response->SerializeToString(&resp_str)) {
-        // 发送响应：[长度][数据]
-        uint32_t len = resp_str.size();
-        // 注意：实际生产环境需要 htonl(len) 处理网络字节序
-        send(connfd, (char*)&len, sizeof(len), 0);
-        send(connfd, resp_str.c_str(), len, 0);
-        
+void RpcProvider::Drain() {
+    // 已有连接继续由事件循环服务，等客户端断开或者到截止时间
+    while (connection_count_.load(std::memory_order_relaxed) > 0 && drain_remaining_ms() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(RPC_DRAIN_POLL_MS));
+    }
+    // 已经派发出去的调用尽量完成：done 可能在 worker 之外延后调用，所以看 pending_calls_ 而不是线程池是否空闲
+    while (pending_calls_.load(std::memory_order_acquire) > 0 && drain_remaining_ms() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(RPC_DRAIN_POLL_MS));
+    }
+    LOG_INFO("RPC Server drained, %d connections left, %d calls pending",
+             connection_count_.load(), pending_calls_.load());
+
+    // 先停 I/O 线程 (不再派发新调用)，再停 worker，最后停 worker 投递任务的 backend；
+    // 迟到的响应只会进 loop 的队列后被丢弃，线程都 join 之后才没有人再碰 provider
+    for (auto &loop : loops_) {
+        loop->Stop();
+    }
+    workers_.reset();
+    backend_.reset();
+}
+
+// 实现 SendResponse 函数 (done 回调：worker 线程或业务自己的线程)
+void RpcProvider::SendResponse(RpcCall *call) {
+    // 响应直接序列化到本次调用的 arena 上，最前面预留帧头；arena 随这段数据交给 loop，写出后才归还
+    size_t len = call->response->ByteSizeLong();
+    char *frame = google::protobuf::Arena::CreateArray<char>(&call->arena->arena, RPC_RESPONSE_HEADER_SIZE + len);
+    if (call->response->SerializeToArray(frame + RPC_RESPONSE_HEADER_SIZE, len)) {
+        // 发送响应：[请求ID][状态码][长度][数据]
+        EncodeResponseHeader(frame, call->request_id, RPC_OK, len); // 网络字节序
+        call->conn->loop->Send(call->conn, RpcOutputChunk(call->arena, frame, RPC_RESPONSE_HEADER_SIZE + len));
+
         char buf[100];
-        snprintf(buf, sizeof(buf), "Response sent (size: %d)", len);
+        snprintf(buf, sizeof(buf), "Response sent (id: %u, size: %u)", call->request_id, (uint32_t)len);
         LOG_INFO("%s", buf);
     } else {
         LOG_INFO("Failed to serialize response");
+        SendError(call->conn, call->request_id, RPC_INTERNAL_ERROR);
+        RpcArenaPool::Release(call->arena);
     }
-    
-    // 释放内存
-    delete response;
+
+    // 调用到此结束：request / response 不会再被业务使用，它们所在的 arena 已经交出去或者归还了
+    delete call;
+    pending_calls_.fetch_sub(1, std::memory_order_release);
 }
 
-void RpcProvider::OnMessage(int connfd) {
-    // ... (前面的解析代码保持不变) ...
-    
-    // 1. 读取网络数据 (略)
-    char buffer[4096] = {0}; // 增大缓冲区以防万一
-    int n = recv(connfd, buffer, sizeof(buffer), 0);
-    if (n <= 0) return;
-
-    // 2. 解析协议 (略，保持你之前的代码)
-    // 假设你已经解析出了 service_name, method_name, req_data_str
-    // 为了演示，我这里简化写一下解析逻辑，请替换为你之前完整的解析代码
-    uint32_t service_name_len = 0;
-    memcpy(&service_name_len, buffer, sizeof(uint32_t));
-    std::string service_name(buffer + sizeof(uint32_t), service_name_len);
-    
-    uint32_t method_name_len = 0;
-    size_t offset = sizeof(uint32_t) + service_name_len;
-    memcpy(&method_name_len, buffer + offset, sizeof(uint32_t));
-    std::string method_name(buffer + offset + sizeof(uint32_t), method_name_len);
-    
-    uint32_t req_data_len = 0;
-    offset += sizeof(uint32_t) + method_name_len;
-    memcpy(&req_data_len, buffer + offset, sizeof(uint32_t));
-    std::string req_data_str(buffer + offset + sizeof(uint32_t), req_data_len);
-
-    LOG_INFO("Recv request: Service=%s, Method=%s", service_name.c_str(), method_name.c_str());
-
-    // 3. 查找服务 (略，保持原样)
-    if (service_map_.find(service_name) == service_map_.end()) return;
-    auto& method_map = service_map_[service_name];
-    if (method_map.find(method_name) == method_map.end()) return;
-
-    google::protobuf::Service* service = method_map[method_name];
-    const google::protobuf::ServiceDescriptor* sd = service->GetDescriptor();
-    const google::protobuf::MethodDescriptor* md = sd->FindMethodByName(method_name);
-
-    // 4. 创建对象 (略，保持原样)
-    google::protobuf::Message* request = service->GetRequestPrototype(md).New();
-    google::protobuf::Message* response = service->GetResponsePrototype(md).New();
-
-    if (!request->ParseFromString(req_data_str)) {
+void RpcProvider::SendError(const RpcConnectionPtr &conn, uint32_t request_id, uint32_t status) {
+    // 流水线上的客户端在等这个请求ID，出错也要回一帧
+    std::string header(RPC_RESPONSE_HEADER_SIZE, '\0');
+    EncodeResponseHeader(&header[0], request_id, status, 0);
+    conn->loop->Send(conn, RpcOutputChunk(std::move(header)));
+}
+
+void RpcProvider::OnMessage(const RpcConnectionPtr &conn, const RpcRequestFrame &frame) {
+    // 1. 解析协议：帧里的字段直接指向输入缓冲区
+    LOG_INFO("Recv request: Id=%u, Service=%.*s, Method=%.*s", frame.request_id,
+             (int)frame.service_len, frame.service, (int)frame.method_len, frame.method);
+
+    // 2. 查找方法：一次哈希查表，不构造临时字符串 (注册完后只读，I/O 线程并发查找无需加锁)
+    const RpcMethod *method = method_table_.Find(frame.service, frame.service_len, frame.method, frame.method_len);
+    if (method == nullptr) {
+        SendError(conn, frame.request_id, RPC_NO_SUCH_METHOD);
+        return;
+    }
+
+    google::protobuf::Service* service = method->service;
+    const google::protobuf::MethodDescriptor* md = method->md;
+
+    // 3. 创建对象：都分配在本次调用的 arena 上 (线程本地池取出，一般不需要 malloc)
+    RpcArena *arena = RpcArenaPool::Acquire();
+    google::protobuf::Message* request = method->request_prototype->New(&arena->arena);
+    google::protobuf::Message* response = method->response_prototype->New(&arena->arena);
+
+    // 直接从输入缓冲区解析，不再拷贝一份请求数据
+    // 必须在 I/O 线程里完成：回调返回后这段缓冲区就会被 Retrieve
+    if (!request->ParseFromArray(frame.data, frame.data_len)) {
         LOG_INFO("Parse failed");
-        delete request;
-        delete response;
+        RpcArenaPool::Release(arena);
+        SendError(conn, frame.request_id, RPC_BAD_REQUEST);
         return;
     }
 
-    // 【修改点】这里不再使用 lambda，而是使用 NewCallback 绑定成员函数
-    // 语法：NewCallback(对象指针, &成员函数, 参数1, 参数2, ...)
+    // done 回调带上连接和请求ID，响应才能回到对应的请求
+    RpcCall *call = new RpcCall{conn, frame.request_id, arena, request, response};
     google::protobuf::Closure* done = google::protobuf::NewCallback(
-        this,               // 对象指针 (this)
+        this,                       // 对象指针 (this)
         &RpcProvider::SendResponse, // 成员函数指针
-        connfd,             // 传递给 SendResponse 的参数 1
-        response            // 传递给 SendResponse 的参数 2
+        call                        // 传递给 SendResponse 的参数
     );
-
-    // 5. 调用业务逻辑
-    service->CallMethod(md, nullptr, request, response, done);
-
-    // 注意：request 在这里可以删除了，因为 CallMethod 是同步拷贝或者已经使用完毕
-    // 但在某些异步实现中可能需要保留，这里简单起见，我们在 CallMethod 返回后删除 request
-    // 实际上 Protobuf 的 CallMethod 通常是同步执行用户逻辑，然后异步执行 done
-    // 为了安全，我们让 done 回调里或者 CallMethod 之后处理 request 的生命周期
-    // 简单做法：在 CallMethod 之后立即删除 request (因为数据已经拷贝到内部或者处理完了)
-    delete request; 
-    
-    // response 会在 SendResponse 中被删除
-}
\ No newline at end of file
+    pending_calls_.fetch_add(1, std::memory_order_relaxed);
+
+    // 4. 业务逻辑交给 worker 线程池，I/O 线程继续处理下一帧
+    // CallMethod 返回不代表调用结束：业务可以保存 done 稍后在别的线程调用，
+    // request / response 所在的 arena 由 call 持有，直到 done 运行时才归还
+    workers_->submit([service, md, request, response, done]() {
+        service->CallMethod(md, nullptr, request, response, done);
+    });
+}
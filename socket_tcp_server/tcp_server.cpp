@@ -4,67 +4,57 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <cstring>
+#include <cerrno>
 #include <unistd.h>
+#include <sys/wait.h>
+#include <vector>
 
-const int PORT = 8080;
-const int BUFFER_SIZE = 1024;
-
-void tcp_server() {
-    // 1. 创建socket
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd == -1) {
-        perror("failed create socket.");
-        exit(1);
-    }
-
-    // 2. 设置地址复用，避免端口占用
-    int opt = 1;
-    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+#include "../common/listen_socket.h"
+#include "../common/buffer_pool.h"
 
-    // 3. 绑定
-    struct sockaddr_in address;
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY; // 监听所有网卡请求
-    address.sin_port = htons(PORT); // 设置监听端口 TODO: 必须转换数据类型
-
-    if (bind(sockfd, (struct sockaddr*)&address, sizeof(address)) == -1) {
-        perror("bind error");
-        close(sockfd);
-        exit(1);
-    }
-
-    // 4. listen 监听
-    if (listen(sockfd, 3) == -1) { // listen 第二个参数的含义是当连接数小于设置值时会进入等待队列，若超过该值，则直接拒绝服务请求
-        perror("listen error");
-        close(sockfd);
-        exit(1);
-    }
+// 用法: ./tcp_server [-s 分片数] [-c] [-u 交接路径] [-d 排空秒数] [-I 空闲秒数]
+//   SIGTERM / SIGINT：停止 accept，服务完当前客户端 (最多 -d 秒) 后退出
 
-    std::cout << "listen net port: " << PORT << std::endl;
+const int PORT = 8080;
+const int BUFFER_SIZE = 1024;
 
+// 单个监听 socket 上的 accept + 回显循环（阻塞模型，一次只服务一个客户端）
+void serve_listener(int sockfd) {
     int client_fd;
     while (true) {
+        // 开始排空：不再接受新连接
+        if (!wait_accept(sockfd)) {
+            break;
+        }
+
         // 5. accept 接受请求并服务
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
         client_fd = accept(sockfd, (struct sockaddr*)&client_addr, &client_len);
         
         if (client_fd == -1) {
+            // 连接被其它进程 (例如交接后的新进程) 抢走了
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) continue;
             perror("accept error");
             close(sockfd);
-            close(client_fd);
             exit(1);
         }
 
-        std::cout << "Client connected: " << inet_ntoa(client_addr.sin_addr) << std::endl;
+        std::cout << "[" << getpid() << "] Client connected: " << inet_ntoa(client_addr.sin_addr) << std::endl;
 
         // 6. send, recv 收发数据，这里只对接受的数据，进行回显即可
-        char buffer[BUFFER_SIZE];
         while (true) {
-            memset(buffer, 0, BUFFER_SIZE); // 重置缓冲区
+            // 排空超时，不再等这个客户端
+            if (!wait_client(client_fd)) {
+                std::cout << "Idle or drain timeout, close client" << std::endl;
+                break;
+            }
+
+            // 可读了才借缓冲区，本轮回显完归还；不清零，只用 recv 返回的部分
+            PooledBuffer buffer(BUFFER_SIZE);
 
             // 接收数据
-            int bytes_num = recv(client_fd, buffer, BUFFER_SIZE, 0);
+            int bytes_num = recv(client_fd, buffer.data(), buffer.capacity(), 0);
 
             if (bytes_num <= 0) {
                 std::cout << "Connect disconnected" << std::endl;
@@ -72,19 +62,61 @@ void tcp_server() {
             }
 
             // 将收到的数据回显至客户端
-            send(client_fd, buffer, bytes_num, 0);
+            send(client_fd, buffer.data(), bytes_num, 0);
         }
-    }
 
-    
+        close(client_fd);
+    }
 
-    // 7. 关闭socket
+    // 7. 关闭socket (交接后新进程仍持有同一个监听 socket)
     close(sockfd);
-    close(client_fd);
+    std::cout << "[" << getpid() << "] drained, exit" << std::endl;
+}
+
+void tcp_server(const ListenOptions &opts) {
+    // 1~4. 创建 socket、地址复用、绑定、监听
+    std::vector<int> listen_fds = create_listen_sockets(PORT, 3, opts);
+
+    std::cout << "listen net port: " << PORT << std::endl;
+
+    if (listen_fds.size() == 1) {
+        serve_listener(listen_fds[0]);
+        return;
+    }
+
+    // 分片模式：阻塞服务器是单线程的，所以每个分片 fork 一个进程，各自拥有一个 SO_REUSEPORT 监听 socket
+    std::cout << "listen shards: " << listen_fds.size() << std::endl;
+    for (size_t i = 0; i < listen_fds.size(); i++) {
+        pid_t pid = fork();
+        if (pid == -1) {
+            perror("fork error");
+            exit(1);
+        }
+
+        if (pid == 0) {
+            // 子进程只保留自己的那个监听 socket
+            for (size_t j = 0; j < listen_fds.size(); j++) {
+                if (j != i) close(listen_fds[j]);
+            }
+            if (opts.cpu_steering) {
+                bind_to_cpu(i);
+            }
+            serve_listener(listen_fds[i]);
+            exit(0);
+        }
+    }
+
+    // 父进程不处理连接，关闭所有监听 socket 后等待子进程
+    for (int fd : listen_fds) {
+        close(fd);
+    }
+    while (wait(NULL) > 0);
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    ListenOptions opts = parse_listen_options(argc, argv);
+    graceful_init(opts.drain_timeout_ms, opts.idle_timeout_ms);
 
-    tcp_server();
+    tcp_server(opts);
     return 0;
-}
\ No newline at end of file
+}
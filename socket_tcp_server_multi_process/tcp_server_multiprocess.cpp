@@ -6,18 +6,64 @@
 #include <cstring>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <cerrno>
+#include <vector>
+#include <algorithm>
+#include <sys/epoll.h>
+#include <fcntl.h>
+
+#include "../common/listen_socket.h"
+
+// 用法: ./tcp_server_multiprocess [-s 分片数] [-c] [-p 预派生进程数] [-r 每个进程最多处理的连接数] [-u 交接路径] [-d 排空秒数] [-I 空闲秒数]
+//   不带 -p: 每个连接 fork 一个子进程 (原始模型)
+//   带 -p N: 预先 fork N 个 worker，连接到来时直接由空闲 worker accept，不再为每个连接创建进程
+//            每个分片至少要有一个 worker，-s 大于 -p 时分片数按 -p 截断
+//   SIGTERM / SIGINT：所有进程停止 accept，服务完已有连接 (最多 -d 秒) 后退出，supervisor 不再重新拉起 worker
 
 const int PORT = 8080;
 const int BUFFER_SIZE = 1024;
+const int DEFAULT_MAX_CONNECTIONS_PER_WORKER = 10000; // worker 处理这么多连接后主动退出，由 supervisor 重新拉起
+const int RESPAWN_BACKOFF_MIN_MS = 100;     // fork worker 失败后第一次重试的间隔
+const int RESPAWN_BACKOFF_MAX_MS = 5000;    // 连续失败时间隔翻倍，最多这么久
+
+// 预派生模式参数
+struct PreforkOptions
+{
+    int workers = 0;                                              // 0 表示不使用预派生
+    int max_connections = DEFAULT_MAX_CONNECTIONS_PER_WORKER;     // worker 回收阈值
+};
 
 void sigchld_handler(int sig);
-void tcp_server();
+void tcp_server(const ListenOptions &opts, const PreforkOptions &prefork);
+void accept_loop(int sockfd);
+void wait_children();
 void handle_client(int client_fd, struct sockaddr_in &client_addr);
+void prefork_supervisor(const std::vector<int> &listen_fds, const PreforkOptions &prefork, const ListenOptions &opts);
+pid_t spawn_worker(int slot, int sockfd, const PreforkOptions &prefork, const ListenOptions &opts);
+void worker_loop(int sockfd, int max_connections);
+
 
+int main(int argc, char *argv[]) {
+    PreforkOptions prefork;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            prefork.workers = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            prefork.max_connections = atoi(argv[++i]);
+        }
+    }
 
-int main() {
+    ListenOptions opts = parse_listen_options(argc, argv);
+    // 没有 worker 的 SO_REUSEPORT 分片仍然会被内核分到连接，这些连接永远没人 accept
+    if (prefork.workers > 0 && opts.shards > prefork.workers) {
+        std::cout << "shards (" << opts.shards << ") > workers (" << prefork.workers
+                  << "), use " << prefork.workers << " shards" << std::endl;
+        opts.shards = prefork.workers;
+    }
+    graceful_init(opts.drain_timeout_ms, opts.idle_timeout_ms);
 
-    tcp_server();
+    tcp_server(opts, prefork);
     return 0;
 }
 
@@ -44,9 +90,15 @@ void handle_client(int client_fd, struct sockaddr_in &client_addr) {
     std::cout << "[Child " << getpid() << "] client connected: " << inet_ntoa(client_addr.sin_addr) << std::endl; 
 
     // 6. send, recv 收发数据，这里只对接受的数据，进行回显即可
+    // 用栈上的缓冲区而不是 BufferPool：每个子进程的池子都是空的，第一次借就要切一整块 slab；
+    // 不清零，只用 recv 返回的部分，没写到的栈页不会占内存
     char buffer[BUFFER_SIZE];
     while (true) {
-        memset(buffer, 0, BUFFER_SIZE); // 重置缓冲区
+        // 排空超时，不再等这个客户端
+        if (!wait_client(client_fd)) {
+            std::cout << "[Child " << getpid() << "] idle or drain timeout, close client" << std::endl;
+            break;
+        }
 
         // 接收数据
         int bytes_num = recv(client_fd, buffer, BUFFER_SIZE, 0);
@@ -62,7 +114,7 @@ void handle_client(int client_fd, struct sockaddr_in &client_addr) {
             break;
         }
 
-        std::cout << "[Child " << getpid() << "] client Receive: " << buffer << std::endl;
+        std::cout << "[Child " << getpid() << "] client Receive: " << std::string(buffer, bytes_num) << std::endl;
 
         // 将收到的数据回显至客户端
         send(client_fd, buffer, bytes_num, 0);
@@ -70,59 +122,83 @@ void handle_client(int client_fd, struct sockaddr_in &client_addr) {
 
     // 关闭socket
     close(client_fd);
-    // 退出进程
-    exit(0);
 }
 
-void tcp_server() {
-    // 1. 创建socket
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd == -1) {
-        perror("failed create socket.");
-        exit(1);
+void tcp_server(const ListenOptions &opts, const PreforkOptions &prefork) {
+    // 1~4. 创建 socket、地址复用、绑定、监听
+    std::vector<int> listen_fds = create_listen_sockets(PORT, 10, opts);
+
+    std::cout << "Multi-Process TCP Server" << std::endl;
+    std::cout << "listen net port: " << PORT << std::endl;
+    std::cout << "Server pid: " << getpid() << std::endl;
+
+    if (prefork.workers > 0) {
+        prefork_supervisor(listen_fds, prefork, opts);
+        return;
     }
 
-    // 2. 设置地址复用，避免端口占用
-    int opt = 1;
-    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (listen_fds.size() == 1) {
+        accept_loop(listen_fds[0]);
+        wait_children();
+        return;
+    }
 
-    // 3. 绑定
-    struct sockaddr_in address;
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY; // 监听所有网卡请求
-    address.sin_port = htons(PORT); // 设置监听端口 TODO: 必须转换数据类型
+    // 分片模式：每个分片一个 accept 进程，各自拥有一个 SO_REUSEPORT 监听 socket，再各自 fork 子进程处理连接
+    std::cout << "listen shards: " << listen_fds.size() << std::endl;
+    for (size_t i = 0; i < listen_fds.size(); i++) {
+        pid_t pid = fork();
+        if (pid == -1) {
+            perror("fork error");
+            exit(1);
+        }
 
-    if (bind(sockfd, (struct sockaddr*)&address, sizeof(address)) == -1) {
-        perror("bind error");
-        close(sockfd);
-        exit(1);
+        if (pid == 0) {
+            for (size_t j = 0; j < listen_fds.size(); j++) {
+                if (j != i) close(listen_fds[j]);
+            }
+            if (opts.cpu_steering) {
+                bind_to_cpu(i);
+            }
+            accept_loop(listen_fds[i]);
+            wait_children();
+            exit(0);
+        }
     }
 
-    // 4. listen 监听
-    if (listen(sockfd, 10) == -1) { // listen 第二个参数的含义是当连接数小于设置值时会进入等待队列，若超过该值，则直接拒绝服务请求
-        perror("listen error");
-        close(sockfd);
-        exit(1);
+    for (int fd : listen_fds) {
+        close(fd);
     }
+    while (wait(NULL) > 0 || errno == EINTR);
+}
 
-    std::cout << "Multi-Process TCP Server" << std::endl;
-    std::cout << "listen net port: " << PORT << std::endl;
-    std::cout << "Server pid: " << getpid() << std::endl;
+// 排空：不再自动回收，逐个等待处理连接的子进程结束 (子进程自己保证不超过排空截止时间)
+void wait_children() {
+    signal(SIGCHLD, SIG_DFL);
+    while (wait(NULL) > 0 || errno == EINTR);
+    std::cout << "[" << getpid() << "] drained, exit" << std::endl;
+}
 
+void accept_loop(int sockfd) {
     // 注册信号处理函数，自动回收子进程
     signal(SIGCHLD, sigchld_handler);
 
     int client_fd;
     while (true) {
+        // 开始排空：不再接受新连接
+        if (!wait_accept(sockfd)) {
+            break;
+        }
+
         // 5. accept 接受请求并服务
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
         client_fd = accept(sockfd, (struct sockaddr*)&client_addr, &client_len);
         
         if (client_fd == -1) {
+            // SIGCHLD 会打断 accept；监听 socket 非阻塞，连接被其它进程抢走时返回 EAGAIN
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED) continue;
             perror("accept error");
             close(sockfd);
-            close(client_fd);
             exit(1);
         }
 
@@ -143,6 +219,8 @@ void tcp_server() {
             close(sockfd); // 子进程无需监听socket
             // 对客户端请求进行处理
             handle_client(client_fd, client_addr);
+            // 退出进程
+            exit(0);
         }
         else {
             // ========= 父进程 ==========
@@ -150,9 +228,182 @@ void tcp_server() {
         }
     }
 
-    
-
     // 7. 关闭socket
     close(sockfd);
-    close(client_fd);
-}
\ No newline at end of file
+}
+
+
+/**
+ * 预派生模式的 supervisor (父进程)
+ * 只负责维持 worker 数量：worker 崩溃或者达到回收阈值退出后，在同一个槽位上重新 fork 一个
+ */
+void prefork_supervisor(const std::vector<int> &listen_fds, const PreforkOptions &prefork, const ListenOptions &opts) {
+    std::cout << "prefork workers: " << prefork.workers
+              << ", recycle after " << prefork.max_connections << " connections" << std::endl;
+
+    // supervisor 自己用 waitpid 回收 worker，不能再装自动回收的 SIGCHLD 处理函数
+    signal(SIGCHLD, SIG_DFL);
+
+    // 槽位 i 使用第 (i % 分片数) 个监听 socket；不分片时所有 worker 共享同一个
+    // 交接来的监听 socket 可能比 worker 多：补足 worker，保证每个分片都有人 accept
+    int workers = prefork.workers;
+    if ((size_t)workers < listen_fds.size()) {
+        std::cout << "inherited " << listen_fds.size() << " shards, use " << listen_fds.size() << " workers" << std::endl;
+        workers = listen_fds.size();
+    }
+    std::vector<pid_t> slots(workers, -1);
+    int backoff_ms = RESPAWN_BACKOFF_MIN_MS;
+
+    while (true) {
+        // fork 失败的槽位 (-1) 每轮重试；还有没补上的就不能阻塞在 waitpid 上
+        bool missing = false;
+        if (!draining()) {
+            for (int i = 0; i < workers; i++) {
+                if (slots[i] != -1) continue;
+                slots[i] = spawn_worker(i, listen_fds[i % listen_fds.size()], prefork, opts);
+                if (slots[i] == -1) missing = true;
+            }
+        }
+
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, missing ? WNOHANG : 0);
+        if (pid == -1 && errno == EINTR) continue;
+        if (pid == 0 || (pid == -1 && errno == ECHILD && missing)) {
+            // 没有 worker 退出，只是还有槽位没补上：退避后重试，连续失败时间隔翻倍
+            usleep(backoff_ms * 1000);
+            backoff_ms = std::min(backoff_ms * 2, RESPAWN_BACKOFF_MAX_MS);
+            continue;
+        }
+        if (pid == -1) {
+            if (errno != ECHILD) {
+                perror("waitpid error");
+            }
+            break;
+        }
+        if (!missing) {
+            backoff_ms = RESPAWN_BACKOFF_MIN_MS;
+        }
+
+        // 排空中：worker 退出后不再补位，全部退出后 waitpid 返回 ECHILD
+        if (draining()) {
+            std::cout << "[Supervisor] worker " << pid << " drained" << std::endl;
+            continue;
+        }
+
+        for (int i = 0; i < workers; i++) {
+            if (slots[i] != pid) continue;
+
+            if (WIFSIGNALED(status)) {
+                std::cout << "[Supervisor] worker " << pid << " killed by signal " << WTERMSIG(status) << ", respawn" << std::endl;
+            }
+            else {
+                std::cout << "[Supervisor] worker " << pid << " exited (" << WEXITSTATUS(status) << "), respawn" << std::endl;
+            }
+
+            // 下一轮循环开头补位 (fork 失败则按退避重试)
+            slots[i] = -1;
+            break;
+        }
+    }
+
+    for (int fd : listen_fds) {
+        close(fd);
+    }
+}
+
+pid_t spawn_worker(int slot, int sockfd, const PreforkOptions &prefork, const ListenOptions &opts) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork error");
+        return -1;
+    }
+
+    if (pid == 0) {
+        // ========= worker 进程 ==========
+        if (opts.cpu_steering) {
+            bind_to_cpu(slot);
+        }
+        worker_loop(sockfd, prefork.max_connections);
+        exit(0);
+    }
+
+    return pid;
+}
+
+/**
+ * worker 进程：在共享的监听 socket 上等待连接，一次服务一个客户端
+ *
+ * 所有 worker 都 epoll 同一个监听 socket，注册时带上 EPOLLEXCLUSIVE (Linux 4.5+)，
+ * 新连接到来时内核只唤醒其中一个 (或少数几个) worker，避免惊群；
+ * 没抢到连接的 worker accept 会返回 EAGAIN，继续等待即可。
+ */
+void worker_loop(int sockfd, int max_connections) {
+    // 监听 socket 设置为非阻塞，防止被唤醒后连接已经被其它 worker 取走而阻塞在 accept 上
+    int flags = fcntl(sockfd, F_GETFL, 0);
+    fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+
+    int epfd = epoll_create(1);
+    if (epfd == -1) {
+        perror("epoll create error");
+        exit(1);
+    }
+
+    // 排空通知也注册进来 (每个 worker 都要收到，不能带 EPOLLEXCLUSIVE)
+    int drain_fd = drain_state().event_fd;
+    epoll_event event;
+    if (drain_fd != -1) {
+        event.events = EPOLLIN;
+        event.data.fd = drain_fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, drain_fd, &event);
+    }
+
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.fd = sockfd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &event) == -1) {
+        // 老内核不支持 EPOLLEXCLUSIVE，退回普通注册 (仍然正确，只是可能惊群)
+        event.events = EPOLLIN;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &event) == -1) {
+            perror("epoll_ctl error");
+            exit(1);
+        }
+    }
+
+    std::cout << "[Worker " << getpid() << "] started" << std::endl;
+
+    int served = 0;
+    while (served < max_connections) {
+        epoll_event ready;
+        int n = epoll_wait(epfd, &ready, 1, -1);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait error");
+            exit(1);
+        }
+
+        // 开始排空：当前没有在服务的连接，直接退出
+        if (ready.data.fd == drain_fd) {
+            std::cout << "[Worker " << getpid() << "] drained, exit" << std::endl;
+            close(epfd);
+            return;
+        }
+
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int client_fd = accept(sockfd, (struct sockaddr*)&client_addr, &client_len);
+        if (client_fd == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) {
+                continue; // 连接被其它 worker 抢走了
+            }
+            perror("accept error");
+            exit(1);
+        }
+
+        // accept 返回的 fd 不继承 O_NONBLOCK，handle_client 按阻塞方式收发
+        handle_client(client_fd, client_addr);
+        served++;
+    }
+
+    // 达到回收阈值：主动退出，释放可能累积的内存碎片 / 泄漏，由 supervisor 重新 fork
+    std::cout << "[Worker " << getpid() << "] served " << served << " connections, recycle" << std::endl;
+    close(epfd);
+}
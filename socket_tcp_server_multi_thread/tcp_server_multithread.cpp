@@ -4,12 +4,19 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <cstring>
+#include <cerrno>
 #include <unistd.h>
 #include <thread>
 
 #include <atomic> // 用于进行原子操作
+#include <vector>
+
+#include "../common/listen_socket.h"
+#include "../common/buffer_pool.h"
 
 // build bash: g++ -pthread tcp_server_multithread.cpp -o tcp_server_multithread
+// 用法: ./tcp_server_multithread [-s 分片数] [-c] [-u 交接路径] [-d 排空秒数] [-I 空闲秒数]
+//   SIGTERM / SIGINT：停止 accept，等所有客户端线程结束 (最多 -d 秒) 后退出
 
 const int PORT = 8080;
 const int BUFFER_SIZE = 1024;
@@ -19,13 +26,17 @@ std::atomic<int> g_client_count{0};
 
 // 需要一个同步机制，用于计数，当前产生的线程数，用于控制仅使用有限的线程来处理连接请求，超出部分拒绝服务
 
-void tcp_server();
+void tcp_server(const ListenOptions &opts);
+void accept_loop(int sockfd);
+void wait_clients_drained();
 void client_handler(int client_fd, const struct sockaddr_in &server_addr);
 
 
-int main() {
+int main(int argc, char *argv[]) {
+    ListenOptions opts = parse_listen_options(argc, argv);
+    graceful_init(opts.drain_timeout_ms, opts.idle_timeout_ms);
 
-    tcp_server();
+    tcp_server(opts);
     return 0;
 }
 
@@ -33,12 +44,18 @@ void client_handler(int client_fd, const struct sockaddr_in &server_addr) {
     std::cout << "Client connected: " << inet_ntoa(server_addr.sin_addr) << std::endl;
 
     // 6. send, recv 收发数据，这里只对接受的数据，进行回显即可
-    char buffer[BUFFER_SIZE];
     while (true) {
-        memset(buffer, 0, BUFFER_SIZE); // 重置缓冲区
+        // 排空超时，不再等这个客户端
+        if (!wait_client(client_fd)) {
+            std::cout << "Idle or drain timeout, close client" << std::endl;
+            break;
+        }
+
+        // 可读了才借缓冲区，本轮回显完归还：阻塞在等待上的连接不占缓冲区
+        PooledBuffer buffer(BUFFER_SIZE);
 
         // 接收数据
-        int bytes_num = recv(client_fd, buffer, BUFFER_SIZE, 0);
+        int bytes_num = recv(client_fd, buffer.data(), buffer.capacity(), 0);
 
         if (bytes_num <= 0) {
             if (bytes_num == 0) {
@@ -51,7 +68,7 @@ void client_handler(int client_fd, const struct sockaddr_in &server_addr) {
         }
 
         // 将收到的数据回显至客户端
-        send(client_fd, buffer, bytes_num, 0);
+        send(client_fd, buffer.data(), bytes_num, 0);
     }
 
     // 关闭socket
@@ -59,57 +76,70 @@ void client_handler(int client_fd, const struct sockaddr_in &server_addr) {
     g_client_count--;
 }
 
-void tcp_server() {
-    // 1. 创建socket
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd == -1) {
-        perror("failed create socket.");
-        exit(1);
-    }
+void tcp_server(const ListenOptions &opts) {
+    // 1~4. 创建 socket、地址复用、绑定、监听
+    std::vector<int> listen_fds = create_listen_sockets(PORT, 3, opts);
 
-    // 2. 设置地址复用，避免端口占用
-    int opt = 1;
-    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    std::cout << "Multi-Thread TCP Server" << std::endl;
+    std::cout << "listen net port: " << PORT << std::endl;
 
-    // 3. 绑定
-    struct sockaddr_in address;
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY; // 监听所有网卡请求
-    address.sin_port = htons(PORT); // 设置监听端口 TODO: 必须转换数据类型
+    if (listen_fds.size() == 1) {
+        accept_loop(listen_fds[0]);
+        wait_clients_drained();
+        return;
+    }
 
-    if (bind(sockfd, (struct sockaddr*)&address, sizeof(address)) == -1) {
-        perror("bind error");
-        close(sockfd);
-        exit(1);
+    // 分片模式：每个 SO_REUSEPORT 监听 socket 由一个 accept 线程独占，线程上限 THREAD_LIMIT 仍是全局共享的
+    std::cout << "listen shards: " << listen_fds.size() << std::endl;
+    std::vector<std::thread> acceptors;
+    for (size_t i = 0; i < listen_fds.size(); i++) {
+        int sockfd = listen_fds[i];
+        bool steering = opts.cpu_steering;
+        acceptors.emplace_back([sockfd, steering, i]() {
+            if (steering) {
+                bind_to_cpu(i);
+            }
+            accept_loop(sockfd);
+        });
     }
 
-    // 4. listen 监听
-    if (listen(sockfd, 3) == -1) { // listen 第二个参数的含义是当连接数小于设置值时会进入等待队列，若超过该值，则直接拒绝服务请求
-        perror("listen error");
-        close(sockfd);
-        exit(1);
+    for (auto &t : acceptors) {
+        t.join();
     }
+    wait_clients_drained();
+}
 
-    std::cout << "Multi-Thread TCP Server" << std::endl;
-    std::cout << "listen net port: " << PORT << std::endl;
+// accept 循环都已退出：客户端线程是 detach 的，等它们自己结束 (wait_client 保证不超过排空截止时间)
+void wait_clients_drained() {
+    while (g_client_count > 0) {
+        usleep(10000);
+    }
+    std::cout << "drained, exit" << std::endl;
+}
 
+void accept_loop(int sockfd) {
     int client_fd;
     while (true) {
+        // 开始排空：不再接受新连接
+        if (!wait_accept(sockfd)) {
+            break;
+        }
+
         // 5. accept 接受请求并服务
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
         client_fd = accept(sockfd, (struct sockaddr*)&client_addr, &client_len);
         
         if (client_fd == -1) {
+            // 连接被其它线程 / 进程抢走了
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) continue;
             perror("accept error");
             close(sockfd);
-            close(client_fd);
             exit(1);
         }
         
-        // 如果现存的线程数量超过预设数量，则拒绝处理
-        if (g_client_count > THREAD_LIMIT) {
-            close(sockfd);
+        // 如果现存的线程数量超过预设数量，则拒绝处理（只关闭该连接，监听 socket 继续工作）
+        if (g_client_count >= THREAD_LIMIT) {
             close(client_fd);
             continue;
         }
@@ -122,4 +152,4 @@ void tcp_server() {
 
     // 7. 关闭socket
     close(sockfd);
-}
\ No newline at end of file
+}
@@ -1 +1 @@
-g++ -pthread tcp_server_thread_pool.cpp   -o tcp_server_thread_pool
\ No newline at end of file
+g++ -std=c++17 -pthread tcp_server_thread_pool.cpp   -o tcp_server_thread_pool
\ No newline at end of file
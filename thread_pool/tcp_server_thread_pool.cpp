@@ -1,72 +1,302 @@
 #include "thread_pool.h"
+#include "../common/listen_socket.h"
+
+#include <fcntl.h>
+
+// 用法: ./tcp_server_thread_pool [-s 分片数] [-c] [-l | -w | -e] [-n] [-u 交接路径] [-d 排空秒数] [-I 空闲秒数]
+//   -l  线程池使用无锁 MPMC 任务队列
+//   -w  线程池使用工作窃取调度
+//   -e  弹性线程池：按排队时间 / 深度扩缩容，并定期打印统计
+//   -n  事件驱动：epoll 前端分发就绪事件，worker 不再被一个连接独占
+//   -I  连接空闲超时 (默认 60 秒)：阻塞模式由 wait_client 的 poll 超时检查，事件驱动模式由前端的时间轮检查
+//   SIGTERM / SIGINT：停止 accept，等已有连接和线程池中的任务结束 (最多 -d 秒) 后退出
 
 // define const variable
 const int PORT = 8080;
+const int STATS_INTERVAL_SEC = 10; // 弹性模式下打印线程池统计的间隔
+const int MAX_EVENTS = 1024;       // 事件驱动模式下一次 epoll_wait 最多处理的事件数
+const int DRAIN_GRACE_MS = 1000;   // 排空截止后再给线程池留的收尾时间
+const int DRAIN_POLL_MS = 50;      // 事件驱动模式排空时检查连接数的间隔
+const int TIMER_TICK_MS = 10;      // 事件驱动模式空闲超时的精度
 
 // define will used function
-void tcp_server_thread_pool();
+void tcp_server_thread_pool(const ListenOptions &opts, QueueBackend backend, bool elastic, bool event_driven);
+void accept_loop(int sockfd, ThreadPool &pool);
+void event_loop(int sockfd, ThreadPool &pool);
+void drain_pool(ThreadPool &pool);
+
+int main(int argc, char *argv[]) {
+    QueueBackend backend = QueueBackend::MUTEX;
+    bool elastic = false;
+    bool event_driven = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-l") == 0) {
+            backend = QueueBackend::LOCK_FREE;
+        }
+        else if (strcmp(argv[i], "-w") == 0) {
+            backend = QueueBackend::WORK_STEALING;
+        }
+        else if (strcmp(argv[i], "-e") == 0) {
+            elastic = true;
+        }
+        else if (strcmp(argv[i], "-n") == 0) {
+            event_driven = true;
+        }
+    }
 
-int main() {
-    tcp_server_thread_pool();
+    ListenOptions opts = parse_listen_options(argc, argv);
+    graceful_init(opts.drain_timeout_ms, opts.idle_timeout_ms);
+
+    tcp_server_thread_pool(opts, backend, elastic, event_driven);
 }
 
-void tcp_server_thread_pool() {
-    // 1. 创建socket
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd == -1) {
-        perror("failed create socket.");
-        exit(1);
-    }
+void tcp_server_thread_pool(const ListenOptions &opts, QueueBackend backend, bool elastic, bool event_driven) {
+    // 1~4. 创建 socket、地址复用、绑定、监听
+    std::vector<int> listen_fds = create_listen_sockets(PORT, 3, opts);
 
-    // 2. 设置地址复用，避免端口占用
-    int opt = 1;
-    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    std::cout << "listen net port: " << PORT << std::endl;
 
-    // 3. 绑定
-    struct sockaddr_in address;
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY; // 监听所有网卡请求
-    address.sin_port = htons(PORT); // 设置监听端口 TODO: 必须转换数据类型
+    // 创建线程池
+    std::unique_ptr<ThreadPool> pool_ptr(elastic ? new ThreadPool(ElasticOptions())
+                                                 : new ThreadPool(THREAD_POOL_SIZE, backend));
+    ThreadPool &pool = *pool_ptr;
 
-    if (bind(sockfd, (struct sockaddr*)&address, sizeof(address)) == -1) {
-        perror("bind error");
-        close(sockfd);
-        exit(1);
+    // 统计线程每隔 STATS_INTERVAL_SEC 打印一次，排空一开始就结束；线程池销毁之前 join
+    std::thread stats_thread;
+    if (elastic) {
+        stats_thread = std::thread([&pool]() {
+            while (!wait_drain(STATS_INTERVAL_SEC * 1000)) {
+                pool.stats().print();
+            }
+        });
     }
 
-    // 4. listen 监听
-    if (listen(sockfd, 3) == -1) { // listen 第二个参数的含义是当连接数小于设置值时会进入等待队列，若超过该值，则直接拒绝服务请求
-        perror("listen error");
-        close(sockfd);
-        exit(1);
+    // 每个监听 socket 一个前端线程：阻塞模式下只 accept，事件驱动模式下跑 epoll 循环
+    void (*front_end)(int, ThreadPool &) = event_driven ? event_loop : accept_loop;
+
+    if (listen_fds.size() == 1) {
+        front_end(listen_fds[0], pool);
     }
+    else {
+        // 分片模式：每个 SO_REUSEPORT 监听 socket 一个 accept 线程，共享同一个线程池
+        std::cout << "listen shards: " << listen_fds.size() << std::endl;
+        std::vector<std::thread> acceptors;
+        for (size_t i = 0; i < listen_fds.size(); i++) {
+            int sockfd = listen_fds[i];
+            bool steering = opts.cpu_steering;
+            acceptors.emplace_back([sockfd, steering, i, front_end, &pool]() {
+                if (steering) {
+                    bind_to_cpu(i);
+                }
+                front_end(sockfd, pool);
+            });
+        }
 
-    std::cout << "listen net port: " << PORT << std::endl;
+        for (auto &t : acceptors) {
+            t.join();
+        }
+    }
+    drain_pool(pool);
 
-    // 创建线程池
-    ThreadPool pool;
+    // 前端只在排空开始后退出，统计线程此时已经 (或马上) 结束
+    if (stats_thread.joinable()) {
+        stats_thread.join();
+    }
+}
+
+// 前端都已退出：等线程池执行完剩下的任务 (阻塞模式下连接任务自己保证不超过排空截止时间)
+void drain_pool(ThreadPool &pool) {
+    if (!pool.wait_idle(drain_remaining_ms() + DRAIN_GRACE_MS)) {
+        std::cout << "[ThreadPool] drain timeout, drop queued jobs" << std::endl;
+    }
+    std::cout << "drained, exit" << std::endl;
+}
 
+void accept_loop(int sockfd, ThreadPool &pool) {
     int client_fd;
     while (true) {
+        // 开始排空：不再接受新连接
+        if (!wait_accept(sockfd)) {
+            break;
+        }
+
         // 5. accept 接受请求并服务
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
         client_fd = accept(sockfd, (struct sockaddr*)&client_addr, &client_len);
         
         if (client_fd == -1) {
+            // 连接被其它线程 / 进程抢走了
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) continue;
             perror("accept error");
             close(sockfd);
-            close(client_fd);
             exit(1);
         }
 
         // 6. 将用户连接请求封装成任务到线程池排队执行
-        pool.enqueue([client_fd, &client_addr]() {
-            client_handler_task(client_fd, client_addr);
-        }); // 要求无参函数
+        //    client_addr 按值绑定进任务 (内联存放，不分配堆内存)，连接任务不需要返回值，future 直接丢弃
+        pool.submit(client_handler_task, client_fd, client_addr);
     }
 
     // 7. 关闭socket
     close(sockfd);
-    close(client_fd);
-}
\ No newline at end of file
+}
+
+// 事件驱动模式：epoll 只在这个线程里等待，连接空闲时不占用任何 worker
+void event_loop(int sockfd, ThreadPool &pool) {
+    // 监听 socket 设为非阻塞，accept 循环到 EAGAIN
+    int flags = fcntl(sockfd, F_GETFL, 0);
+    fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd == -1) {
+        perror("epoll create error");
+        close(sockfd);
+        exit(1);
+    }
+
+    // 监听 socket 的 data.ptr 为 nullptr，连接的 data.ptr 指向 Connection
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &event) == -1) {
+        perror("epoll_ctl error");
+        close(sockfd);
+        close(epfd);
+        exit(1);
+    }
+
+    // 排空通知的 data.ptr 指向它自己的 fd 变量
+    int drain_fd = drain_state().event_fd;
+    if (drain_fd != -1) {
+        event.events = EPOLLIN;
+        event.data.ptr = &drain_fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, drain_fd, &event);
+    }
+
+    // 和 worker 共享；排空超时退出时 worker 可能还在用，同 epfd 一样不释放
+    EventFrontEnd *front = new EventFrontEnd;
+    front->epfd = epfd;
+    front->idle_timeout_ms = drain_state().idle_timeout_ms;
+    int idle_timeout_ms = front->idle_timeout_ms;
+    TimingWheel wheel(event_now_ms(), TIMER_TICK_MS);
+
+    bool is_draining = false;
+    epoll_event events[MAX_EVENTS];
+    while (true) {
+        // worker 关闭的连接：撤掉空闲定时器后释放
+        std::vector<Connection*> closed;
+        {
+            std::lock_guard<std::mutex> lock(front->closed_mutex);
+            closed.swap(front->closed);
+        }
+        for (Connection *conn : closed) {
+            wheel.cancel(&conn->idle_timer);
+            delete conn;
+        }
+
+        // 睡到最近的空闲超时；排空中连接都关闭了或者到了截止时间就退出
+        int timeout = wheel.next_timeout_ms(event_now_ms());
+        if (is_draining) {
+            int drain_timeout = drain_remaining_ms();
+            if (g_client_count == 0 || drain_timeout == 0) {
+                break;
+            }
+            // 连接是 worker 关闭的，前端收不到通知，定期醒来检查
+            drain_timeout = std::min(drain_timeout, DRAIN_POLL_MS);
+            if (timeout == -1 || drain_timeout < timeout) {
+                timeout = drain_timeout;
+            }
+        }
+
+        int n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait error");
+            break;
+        }
+        int64_t now_ms = event_now_ms();
+
+        for (int i = 0; i < n; i++) {
+            // 开始排空：摘掉并关闭监听 socket (交接后新进程仍持有它)，eventfd 一直可读，也要摘掉
+            if (events[i].data.ptr == &drain_fd) {
+                epoll_ctl(epfd, EPOLL_CTL_DEL, drain_fd, NULL);
+                epoll_ctl(epfd, EPOLL_CTL_DEL, sockfd, NULL);
+                close(sockfd);
+                sockfd = -1;
+                is_draining = true;
+                continue;
+            }
+
+            Connection *conn = static_cast<Connection*>(events[i].data.ptr);
+
+            // 新连接：注册为 EPOLLONESHOT，连接状态交给 Connection 保存
+            if (conn == nullptr) {
+                if (sockfd == -1) continue; // 同一批事件里已经开始排空
+                while (true) {
+                    struct sockaddr_in client_addr;
+                    socklen_t client_len = sizeof(client_addr);
+                    int client_fd = accept4(sockfd, (struct sockaddr*)&client_addr, &client_len,
+                                            SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (client_fd == -1) {
+                        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                        if (errno == EINTR || errno == ECONNABORTED) continue;
+                        // fd 用尽等错误不应让整个服务器退出
+                        perror("accept error");
+                        break;
+                    }
+
+                    // 先计数再注册：注册后 worker 随时可能关闭连接并减计数
+                    g_client_count++;
+                    conn = new Connection;
+                    conn->fd = client_fd;
+                    conn->addr = client_addr;
+                    conn->front = front;
+                    conn->last_active_ms.store(now_ms, std::memory_order_relaxed);
+                    if (idle_timeout_ms > 0) {
+                        conn->idle_timer.data = conn;
+                        wheel.arm(&conn->idle_timer, now_ms + idle_timeout_ms);
+                    }
+                    event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+                    event.data.ptr = conn;
+                    if (epoll_ctl(epfd, EPOLL_CTL_ADD, client_fd, &event) == -1) {
+                        perror("epoll_ctl error");
+                        close(client_fd);
+                        wheel.cancel(&conn->idle_timer);
+                        delete conn;
+                        g_client_count--;
+                        continue;
+                    }
+
+                    std::cout << "[client] Client connected: " << inet_ntoa(client_addr.sin_addr) << ":" << ntohs(client_addr.sin_port) << " | Total: " << g_client_count << std::endl;
+                }
+                continue;
+            }
+
+            // 就绪事件交给线程池；EPOLLONESHOT 保证 worker 重新 arm 之前不会再收到这个连接的事件
+            uint32_t revents = events[i].events;
+            pool.enqueue([epfd, conn, revents]() {
+                connection_event_task(epfd, conn, revents);
+            });
+        }
+
+        // 到期的空闲定时器：期间有过收发就顺延，否则 shutdown，由 worker 处理随后的 EOF 时关闭
+        // 连接可能正被 worker 处理，前端不能自己 close / delete
+        wheel.advance(now_ms, [&](TimerNode *node) {
+            Connection *conn = static_cast<Connection*>(node->data);
+            if (conn->is_closed.load()) return; // 已经在 closed 列表里，下一轮释放
+            int64_t last_active = conn->last_active_ms.load(std::memory_order_relaxed);
+            if (now_ms - last_active < idle_timeout_ms) {
+                wheel.arm(node, last_active + idle_timeout_ms);
+                return;
+            }
+            std::cout << "[client] Idle timeout, close" << std::endl;
+            shutdown(conn->fd, SHUT_RDWR);
+        });
+    }
+
+    // 超时仍未关闭的连接随进程退出一起关闭；epfd 可能还在被 worker 使用，不在这里关闭
+    if (sockfd != -1) {
+        close(sockfd);
+    }
+}
@@ -9,71 +9,375 @@
 #include <thread>
 #include <utility>
 #include <atomic>
+#include <memory>
+
+#include <string>
 
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
 #include <unistd.h>
+#include <errno.h>
 #include <cstring>
 
+#include "../common/mpmc_queue.h"
+#include "../common/futex.h"
+#include "../common/work_steal_queue.h"
+#include "../common/task.h"
+#include "../common/task_future.h"
+#include "../common/pool_stats.h"
+#include "../common/graceful.h"
+#include "../common/buffer_pool.h"
+#include "../common/timing_wheel.h"
+
 std::atomic<int> g_client_count{0};
 
-const int THREAD_POOL_SIZE = 4;
+const int THREAD_POOL_SIZE = 4;               // 固定大小模式的 worker 数；弹性模式见 ElasticOptions
 const int BUFFER_SIZE = 1024;
+const size_t LOCK_FREE_QUEUE_CAPACITY = 4096; // 无锁队列容量 (2 的幂)
+const int WORKER_SPIN_COUNT = 256;            // 无锁模式下空闲 worker 睡眠前的自旋次数
+const int EVENT_READ_BUDGET = 16;             // 事件驱动模式下一次就绪事件最多 recv 的次数，读不完的等下一次事件
+const size_t HIGH_WATER_MARK = 4 * 1024 * 1024; // 输出缓冲区上限，超过则认为对端读得太慢，断开连接
+
+// 任务队列后端
+enum class QueueBackend
+{
+    MUTEX,      // std::queue + mutex + condition_variable (默认)
+    LOCK_FREE,  // 有界无锁 MPMC 环形队列 + 自旋 + futex 停车
+    WORK_STEALING, // 每个 worker 一个本地双端队列，空闲时随机窃取其它 worker 的任务
+};
 
 class ThreadPool
 {
 private:
     std::vector<std::thread> workers;
-    std::queue<std::function<void()>> jobs; // 提交无需参数的函数
+    std::queue<TimedTask> jobs; // 提交无需参数的函数 (只能移动，小捕获不分配堆内存)
     std::mutex m_mutex;
     std::condition_variable m_condition;
-    bool stop;
+    std::atomic<bool> stop;
+
+    QueueBackend backend;
+    MpmcQueue<TimedTask> lf_jobs; // 无锁模式下的任务队列
+    WorkerParker parker;                      // 无锁 / 窃取模式下空闲 worker 在这里睡眠
+
+    // 窃取模式：每个 worker 一个本地队列，外部提交轮询分发
+    std::vector<std::unique_ptr<WorkStealQueue<TimedTask>>> local_jobs;
+    std::atomic<unsigned> next_queue{0};
+
+    // 弹性模式 (只用于 mutex 后端)：以下 int 字段都由 m_mutex 保护
+    bool elastic = false;
+    ElasticOptions elastic_opts;
+    int live_workers = 0;                     // 存活的 worker 数
+    int idle_workers = 0;                     // 正在 m_condition 上等待的 worker 数
+    std::vector<std::thread::id> retired;     // 已经缩容退出、还没 join 的 worker
+
+    // 运行时统计
+    std::atomic<uint64_t> submitted{0};
+    std::atomic<uint64_t> started{0};
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> grow_count{0};
+    std::atomic<uint64_t> shrink_count{0};
+    WaitHistogram wait_hist;
+
+    // 当前线程所属的线程池和 worker 下标 (非 worker 线程为 nullptr / -1)
+    struct WorkerContext
+    {
+        ThreadPool *pool = nullptr;
+        int index = -1;
+    };
+    static WorkerContext &current_worker()
+    {
+        static thread_local WorkerContext ctx;
+        return ctx;
+    }
+
+    void mutex_worker();
+    void lock_free_worker();
+    void work_stealing_worker(int index);
+    bool take_job(int index, TimedTask &task, bool wait_lock);
+    void run_job(TimedTask &task);
+    void grow_locked();
 public:
-    ThreadPool(int pool_size = THREAD_POOL_SIZE);
+    ThreadPool(int pool_size = THREAD_POOL_SIZE, QueueBackend backend = QueueBackend::MUTEX);
+    // 弹性模式：worker 数在 [min_workers, max_workers] 之间随负载伸缩 (使用 mutex 后端)
+    explicit ThreadPool(const ElasticOptions &opts);
     ~ThreadPool();
 
+    // 当前 worker 数、排队深度、排队时间直方图等的快照
+    ThreadPoolStats stats();
+
+    // 等待已提交的任务全部执行完 (最多 timeout_ms)，析构前调用就不会丢任务
+    bool wait_idle(int timeout_ms);
+
     template<class FUNC>
     void enqueue(FUNC &&f);
+
+    // 提交 f(args...)，返回可以获取结果的 future；参数按值保存
+    template<class FUNC, class... ARGS>
+    typename TaskTraits<FUNC, ARGS...>::Future submit(FUNC &&f, ARGS&&... args);
 };
 
-ThreadPool::ThreadPool(int pool_size) : stop{false}
+ThreadPool::ThreadPool(int pool_size, QueueBackend backend)
+    : stop{false}, backend{backend},
+      lf_jobs(backend == QueueBackend::LOCK_FREE ? LOCK_FREE_QUEUE_CAPACITY : 2)
 {
+    // 窃取模式的本地队列必须在 worker 启动前建好
+    if (backend == QueueBackend::WORK_STEALING) {
+        for (int i = 0; i < pool_size; i++) {
+            local_jobs.emplace_back(new WorkStealQueue<TimedTask>());
+        }
+    }
+
+    live_workers = pool_size;
+
     // 1. 创建线程
-    for (size_t i = 0; i < pool_size; i++)
+    for (int i = 0; i < pool_size; i++)
     {
-        workers.emplace_back([this](){
-            while (true) {
-                // 线程需要做的事情
-                std::function<void()> task = nullptr;
-                // 1. 获取锁
-                {
-                    std::unique_lock<std::mutex> lock(m_mutex);
-
-                    // 等待获取任务
-                    m_condition.wait(lock, [this](){
-                        return !jobs.empty() || stop;
-                    });
-                    
-                    // 如果停止，直接结束线程
-                    if (stop) {
-                        return;
-                    }
-
-                    // 否则取出任务
-                    task = std::move(jobs.front());
-                    jobs.pop();
-                } // 自动释放锁
-
-                // 执行任务
-                task();
-            }
-        }); // 使用原地构造
+        if (backend == QueueBackend::LOCK_FREE) {
+            workers.emplace_back(&ThreadPool::lock_free_worker, this);
+        }
+        else if (backend == QueueBackend::WORK_STEALING) {
+            workers.emplace_back(&ThreadPool::work_stealing_worker, this, i);
+        }
+        else {
+            workers.emplace_back(&ThreadPool::mutex_worker, this);
+        }
     }
     
 }
 
+ThreadPool::ThreadPool(const ElasticOptions &opts)
+    : stop{false}, backend{QueueBackend::MUTEX}, lf_jobs(2), elastic{true}, elastic_opts(opts)
+{
+    if (elastic_opts.min_workers < 1) elastic_opts.min_workers = 1;
+    if (elastic_opts.max_workers < elastic_opts.min_workers) elastic_opts.max_workers = elastic_opts.min_workers;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = 0; i < elastic_opts.min_workers; i++) {
+        workers.emplace_back(&ThreadPool::mutex_worker, this);
+    }
+    live_workers = elastic_opts.min_workers;
+}
+
+// 调用方持有 m_mutex：先回收已退出的 worker，再在上限内加一个
+void ThreadPool::grow_locked()
+{
+    for (std::thread::id id : retired) {
+        for (size_t i = 0; i < workers.size(); i++) {
+            if (workers[i].get_id() == id) {
+                // 退出的 worker 已经放开了 m_mutex，这里 join 不会死锁
+                workers[i].join();
+                workers.erase(workers.begin() + i);
+                break;
+            }
+        }
+    }
+    retired.clear();
+
+    if (live_workers >= elastic_opts.max_workers) {
+        return;
+    }
+    workers.emplace_back(&ThreadPool::mutex_worker, this);
+    live_workers++;
+    grow_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+// 记录排队时间并执行任务
+void ThreadPool::run_job(TimedTask &task)
+{
+    wait_hist.record(pool_now_ns() - task.enqueue_ns);
+    task.task();
+    completed.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadPool::mutex_worker()
+{
+    while (true) {
+        // 线程需要做的事情
+        TimedTask task;
+        // 1. 获取锁
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            // 等待获取任务；弹性模式下最多等 idle_timeout_ms
+            auto ready = [this](){
+                return !jobs.empty() || stop;
+            };
+            idle_workers++;
+            bool got = true;
+            if (elastic) {
+                got = m_condition.wait_for(lock, std::chrono::milliseconds(elastic_opts.idle_timeout_ms), ready);
+            }
+            else {
+                m_condition.wait(lock, ready);
+            }
+            idle_workers--;
+            
+            // 如果停止，直接结束线程
+            if (stop) {
+                return;
+            }
+
+            // 空闲超时：多于 min_workers 就退出，由下一次扩容或析构函数 join
+            if (!got) {
+                if (live_workers > elastic_opts.min_workers) {
+                    live_workers--;
+                    retired.push_back(std::this_thread::get_id());
+                    shrink_count.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                continue;
+            }
+
+            // 否则取出任务
+            task = std::move(jobs.front());
+            jobs.pop();
+            started.fetch_add(1, std::memory_order_relaxed);
+
+            // 任务已经排队太久而且没有空闲 worker：扩容
+            if (elastic && idle_workers == 0 && !jobs.empty()
+                && pool_now_ns() - task.enqueue_ns > elastic_opts.grow_wait_us * 1000) {
+                grow_locked();
+            }
+        } // 自动释放锁
+
+        // 执行任务
+        run_job(task);
+    }
+}
+
+void ThreadPool::lock_free_worker()
+{
+    while (true) {
+        // 与 mutex 模式一致：停止时直接退出，不再执行剩余任务
+        if (stop) {
+            return;
+        }
+
+        TimedTask task;
+
+        // 1. 先自旋一小会儿，短任务高频提交时不必进内核睡眠
+        bool got = false;
+        for (int i = 0; i < WORKER_SPIN_COUNT; i++) {
+            if (lf_jobs.try_pop(task)) {
+                got = true;
+                break;
+            }
+            cpu_relax();
+        }
+
+        // 2. 仍然没有任务：宣告准备睡眠，再检查一次队列，确实为空才 park 到 futex 上
+        if (!got) {
+            uint32_t ticket = parker.prepare_park();
+            got = lf_jobs.try_pop(task);
+            if (!got && !stop) {
+                parker.park(ticket);
+            }
+            parker.cancel_park();
+        }
+
+        if (got) {
+            started.fetch_add(1, std::memory_order_relaxed);
+            run_job(task);
+        }
+    }
+}
+
+// 先取自己的队列，再从随机的受害者开始依次窃取
+bool ThreadPool::take_job(int index, TimedTask &task, bool wait_lock)
+{
+    if (local_jobs[index]->pop(task)) {
+        return true;
+    }
+
+    // xorshift 伪随机数，避免所有空闲 worker 都去偷同一个队列
+    static thread_local uint32_t seed = 2463534242u ^ (uint32_t)(index * 2654435761u);
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    size_t n = local_jobs.size();
+    size_t start = seed % n;
+    for (size_t i = 0; i < n; i++) {
+        size_t victim = (start + i) % n;
+        if ((int)victim == index) continue;
+        if (local_jobs[victim]->steal(task, wait_lock)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work_stealing_worker(int index)
+{
+    current_worker().pool = this;
+    current_worker().index = index;
+
+    while (!stop) {
+        TimedTask task;
+
+        bool got = take_job(index, task, false);
+
+        // 所有队列都空：宣告睡眠后再完整检查一遍 (这次等锁)，确认没有任务才 park
+        if (!got) {
+            uint32_t ticket = parker.prepare_park();
+            got = take_job(index, task, true);
+            if (!got && !stop) {
+                parker.park(ticket);
+            }
+            parker.cancel_park();
+        }
+
+        if (got) {
+            started.fetch_add(1, std::memory_order_relaxed);
+            run_job(task);
+        }
+    }
+}
+
+ThreadPoolStats ThreadPool::stats()
+{
+    ThreadPoolStats s;
+    s.submitted = submitted.load(std::memory_order_relaxed);
+    s.completed = completed.load(std::memory_order_relaxed);
+    uint64_t taken = started.load(std::memory_order_relaxed);
+    s.queue_depth = s.submitted > taken ? (size_t)(s.submitted - taken) : 0;
+    s.grow_count = grow_count.load(std::memory_order_relaxed);
+    s.shrink_count = shrink_count.load(std::memory_order_relaxed);
+
+    if (backend == QueueBackend::MUTEX) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        s.workers = live_workers;
+        s.idle_workers = idle_workers;
+    }
+    else {
+        s.workers = live_workers;
+        s.idle_workers = parker.parked();
+    }
+
+    for (int i = 0; i < WaitHistogram::BUCKETS; i++) {
+        s.wait_hist[i] = wait_hist.count(i);
+    }
+    s.wait_p50_us = wait_hist.percentile_us(0.50);
+    s.wait_p99_us = wait_hist.percentile_us(0.99);
+    return s;
+}
+
+// 排空：等待已提交的任务全部执行完，超时返回 false (之后析构会丢弃还在排队的任务)
+bool ThreadPool::wait_idle(int timeout_ms)
+{
+    int64_t deadline = pool_now_ns() + (int64_t)timeout_ms * 1000000;
+    while (completed.load(std::memory_order_acquire) < submitted.load(std::memory_order_acquire)) {
+        if (pool_now_ns() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
 ThreadPool::~ThreadPool()
 {
     // 通知线程结束
@@ -83,6 +387,7 @@ ThreadPool::~ThreadPool()
     }
     // 通知所有的线程进入停机
     m_condition.notify_all();
+    parker.unpark_all();
 
     // TODO: thread 要么detach分离运行，要么join到主线程结束，否则就会异常退出
     // 所有的workers join
@@ -98,27 +403,80 @@ ThreadPool::~ThreadPool()
 template<class FUNC>
 void ThreadPool::enqueue(FUNC &&f)
 {
+    submitted.fetch_add(1, std::memory_order_relaxed);
+
+    if (backend == QueueBackend::LOCK_FREE) {
+        TimedTask task(Task(std::forward<FUNC>(f)));
+        // 有界队列满了说明 worker 跟不上，让出 CPU 等待消费
+        while (!lf_jobs.try_push(task)) {
+            std::this_thread::yield();
+        }
+        // 只有在有 worker 睡眠时才会真正发起 futex_wake 系统调用
+        parker.unpark_one();
+        return;
+    }
+
+    if (backend == QueueBackend::WORK_STEALING) {
+        TimedTask task(Task(std::forward<FUNC>(f)));
+        WorkerContext &ctx = current_worker();
+        if (ctx.pool == this) {
+            // worker 内部提交的子任务放进自己的队列，保持 cache 局部性
+            local_jobs[ctx.index]->push(std::move(task));
+        }
+        else {
+            // 外部线程 (如 accept 线程) 提交：轮询分发到各个 worker 的队列
+            unsigned i = next_queue.fetch_add(1, std::memory_order_relaxed) % local_jobs.size();
+            local_jobs[i]->push(std::move(task));
+        }
+        // 唤醒一个睡眠的 worker 来执行或窃取
+        parker.unpark_one();
+        return;
+    }
+
     {
         std::lock_guard<std::mutex> lock(m_mutex);
-        jobs.emplace(std::forward<FUNC>(f));
+        jobs.emplace(Task(std::forward<FUNC>(f)));
+
+        // 弹性模式：没有空闲 worker，且队列过深或队头等待过久，就扩容
+        if (elastic && idle_workers == 0
+            && (jobs.size() > elastic_opts.grow_depth
+                || pool_now_ns() - jobs.front().enqueue_ns > elastic_opts.grow_wait_us * 1000)) {
+            grow_locked();
+        }
     }
     // 唤醒一个线程来执行该task
     m_condition.notify_one(); // 通知一个工作线程
 }
 
 
+template<class FUNC, class... ARGS>
+typename TaskTraits<FUNC, ARGS...>::Future ThreadPool::submit(FUNC &&f, ARGS&&... args)
+{
+    // 执行端 (绑定好的参数 + 共享状态指针) 通常能放进 Task 的内联缓冲区，共享状态来自 slab 池
+    auto packaged = make_task(std::forward<FUNC>(f), std::forward<ARGS>(args)...);
+    enqueue(std::move(packaged.first));
+    return std::move(packaged.second);
+}
+
+
 // 定义一个处理用户连接请求task
 void client_handler_task(int client_fd, const sockaddr_in &client_addr) {
     g_client_count++;
     std::cout << "[client] Client connected: " << inet_ntoa(client_addr.sin_addr) << ":" << ntohs(client_addr.sin_port) << " | Total: " << g_client_count << std::endl;
 
     // 6. send, recv 收发数据，这里只对接受的数据，进行回显即可
-    char buffer[BUFFER_SIZE];
     while (true) {
-        memset(buffer, 0, BUFFER_SIZE); // 重置缓冲区
+        // 空闲或者排空超时，不再等这个客户端
+        if (!wait_client(client_fd)) {
+            std::cout << "[client] Idle or drain timeout, close" << std::endl;
+            break;
+        }
+
+        // 可读了才借缓冲区，本轮回显完归还 (进 worker 的线程本地缓存)
+        PooledBuffer buffer(BUFFER_SIZE);
 
         // 接收数据
-        int bytes_num = recv(client_fd, buffer, BUFFER_SIZE, 0);
+        int bytes_num = recv(client_fd, buffer.data(), buffer.capacity(), 0);
 
         if (bytes_num <= 0) {
             if (bytes_num == 0) {
@@ -131,7 +489,7 @@ void client_handler_task(int client_fd, const sockaddr_in &client_addr) {
         }
 
         // 将收到的数据回显至客户端
-        send(client_fd, buffer, bytes_num, 0);
+        send(client_fd, buffer.data(), bytes_num, 0);
     }
 
     // 关闭socket
@@ -139,4 +497,178 @@ void client_handler_task(int client_fd, const sockaddr_in &client_addr) {
     g_client_count--;
 
     std::cout << "[client] Close | Total: " << g_client_count << std::endl;
-}
\ No newline at end of file
+}
+
+
+/**
+ * 事件驱动模式下的连接状态
+ *
+ * 阻塞模式里一个连接整个生命周期都占着一个 worker；事件驱动模式下连接状态放在这里，
+ * 由 epoll 前端线程持有，只有 fd 就绪时才把一次 connection_event_task 交给线程池。
+ * fd 以 EPOLLONESHOT 注册：事件触发后自动解除关注，直到 worker 处理完重新 arm，
+ * 所以同一时刻只有一个 worker 在操作某个 Connection，不需要加锁。
+ *
+ * 空闲超时 (-I) 由前端的时间轮管理，定时器节点嵌在 Connection 里，所以开启后连接只能由前端释放：
+ *  - worker 收发时只更新 last_active_ms；关闭连接时把它交到前端的 closed 列表，前端撤掉定时器再 delete
+ *  - 定时器到期时前端不碰连接状态，只 shutdown(fd)：worker 随后收到 EOF / EPOLLHUP，照常关闭并释放；
+ *    worker 在 close(fd) 之前设置 is_closed，前端看到它就不再 shutdown，免得 fd 被复用后关错连接
+ */
+struct Connection;
+
+// 一个事件驱动前端和它交出去的连接共享的状态
+struct EventFrontEnd
+{
+    int epfd;
+    int idle_timeout_ms = 0;            // 连接多久没有收发就由前端关闭，0 表示不检查
+    std::mutex closed_mutex;
+    std::vector<Connection*> closed;    // worker 关闭的连接，等前端撤掉定时器后释放
+};
+
+struct Connection
+{
+    int fd;
+    sockaddr_in addr;
+    std::string out; // 还没发出去的回显数据
+    bool read_closed = false; // 对端已经关闭写端：不再读，积压数据发完再关闭
+    EventFrontEnd *front;
+
+    std::atomic<int64_t> last_active_ms{0};  // worker 收发时更新
+    std::atomic<bool> is_closed{false};      // worker 关闭 fd 之前设置
+    TimerNode idle_timer;                    // 只在前端访问
+};
+
+inline int64_t event_now_ms()
+{
+    return pool_now_ns() / 1000000;
+}
+
+// 重新关注连接的事件；有积压数据时才关注 EPOLLOUT，对端关闭写端之后不再关注可读 (水平触发下 EOF 一直可读)
+bool rearm_connection(int epfd, Connection *conn)
+{
+    epoll_event event;
+    event.events = EPOLLONESHOT;
+    if (!conn->read_closed) {
+        event.events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (!conn->out.empty()) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.ptr = conn;
+
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &event) == -1) {
+        perror("epoll_ctl mod error");
+        return false;
+    }
+    return true;
+}
+
+void close_connection(int epfd, Connection *conn)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    conn->is_closed.store(true);
+    close(conn->fd);
+    g_client_count--;
+    std::cout << "[client] Close | Total: " << g_client_count << std::endl;
+
+    EventFrontEnd *front = conn->front;
+    if (front->idle_timeout_ms > 0) {
+        // 定时器还挂在前端的时间轮上：交给前端释放，之后不能再碰 conn
+        std::lock_guard<std::mutex> lock(front->closed_mutex);
+        front->closed.push_back(conn);
+        return;
+    }
+    delete conn;
+}
+
+// 尽可能多地发送积压数据，返回 false 表示连接出错
+bool flush_output(Connection *conn)
+{
+    size_t sent = 0;
+    while (sent < conn->out.size()) {
+        ssize_t n = send(conn->fd, conn->out.data() + sent, conn->out.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+            continue;
+        }
+
+        if (n == -1 && errno == EINTR) continue;
+        // 内核发送缓冲区满了，剩下的等 EPOLLOUT 再发
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+
+        perror("send error");
+        return false;
+    }
+
+    if (sent > 0) {
+        conn->last_active_ms.store(event_now_ms(), std::memory_order_relaxed);
+    }
+    conn->out.erase(0, sent);
+    return true;
+}
+
+// 处理一次就绪事件：发送积压数据、读取并回显，最后重新 arm (或关闭连接)
+void connection_event_task(int epfd, Connection *conn, uint32_t revents)
+{
+    if (revents & (EPOLLERR | EPOLLHUP)) {
+        close_connection(epfd, conn);
+        return;
+    }
+
+    if ((revents & EPOLLOUT) && !flush_output(conn)) {
+        close_connection(epfd, conn);
+        return;
+    }
+
+    if (!conn->read_closed && (revents & (EPOLLIN | EPOLLRDHUP))) {
+        PooledBuffer buffer(BUFFER_SIZE);
+        // 水平触发：读不完的数据下次还会触发，限制次数避免一个连接霸占 worker
+        for (int i = 0; i < EVENT_READ_BUDGET; i++) {
+            ssize_t bytes_num = recv(conn->fd, buffer.data(), buffer.capacity(), 0);
+
+            if (bytes_num > 0) {
+                conn->last_active_ms.store(event_now_ms(), std::memory_order_relaxed);
+                // 已有积压数据时必须追加到末尾以保证顺序
+                conn->out.append(buffer.data(), bytes_num);
+                if (!flush_output(conn)) {
+                    close_connection(epfd, conn);
+                    return;
+                }
+                if (conn->out.size() > HIGH_WATER_MARK) {
+                    std::cout << "[client] Output buffer overflow, close" << std::endl;
+                    close_connection(epfd, conn);
+                    return;
+                }
+                continue;
+            }
+
+            if (bytes_num == 0) {
+                std::cout << "Connect disconnected" << std::endl;
+                // 还有积压的回显数据：先停止读取，等 EPOLLOUT 发完再关闭
+                if (conn->out.empty()) {
+                    close_connection(epfd, conn);
+                    return;
+                }
+                conn->read_closed = true;
+                break;
+            }
+
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+
+            perror("recv error");
+            close_connection(epfd, conn);
+            return;
+        }
+    }
+
+    // 对端已经关闭写端，积压的回显数据也发完了
+    if (conn->read_closed && conn->out.empty()) {
+        close_connection(epfd, conn);
+        return;
+    }
+
+    // 重新 arm 之后就不能再碰 conn：别的 worker 随时可能拿到下一个事件并关闭、释放它
+    if (!rearm_connection(epfd, conn)) {
+        close_connection(epfd, conn);
+    }
+}
@@ -1,38 +1,300 @@
 #include "ThreadPool.h"
 
-ThreadPool::ThreadPool(int pool_size)
+ThreadPool::ThreadPool(int pool_size, QueueBackend backend)
+    : stop{false}, backend{backend},
+      lf_jobs(backend == QueueBackend::LOCK_FREE ? LOCK_FREE_QUEUE_CAPACITY : 2)
 {
-    for (size_t i = 0; i < pool_size; i++)
+    if (backend == QueueBackend::WORK_STEALING) {
+        for (int i = 0; i < pool_size; i++) {
+            local_jobs.emplace_back(new WorkStealQueue<TimedTask>());
+        }
+    }
+
+    live_workers = pool_size;
+
+    for (int i = 0; i < pool_size; i++)
     {
-        workers.emplace_back([this](){
-            
-            while (true) {
-                Job job = nullptr;
-
-                // 此处需要操作队列，而队列是共享资源
-                { 
-                    std::unique_lock<std::mutex> lock(m_mutex);
-
-                    // 检查条件
-                    m_condition.wait(lock, [this](){
-                        return !this->jobs.empty() || this->stop;
-                    });
-
-                    if (stop) {
-                        return; // 退出任务线程
-                    }
-
-                    // 取出job
-                    job = std::move(jobs.front());
-                    jobs.pop();
+        if (backend == QueueBackend::LOCK_FREE) {
+            workers.emplace_back(&ThreadPool::lock_free_worker, this);
+        }
+        else if (backend == QueueBackend::WORK_STEALING) {
+            workers.emplace_back(&ThreadPool::work_stealing_worker, this, i);
+        }
+        else {
+            workers.emplace_back(&ThreadPool::mutex_worker, this);
+        }
+    }
+    
+}
+
+ThreadPool::ThreadPool(const ElasticOptions &opts)
+    : stop{false}, backend{QueueBackend::MUTEX}, lf_jobs(2), elastic{true}, elastic_opts(opts)
+{
+    if (elastic_opts.min_workers < 1) elastic_opts.min_workers = 1;
+    if (elastic_opts.max_workers < elastic_opts.min_workers) elastic_opts.max_workers = elastic_opts.min_workers;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = 0; i < elastic_opts.min_workers; i++) {
+        workers.emplace_back(&ThreadPool::mutex_worker, this);
+    }
+    live_workers = elastic_opts.min_workers;
+}
+
+// 持有 m_mutex 时调用：join 已退出的 worker，然后在上限内加一个
+void ThreadPool::grow_locked()
+{
+    for (std::thread::id id : retired) {
+        for (size_t i = 0; i < workers.size(); i++) {
+            if (workers[i].get_id() == id) {
+                workers[i].join(); // 它退出前已经放开了 m_mutex
+                workers.erase(workers.begin() + i);
+                break;
+            }
+        }
+    }
+    retired.clear();
+
+    if (live_workers >= elastic_opts.max_workers) {
+        return;
+    }
+    workers.emplace_back(&ThreadPool::mutex_worker, this);
+    live_workers++;
+    grow_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadPool::run_job(TimedTask &job)
+{
+    wait_hist.record(pool_now_ns() - job.enqueue_ns);
+    job.task();
+    completed.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadPool::mutex_worker()
+{
+    while (true) {
+        TimedTask job;
+
+        // 此处需要操作队列，而队列是共享资源
+        { 
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            // 检查条件；弹性模式下最多空闲等待 idle_timeout_ms
+            auto ready = [this](){
+                return !this->jobs.empty() || this->stop;
+            };
+            idle_workers++;
+            bool got = true;
+            if (elastic) {
+                got = m_condition.wait_for(lock, std::chrono::milliseconds(elastic_opts.idle_timeout_ms), ready);
+            }
+            else {
+                m_condition.wait(lock, ready);
+            }
+            idle_workers--;
+
+            if (stop) {
+                return; // 退出任务线程
+            }
+
+            // 空闲超时，多于 min_workers 时退出
+            if (!got) {
+                if (live_workers > elastic_opts.min_workers) {
+                    live_workers--;
+                    retired.push_back(std::this_thread::get_id());
+                    shrink_count.fetch_add(1, std::memory_order_relaxed);
+                    return;
                 }
+                continue;
+            }
+
+            // 取出job
+            job = std::move(jobs.front());
+            jobs.pop();
+            started.fetch_add(1, std::memory_order_relaxed);
+
+            // 排队太久且没有空闲 worker 时扩容
+            if (elastic && idle_workers == 0 && !jobs.empty()
+                && pool_now_ns() - job.enqueue_ns > elastic_opts.grow_wait_us * 1000) {
+                grow_locked();
+            }
+        }
+
+        // 此时已经释放锁，执行任务
+        run_job(job);
+    }
+}
 
-                // 此时已经释放锁，执行任务
-                job();
+void ThreadPool::lock_free_worker()
+{
+    while (!stop) {
+        TimedTask job;
+
+        // 先自旋，短任务连续提交时不必睡眠
+        bool got = false;
+        for (int i = 0; i < WORKER_SPIN_COUNT; i++) {
+            if (lf_jobs.try_pop(job)) {
+                got = true;
+                break;
             }
-        });
+            cpu_relax();
+        }
+
+        // 宣告睡眠后再检查一次队列，确认为空才 park 到 futex
+        if (!got) {
+            uint32_t ticket = parker.prepare_park();
+            got = lf_jobs.try_pop(job);
+            if (!got && !stop) {
+                parker.park(ticket);
+            }
+            parker.cancel_park();
+        }
+
+        if (got) {
+            started.fetch_add(1, std::memory_order_relaxed);
+            run_job(job);
+        }
     }
-    
+}
+
+
+void ThreadPool::push_job(Job &&task)
+{
+    TimedTask job(std::move(task));
+    submitted.fetch_add(1, std::memory_order_relaxed);
+
+    if (backend == QueueBackend::LOCK_FREE) {
+        // 队列满时让出 CPU，等待 worker 消费
+        while (!lf_jobs.try_push(job)) {
+            std::this_thread::yield();
+        }
+        // 没有 worker 睡眠时不会进入内核
+        parker.unpark_one();
+        return;
+    }
+
+    if (backend == QueueBackend::WORK_STEALING) {
+        WorkerContext &ctx = current_worker();
+        if (ctx.pool == this) {
+            // 在 worker 内部提交的子任务进自己的队列
+            local_jobs[ctx.index]->push(std::move(job));
+        }
+        else {
+            // 外部提交轮询分发
+            unsigned i = next_queue.fetch_add(1, std::memory_order_relaxed) % local_jobs.size();
+            local_jobs[i]->push(std::move(job));
+        }
+        parker.unpark_one();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        jobs.emplace(std::move(job));
+
+        // 没有空闲 worker，且队列过深或队头等待过久：扩容
+        if (elastic && idle_workers == 0
+            && (jobs.size() > elastic_opts.grow_depth
+                || pool_now_ns() - jobs.front().enqueue_ns > elastic_opts.grow_wait_us * 1000)) {
+            grow_locked();
+        }
+    }
+
+    // 唤醒一个线程,这个动作无需锁
+    m_condition.notify_one();
+}
+
+bool ThreadPool::take_job(int index, TimedTask &job, bool wait_lock)
+{
+    // 1. 自己的队列 (LIFO)
+    if (local_jobs[index]->pop(job)) {
+        return true;
+    }
+
+    // 2. 从随机位置开始依次窃取其它 worker 的队列 (FIFO)
+    static thread_local uint32_t seed = 2463534242u ^ (uint32_t)(index * 2654435761u);
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    size_t n = local_jobs.size();
+    size_t start = seed % n;
+    for (size_t i = 0; i < n; i++) {
+        size_t victim = (start + i) % n;
+        if ((int)victim == index) continue;
+        if (local_jobs[victim]->steal(job, wait_lock)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work_stealing_worker(int index)
+{
+    current_worker().pool = this;
+    current_worker().index = index;
+
+    while (!stop) {
+        TimedTask job;
+
+        bool got = take_job(index, job, false);
+
+        // 宣告睡眠后再完整检查一遍，确认所有队列都空才 park
+        if (!got) {
+            uint32_t ticket = parker.prepare_park();
+            got = take_job(index, job, true);
+            if (!got && !stop) {
+                parker.park(ticket);
+            }
+            parker.cancel_park();
+        }
+
+        if (got) {
+            started.fetch_add(1, std::memory_order_relaxed);
+            run_job(job);
+        }
+    }
+}
+
+ThreadPoolStats ThreadPool::stats()
+{
+    ThreadPoolStats s;
+    s.submitted = submitted.load(std::memory_order_relaxed);
+    s.completed = completed.load(std::memory_order_relaxed);
+    uint64_t taken = started.load(std::memory_order_relaxed);
+    s.queue_depth = s.submitted > taken ? (size_t)(s.submitted - taken) : 0;
+    s.grow_count = grow_count.load(std::memory_order_relaxed);
+    s.shrink_count = shrink_count.load(std::memory_order_relaxed);
+
+    if (backend == QueueBackend::MUTEX) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        s.workers = live_workers;
+        s.idle_workers = idle_workers;
+    }
+    else {
+        s.workers = live_workers;
+        s.idle_workers = parker.parked();
+    }
+
+    for (int i = 0; i < WaitHistogram::BUCKETS; i++) {
+        s.wait_hist[i] = wait_hist.count(i);
+    }
+    s.wait_p50_us = wait_hist.percentile_us(0.50);
+    s.wait_p99_us = wait_hist.percentile_us(0.99);
+    return s;
+}
+
+
+// 排空：等待已提交的任务全部执行完，超时返回 false (之后析构会丢弃还在排队的任务)
+bool ThreadPool::wait_idle(int timeout_ms)
+{
+    int64_t deadline = pool_now_ns() + (int64_t)timeout_ms * 1000000;
+    while (completed.load(std::memory_order_acquire) < submitted.load(std::memory_order_acquire)) {
+        if (pool_now_ns() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
 }
 
 
@@ -44,6 +306,7 @@ ThreadPool::~ThreadPool()
         stop = true;
     }
     m_condition.notify_all(); // 通知所有工作线程进行状态检查 此时stop = true; 即将退出
+    parker.unpark_all();      // 唤醒 park 在 futex 上的无锁模式 worker
 
     for (auto &worker : workers) {
         if (worker.joinable()) {
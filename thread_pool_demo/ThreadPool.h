@@ -9,36 +9,105 @@
 #include <thread>
 #include <functional>
 #include <iostream>
+#include <atomic>
 
-const int THREAD_POOL_SIZE = 4;
-using Job = std::function<void()>;
+#include "../common/mpmc_queue.h"
+#include "../common/futex.h"
+#include "../common/work_steal_queue.h"
+#include <memory>
+#include "../common/task.h"
+#include "../common/task_future.h"
+#include "../common/pool_stats.h"
+
+const int THREAD_POOL_SIZE = 4;               // 固定大小模式的 worker 数；弹性模式见 ElasticOptions
+const size_t LOCK_FREE_QUEUE_CAPACITY = 4096; // 无锁队列容量 (2 的幂)
+const int WORKER_SPIN_COUNT = 256;            // 空闲 worker 睡眠前的自旋次数
+using Job = Task; // 只能移动的任务，小捕获内联存放，不分配堆内存
+
+// 任务队列后端
+enum class QueueBackend
+{
+    MUTEX,      // std::queue + mutex + condition_variable (默认)
+    LOCK_FREE,  // 有界无锁 MPMC 环形队列 + 自旋 + futex 停车
+    WORK_STEALING, // 每个 worker 一个本地双端队列，空闲时随机窃取
+};
 
 class ThreadPool
 {
 private:
     std::vector<std::thread> workers;
-    std::queue<Job> jobs;
+    std::queue<TimedTask> jobs;
     std::mutex m_mutex;
     std::condition_variable m_condition;
-    bool stop;
+    std::atomic<bool> stop;
+
+    QueueBackend backend;
+    MpmcQueue<TimedTask> lf_jobs;
+    WorkerParker parker;
+
+    // 窃取模式：每个 worker 一个本地队列
+    std::vector<std::unique_ptr<WorkStealQueue<TimedTask>>> local_jobs;
+    std::atomic<unsigned> next_queue{0};
+
+    // 弹性模式 (只用于 mutex 后端)，int 字段由 m_mutex 保护
+    bool elastic = false;
+    ElasticOptions elastic_opts;
+    int live_workers = 0;
+    int idle_workers = 0;
+    std::vector<std::thread::id> retired;     // 缩容退出、还没 join 的 worker
+
+    // 运行时统计
+    std::atomic<uint64_t> submitted{0};
+    std::atomic<uint64_t> started{0};
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> grow_count{0};
+    std::atomic<uint64_t> shrink_count{0};
+    WaitHistogram wait_hist;
+
+    // 当前线程所属的线程池和 worker 下标
+    struct WorkerContext
+    {
+        ThreadPool *pool = nullptr;
+        int index = -1;
+    };
+    static WorkerContext &current_worker()
+    {
+        static thread_local WorkerContext ctx;
+        return ctx;
+    }
+
+    void mutex_worker();
+    void lock_free_worker();
+    void work_stealing_worker(int index);
+    bool take_job(int index, TimedTask &job, bool wait_lock);
+    void run_job(TimedTask &job);
+    void grow_locked();
+
+    // 把任务放进当前后端的队列并唤醒 worker
+    void push_job(Job &&job);
 
 public:
-    ThreadPool(int pool_size = THREAD_POOL_SIZE);
+    ThreadPool(int pool_size = THREAD_POOL_SIZE, QueueBackend backend = QueueBackend::MUTEX);
+    // 弹性模式：worker 数在 [min_workers, max_workers] 之间随负载伸缩
+    explicit ThreadPool(const ElasticOptions &opts);
     ~ThreadPool();
 
+    // 运行时状态快照
+    ThreadPoolStats stats();
+
+    // 等待已提交的任务全部执行完 (最多 timeout_ms)，析构前调用就不会丢任务
+    bool wait_idle(int timeout_ms);
+
 public:
-    template<class FUNC>
-    void submit(FUNC &&job);
+    // 提交 job(args...)，返回可获取结果的 future；参数按值保存
+    template<class FUNC, class... ARGS>
+    typename TaskTraits<FUNC, ARGS...>::Future submit(FUNC &&job, ARGS&&... args);
 };
 
-// 提交任务，注意job是一个无参函数
-template<class FUNC>
-void ThreadPool::submit(FUNC &&job) {
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        jobs.emplace(std::forward<FUNC>(job));
-    }
-
-    // 唤醒一个线程,这个动作无需锁
-    m_condition.notify_one();
+// 提交任务：job(args...) 连同 future 的共享状态一起打包，共享状态来自 slab 池
+template<class FUNC, class... ARGS>
+typename TaskTraits<FUNC, ARGS...>::Future ThreadPool::submit(FUNC &&job, ARGS&&... args) {
+    auto packaged = make_task(std::forward<FUNC>(job), std::forward<ARGS>(args)...);
+    push_job(Job(std::move(packaged.first)));
+    return std::move(packaged.second);
 }
@@ -1 +1 @@
-g++ -pthread ThreadPool.cc ThreadPool-test.cc -o ThreadPool-test
\ No newline at end of file
+g++ -std=c++17 -pthread ThreadPool.cc ThreadPool-test.cc -o ThreadPool-test
\ No newline at end of file